@@ -0,0 +1,266 @@
+/*!
+ * @file BinaryExport.cpp
+ * A binary export of the disassembly, for tools which would otherwise have to parse the text.
+ *
+ * File format (all integers are little endian):
+ *  header: ExportHeader
+ *  table directory: ExportTableEntry for each table
+ *  tables: the records of each table, starting on a 16 byte boundary
+ */
+
+#include "BinaryExport.h"
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include "LinkedObjectFile.h"
+#include "util/MappedFile.h"
+
+namespace {
+constexpr size_t TABLE_ALIGNMENT = 16;
+
+const char* export_table_names[(int)ExportTable::MAX_TABLE] = {
+    "objects", "segments", "functions",   "instructions", "blocks",
+    "edges",   "labels",   "symbol-refs", "opcodes",      "strings"};
+
+template <typename T>
+void append_table(std::vector<uint8_t>& dest,
+                  std::vector<ExportTableEntry>& directory,
+                  ExportTable table,
+                  const T* records,
+                  size_t count) {
+  dest.resize((dest.size() + TABLE_ALIGNMENT - 1) & ~(TABLE_ALIGNMENT - 1));
+  directory.push_back({uint32_t(table), uint32_t(sizeof(T)), dest.size(), count});
+  auto ptr = (const uint8_t*)records;
+  dest.insert(dest.end(), ptr, ptr + sizeof(T) * count);
+}
+}  // namespace
+
+const char* export_table_to_charp(ExportTable table) {
+  assert(table < ExportTable::MAX_TABLE);
+  return export_table_names[(int)table];
+}
+
+BinaryExportBuilder::BinaryExportBuilder() {
+  // so a string offset of 0 is the empty string.
+  add_string("");
+}
+
+uint32_t BinaryExportBuilder::add_string(const std::string& str) {
+  auto it = m_string_offsets.find(str);
+  if (it != m_string_offsets.end()) {
+    return it->second;
+  }
+  auto offset = uint32_t(m_strings.size());
+  m_strings.append(str);
+  m_strings.push_back('\0');
+  m_string_offsets[str] = offset;
+  return offset;
+}
+
+/*!
+ * Add an object file, with the symbol references found by find_xrefs.
+ */
+void BinaryExportBuilder::add_object(const std::string& name,
+                                     const LinkedObjectFile& file,
+                                     const ObjectXrefs& xrefs) {
+  auto object_idx = uint32_t(m_objects.size());
+  ExportObject object;
+  object.name = add_string(name);
+  object.first_segment = m_segments.size();
+  object.n_segments = file.segments;
+  object.first_label = m_labels.size();
+  object.n_labels = file.labels.size();
+  m_objects.push_back(object);
+
+  for (auto& label : file.labels) {
+    m_labels.push_back({add_string(label.name), object_idx, uint32_t(label.target_segment),
+                        uint32_t(label.offset)});
+  }
+
+  for (int seg = 0; seg < file.segments; seg++) {
+    auto segment_idx = uint32_t(m_segments.size());
+    const auto& functions = file.functions_by_seg.at(seg);
+    ExportSegment segment;
+    segment.object = object_idx;
+    segment.segment = seg;
+    segment.first_function = m_functions.size();
+    segment.n_functions = functions.size();
+    segment.n_words = file.words_by_seg.at(seg).size();
+    segment.data_start_word = file.offset_of_data_zone_by_seg.at(seg);
+    m_segments.push_back(segment);
+
+    for (auto& func : functions) {
+      auto function_idx = uint32_t(m_functions.size());
+      ExportFunction function;
+      function.segment = segment_idx;
+      function.name = add_string(func.guessed_name);
+      function.start_word = func.start_word;
+      function.end_word = func.end_word;
+      function.first_instruction = m_instructions.size();
+      function.n_instructions = func.instructions.size();
+      function.first_block = m_blocks.size();
+      function.n_blocks = func.cfg.block_count();
+      m_functions.push_back(function);
+
+      for (auto& instr : func.instructions) {
+        ExportInstruction record;
+        memset(&record, 0, sizeof(record));
+        record.kind = uint16_t(instr.kind);
+        record.n_dst = instr.n_dst;
+        record.n_src = instr.n_src;
+        record.cop2_dest = instr.cop2_dest;
+        record.cop2_bc = instr.cop2_bc;
+        record.il = instr.il;
+
+        auto add_operand = [&](int i, const InstructionAtom& atom) {
+          auto& op = record.operands[i];
+          op.kind = atom.kind;
+          switch (atom.kind) {
+            case InstructionAtom::REGISTER:
+              op.reg = atom.get_reg().get_id();
+              break;
+            case InstructionAtom::IMM:
+              op.value = atom.get_imm();
+              break;
+            case InstructionAtom::IMM_SYM:
+              op.value = add_string(atom.get_sym());
+              break;
+            case InstructionAtom::LABEL:
+              op.value = object.first_label + atom.get_label();
+              break;
+            default:
+              break;
+          }
+        };
+        for (int i = 0; i < instr.n_dst; i++) {
+          add_operand(i, instr.get_dst(i));
+        }
+        for (int i = 0; i < instr.n_src; i++) {
+          add_operand(instr.n_dst + i, instr.get_src(i));
+        }
+        m_instructions.push_back(record);
+      }
+
+      for (int b = 0; b < func.cfg.block_count(); b++) {
+        auto& block = func.cfg.blocks[b];
+        auto successors = func.cfg.successors(b);
+        m_blocks.push_back({function_idx, uint32_t(block.start_word), uint32_t(block.end_word),
+                            uint32_t(m_edges.size()), uint32_t(successors.size())});
+        for (auto& edge : successors) {
+          ExportEdge record;
+          memset(&record, 0, sizeof(record));
+          record.block = function.first_block + edge.block;
+          record.kind = uint8_t(edge.kind);
+          m_edges.push_back(record);
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < xrefs.refs.size(); i++) {
+    auto& loc = xrefs.refs[i];
+    if (loc.kind != XrefKind::SYMBOL && loc.kind != XrefKind::SYMBOL_OFFSET &&
+        loc.kind != XrefKind::TYPE) {
+      continue;
+    }
+    auto& segment = m_segments.at(object.first_segment + loc.segment);
+    ExportSymbolRef ref;
+    memset(&ref, 0, sizeof(ref));
+    ref.symbol = add_string(xrefs.targets[i]);
+    ref.segment = object.first_segment + loc.segment;
+    ref.function = loc.function == -1 ? -1 : int32_t(segment.first_function + loc.function);
+    ref.offset = loc.offset;
+    ref.kind = uint8_t(loc.kind);
+    m_symbol_refs.push_back(ref);
+  }
+}
+
+std::vector<uint8_t> BinaryExportBuilder::to_binary() const {
+  // the opcode table isn't per object, so is added here.
+  std::string strings = m_strings;
+  std::vector<ExportOpcode> opcodes;
+  for (auto& info : gOpcodeInfo) {
+    opcodes.push_back({uint32_t(strings.size())});
+    strings.append(info.name ? info.name : "");
+    strings.push_back('\0');
+  }
+
+  ExportHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "JDEX", 4);
+  header.version = BINARY_EXPORT_VERSION;
+  header.n_tables = uint32_t(ExportTable::MAX_TABLE);
+
+  // the directory is filled in once we know where the tables go.
+  std::vector<uint8_t> result(sizeof(header) + sizeof(ExportTableEntry) * header.n_tables);
+  std::vector<ExportTableEntry> directory;
+  auto add = [&](ExportTable table, const auto& records) {
+    append_table(result, directory, table, records.data(), records.size());
+  };
+  add(ExportTable::OBJECTS, m_objects);
+  add(ExportTable::SEGMENTS, m_segments);
+  add(ExportTable::FUNCTIONS, m_functions);
+  add(ExportTable::INSTRUCTIONS, m_instructions);
+  add(ExportTable::BLOCKS, m_blocks);
+  add(ExportTable::EDGES, m_edges);
+  add(ExportTable::LABELS, m_labels);
+  add(ExportTable::SYMBOL_REFS, m_symbol_refs);
+  add(ExportTable::OPCODES, opcodes);
+  add(ExportTable::STRINGS, strings);
+
+  assert(directory.size() == header.n_tables);
+  memcpy(result.data(), &header, sizeof(header));
+  memcpy(result.data() + sizeof(header), directory.data(),
+         sizeof(ExportTableEntry) * directory.size());
+  return result;
+}
+
+/*!
+ * Check the header and the location of each table. The records themselves aren't checked.
+ */
+BinaryExportView::BinaryExportView(const uint8_t* data, size_t size) : m_data(data) {
+  ExportHeader header;
+  if (size < sizeof(header)) {
+    throw std::runtime_error("Export file is too small");
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, "JDEX", 4) != 0 || header.version != BINARY_EXPORT_VERSION ||
+      header.n_tables != uint32_t(ExportTable::MAX_TABLE) ||
+      size < sizeof(header) + sizeof(ExportTableEntry) * header.n_tables) {
+    throw std::runtime_error("Export file has the wrong format or version");
+  }
+  memcpy(m_tables, data + sizeof(header), sizeof(m_tables));
+
+  const size_t record_sizes[(int)ExportTable::MAX_TABLE] = {
+      sizeof(ExportObject), sizeof(ExportSegment), sizeof(ExportFunction),
+      sizeof(ExportInstruction), sizeof(ExportBlock), sizeof(ExportEdge),
+      sizeof(ExportLabel), sizeof(ExportSymbolRef), sizeof(ExportOpcode), 1};
+  for (int i = 0; i < (int)ExportTable::MAX_TABLE; i++) {
+    auto& entry = m_tables[i];
+    if (entry.table != uint32_t(i) || entry.record_size != record_sizes[i] ||
+        entry.offset % TABLE_ALIGNMENT != 0 || entry.offset > size ||
+        entry.count > (size - entry.offset) / entry.record_size) {
+      throw std::runtime_error("Export file has a bad table");
+    }
+  }
+
+  auto n_strings = count(ExportTable::STRINGS);
+  if (n_strings == 0 || table<char>(ExportTable::STRINGS)[n_strings - 1] != '\0') {
+    throw std::runtime_error("Export file has a bad string table");
+  }
+}
+
+/*!
+ * Print the size of each table in an export.
+ */
+int print_binary_export_info(const std::string& file_name) {
+  MappedFile file(file_name);
+  BinaryExportView view(file.data(), file.size());
+  printf("%s: version %d, %ld bytes\n", file_name.c_str(), BINARY_EXPORT_VERSION,
+         long(file.size()));
+  for (int i = 0; i < (int)ExportTable::MAX_TABLE; i++) {
+    auto table = ExportTable(i);
+    printf("  %-14s %10ld\n", export_table_to_charp(table), long(view.count(table)));
+  }
+  return 0;
+}
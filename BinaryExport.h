@@ -0,0 +1,207 @@
+/*!
+ * @file BinaryExport.h
+ * A binary export of the disassembly, for tools which would otherwise have to parse the text.
+ *
+ * The export is a set of tables of fixed size records, so it can be mapped into memory and used
+ * directly. Records refer to each other by index into their tables, and to strings by offset into
+ * the string table. Each table is a list of records in the order of the objects, then segments,
+ * then functions they belong to, so the records of a parent are always a contiguous range.
+ *
+ * The tables are rows of records rather than a column per field. Tools almost always want whole
+ * instructions or functions, and a record can be used in place from the mapped file.
+ */
+
+#ifndef JAK_DISASSEMBLER_BINARYEXPORT_H
+#define JAK_DISASSEMBLER_BINARYEXPORT_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "XrefDatabase.h"
+
+class LinkedObjectFile;
+
+// increase this when a record changes, or a table is added.
+constexpr uint32_t BINARY_EXPORT_VERSION = 1;
+
+enum class ExportTable : uint32_t {
+  OBJECTS,       // ExportObject
+  SEGMENTS,      // ExportSegment
+  FUNCTIONS,     // ExportFunction
+  INSTRUCTIONS,  // ExportInstruction
+  BLOCKS,        // ExportBlock
+  EDGES,         // ExportEdge
+  LABELS,        // ExportLabel
+  SYMBOL_REFS,   // ExportSymbolRef
+  OPCODES,       // ExportOpcode, indexed by InstructionKind
+  STRINGS,       // null terminated strings, with records of 1 byte
+  MAX_TABLE
+};
+
+const char* export_table_to_charp(ExportTable table);
+
+/*!
+ * The header at the start of the file, followed by a ExportTableEntry for each table.
+ */
+struct ExportHeader {
+  char magic[4];  // "JDEX"
+  uint32_t version;
+  uint32_t n_tables;
+  uint32_t pad;
+};
+
+/*!
+ * The location of a table in the file. Tables start on a 16 byte boundary.
+ */
+struct ExportTableEntry {
+  uint32_t table;  // ExportTable
+  uint32_t record_size;
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct ExportObject {
+  uint32_t name;
+  uint32_t first_segment;
+  uint32_t n_segments;
+  uint32_t first_label;
+  uint32_t n_labels;
+};
+
+struct ExportSegment {
+  uint32_t object;
+  uint32_t segment;  // segment number within the object
+  uint32_t first_function;
+  uint32_t n_functions;
+  uint32_t n_words;
+  uint32_t data_start_word;  // words before this are code
+};
+
+struct ExportFunction {
+  uint32_t segment;  // index in the segment table
+  uint32_t name;     // the empty string if we don't know the name
+  uint32_t start_word;
+  uint32_t end_word;  // not inclusive
+  uint32_t first_instruction;
+  uint32_t n_instructions;  // instruction i is at word start_word + i
+  uint32_t first_block;
+  uint32_t n_blocks;  // zero if basic blocks weren't found
+};
+
+/*!
+ * An instruction operand. The value depends on the kind (an InstructionAtom::AtomKind):
+ * REGISTER uses reg (register kind << 8 | register number), IMM is the immediate, IMM_SYM is
+ * the offset of the symbol name in the string table, and LABEL is an index in the label table.
+ */
+struct ExportOperand {
+  uint8_t kind;
+  uint8_t pad;
+  uint16_t reg;
+  int32_t value;
+};
+
+/*!
+ * An instruction. Operands are the destinations, then the sources.
+ * The cop2 fields are 0xff if not used, like in Instruction.
+ */
+struct ExportInstruction {
+  uint16_t kind;  // InstructionKind
+  uint8_t n_dst;
+  uint8_t n_src;
+  uint8_t cop2_dest;
+  uint8_t cop2_bc;
+  uint8_t il;
+  uint8_t pad;
+  ExportOperand operands[4];
+};
+
+struct ExportBlock {
+  uint32_t function;
+  uint32_t start_instruction;  // within the function
+  uint32_t end_instruction;    // not inclusive
+  uint32_t first_edge;
+  uint32_t n_edges;  // successors
+};
+
+struct ExportEdge {
+  uint32_t block;  // index in the block table
+  uint8_t kind;    // EdgeKind
+  uint8_t pad[3];
+};
+
+struct ExportLabel {
+  uint32_t name;
+  uint32_t object;
+  uint32_t segment;  // segment number within the object
+  uint32_t offset;   // in bytes
+};
+
+struct ExportSymbolRef {
+  uint32_t symbol;   // name of the symbol or type
+  uint32_t segment;  // index in the segment table
+  int32_t function;  // index in the function table, or -1 if not in a function
+  uint32_t offset;   // byte offset in the segment
+  uint8_t kind;      // XrefKind, one of SYMBOL, SYMBOL_OFFSET or TYPE
+  uint8_t pad[3];
+};
+
+struct ExportOpcode {
+  uint32_t name;
+};
+
+static_assert(sizeof(ExportHeader) == 16, "ExportHeader should be 16 bytes");
+static_assert(sizeof(ExportTableEntry) == 24, "ExportTableEntry should be 24 bytes");
+static_assert(sizeof(ExportInstruction) == 40, "ExportInstruction should be 40 bytes");
+static_assert(sizeof(ExportSymbolRef) == 20, "ExportSymbolRef should be 20 bytes");
+
+/*!
+ * Builds an export, one object file at a time.
+ */
+class BinaryExportBuilder {
+ public:
+  BinaryExportBuilder();
+  void add_object(const std::string& name,
+                  const LinkedObjectFile& file,
+                  const ObjectXrefs& xrefs);
+  std::vector<uint8_t> to_binary() const;
+
+  size_t instruction_count() const { return m_instructions.size(); }
+
+ private:
+  uint32_t add_string(const std::string& str);
+
+  std::vector<ExportObject> m_objects;
+  std::vector<ExportSegment> m_segments;
+  std::vector<ExportFunction> m_functions;
+  std::vector<ExportInstruction> m_instructions;
+  std::vector<ExportBlock> m_blocks;
+  std::vector<ExportEdge> m_edges;
+  std::vector<ExportLabel> m_labels;
+  std::vector<ExportSymbolRef> m_symbol_refs;
+  std::string m_strings;
+  std::unordered_map<std::string, uint32_t> m_string_offsets;
+};
+
+/*!
+ * A view of the tables in an export, which is checked when it's created.
+ */
+class BinaryExportView {
+ public:
+  BinaryExportView(const uint8_t* data, size_t size);
+
+  template <typename T>
+  const T* table(ExportTable table) const {
+    return (const T*)(m_data + m_tables[(int)table].offset);
+  }
+  uint64_t count(ExportTable table) const { return m_tables[(int)table].count; }
+  const char* string(uint32_t offset) const { return table<char>(ExportTable::STRINGS) + offset; }
+
+ private:
+  const uint8_t* m_data;
+  ExportTableEntry m_tables[(int)ExportTable::MAX_TABLE];
+};
+
+int print_binary_export_info(const std::string& file_name);
+
+#endif  // JAK_DISASSEMBLER_BINARYEXPORT_H
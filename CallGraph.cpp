@@ -0,0 +1,325 @@
+/*!
+ * @file CallGraph.cpp
+ * Whole-game call graph, found from GOAL function calls.
+ *
+ * File format (all integers are little endian uint32s):
+ *  header: "CALL", version, node count, function node count, edge count, string table size
+ *  nodes: CallGraph::Node for each node
+ *  edge offsets: node count + 1 offsets into edges
+ *  edges: callee node of each edge, grouped by caller
+ *  string table: null terminated strings
+ */
+
+#include "CallGraph.h"
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include "LinkedObjectFile.h"
+#include "Disasm/InstructionMatching.h"
+
+namespace {
+constexpr uint32_t CALL_GRAPH_VERSION = 1;
+
+struct CallGraphFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t n_nodes;
+  uint32_t n_functions;
+  uint32_t n_edges;
+  uint32_t string_table_size;
+};
+
+static_assert(sizeof(CallGraph::Node) == 16, "CallGraph::Node should be 16 bytes");
+
+template <typename T>
+void append_pod(std::vector<uint8_t>& dest, const T& value) {
+  auto ptr = (const uint8_t*)&value;
+  dest.insert(dest.end(), ptr, ptr + sizeof(T));
+}
+
+template <typename T>
+void read_pods(const std::vector<uint8_t>& src, size_t offset, std::vector<T>& dest, size_t count) {
+  dest.resize(count);
+  if (count) {
+    memcpy(dest.data(), src.data() + offset, sizeof(T) * count);
+  }
+}
+}  // namespace
+
+/*!
+ * Find all function calls in an object file. Doesn't modify anything, so this can run on many
+ * object files in parallel.
+ *
+ * A GOAL function call loads the function into t9, then does jalr ra, t9. The load is usually
+ * right before the call, but may be separated from it by a label, so this doesn't stop at the end
+ * of a basic block. Calls where t9 didn't come from a symbol (like method calls) are indirect.
+ */
+ObjectCalls find_calls(const LinkedObjectFile& file) {
+  ObjectCalls result;
+  int function_idx = 0;
+  for (int seg = 0; seg < file.segments; seg++) {
+    for (auto& func : file.functions_by_seg.at(seg)) {
+      const InstructionAtom* t9_symbol = nullptr;  // the symbol loaded into t9, if there is one
+      for (auto& instr : func.instructions) {
+        if (instr.kind == InstructionKind::JALR &&
+            instr.get_dst(0).get_reg() == make_gpr(Reg::RA) &&
+            instr.get_src(0).get_reg() == make_gpr(Reg::T9)) {
+          if (t9_symbol) {
+            result.callers.push_back(function_idx);
+            result.callee_symbols.push_back(t9_symbol->get_sym());
+          } else {
+            result.n_indirect++;
+          }
+        }
+
+        if (instr.reg_defs().contains(make_gpr(Reg::T9))) {
+          if ((instr.kind == InstructionKind::LW || instr.kind == InstructionKind::LWU) &&
+              instr.get_src(0).kind == InstructionAtom::IMM_SYM &&
+              instr.get_src(1).get_reg() == make_gpr(Reg::S7)) {
+            t9_symbol = &instr.get_src(0);
+          } else {
+            t9_symbol = nullptr;
+          }
+        }
+      }
+      function_idx++;
+    }
+  }
+  return result;
+}
+
+uint32_t CallGraph::add_string(const std::string& str) {
+  uint32_t result = m_strings.size();
+  m_strings.append(str);
+  m_strings.push_back('\0');
+  return result;
+}
+
+/*!
+ * Build the call graph from the calls found in each object file.
+ * The functions should be in object order, and first_function_by_object[i] is the index of the
+ * first function of object i. A call to a symbol goes to the first function stored into that
+ * symbol. If no function is stored into the symbol, the call goes to a node for the symbol.
+ */
+CallGraph CallGraph::build(const std::vector<FunctionInfo>& functions,
+                           const std::vector<int>& first_function_by_object,
+                           const std::vector<ObjectCalls>& calls) {
+  assert(first_function_by_object.size() == calls.size());
+  CallGraph result;
+  result.m_n_functions = functions.size();
+
+  std::unordered_map<std::string, uint32_t> object_names;
+  std::unordered_map<std::string, uint32_t> nodes_by_symbol;
+  for (auto& func : functions) {
+    auto obj = object_names.find(func.object);
+    if (obj == object_names.end()) {
+      obj = object_names.insert({func.object, result.add_string(func.object)}).first;
+    }
+    Node node;
+    node.name = result.add_string(func.name);
+    node.object = obj->second;
+    node.segment = func.segment;
+    node.function = func.function;
+    if (!func.name.empty() && func.name != "(top-level-init)") {
+      nodes_by_symbol.insert({func.name, uint32_t(result.m_nodes.size())});
+    }
+    result.m_nodes.push_back(node);
+  }
+
+  // calls are already grouped by caller, so we can fill in edges in order.
+  uint32_t no_object = result.add_string("");
+  std::vector<int> last_caller;  // to remove duplicate edges
+  result.m_edge_offsets.push_back(0);
+  for (size_t obj = 0; obj < calls.size(); obj++) {
+    auto& obj_calls = calls[obj];
+    for (size_t i = 0; i < obj_calls.callers.size(); i++) {
+      int caller = first_function_by_object[obj] + obj_calls.callers[i];
+      assert(caller + 1 >= int(result.m_edge_offsets.size()));
+      while (int(result.m_edge_offsets.size()) <= caller) {
+        result.m_edge_offsets.push_back(result.m_edges.size());
+      }
+
+      auto& symbol = obj_calls.callee_symbols[i];
+      auto callee = nodes_by_symbol.find(symbol);
+      if (callee == nodes_by_symbol.end()) {
+        Node node;
+        node.name = result.add_string(symbol);
+        node.object = no_object;
+        callee = nodes_by_symbol.insert({symbol, uint32_t(result.m_nodes.size())}).first;
+        result.m_nodes.push_back(node);
+      }
+
+      if (last_caller.size() < result.m_nodes.size()) {
+        last_caller.resize(result.m_nodes.size(), -1);
+      }
+      if (last_caller[callee->second] != caller) {
+        last_caller[callee->second] = caller;
+        result.m_edges.push_back(callee->second);
+      }
+    }
+  }
+
+  while (result.m_edge_offsets.size() <= result.m_nodes.size()) {
+    result.m_edge_offsets.push_back(result.m_edges.size());
+  }
+  return result;
+}
+
+std::vector<uint8_t> CallGraph::to_binary() const {
+  CallGraphFileHeader header;
+  memcpy(header.magic, "CALL", 4);
+  header.version = CALL_GRAPH_VERSION;
+  header.n_nodes = m_nodes.size();
+  header.n_functions = m_n_functions;
+  header.n_edges = m_edges.size();
+  header.string_table_size = m_strings.size();
+
+  std::vector<uint8_t> result;
+  result.reserve(sizeof(header) + sizeof(Node) * m_nodes.size() + 4 * m_edge_offsets.size() +
+                 4 * m_edges.size() + m_strings.size());
+  append_pod(result, header);
+  for (auto& node : m_nodes) {
+    append_pod(result, node);
+  }
+  for (auto offset : m_edge_offsets) {
+    append_pod(result, offset);
+  }
+  for (auto edge : m_edges) {
+    append_pod(result, edge);
+  }
+  result.insert(result.end(), m_strings.begin(), m_strings.end());
+  return result;
+}
+
+CallGraph CallGraph::from_binary(const std::vector<uint8_t>& data) {
+  CallGraphFileHeader header;
+  if (data.size() < sizeof(header)) {
+    throw std::runtime_error("Call graph file is too small");
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (memcmp(header.magic, "CALL", 4) != 0 || header.version != CALL_GRAPH_VERSION) {
+    throw std::runtime_error("Call graph file has the wrong format or version");
+  }
+
+  size_t nodes_offset = sizeof(header);
+  size_t offsets_offset = nodes_offset + sizeof(Node) * size_t(header.n_nodes);
+  size_t edges_offset = offsets_offset + 4 * (size_t(header.n_nodes) + 1);
+  size_t strings_offset = edges_offset + 4 * size_t(header.n_edges);
+  if (strings_offset + header.string_table_size != data.size() || header.string_table_size == 0 ||
+      data.back() != '\0' || header.n_functions > header.n_nodes) {
+    throw std::runtime_error("Call graph file has the wrong size");
+  }
+
+  CallGraph result;
+  result.m_n_functions = header.n_functions;
+  read_pods(data, nodes_offset, result.m_nodes, header.n_nodes);
+  read_pods(data, offsets_offset, result.m_edge_offsets, header.n_nodes + 1);
+  read_pods(data, edges_offset, result.m_edges, header.n_edges);
+  result.m_strings.assign((const char*)data.data() + strings_offset, header.string_table_size);
+
+  for (auto& node : result.m_nodes) {
+    if (node.name >= header.string_table_size || node.object >= header.string_table_size) {
+      throw std::runtime_error("Call graph file has a bad node");
+    }
+  }
+  for (uint32_t i = 0; i < header.n_nodes; i++) {
+    if (result.m_edge_offsets[i] > result.m_edge_offsets[i + 1]) {
+      throw std::runtime_error("Call graph file has bad edge offsets");
+    }
+  }
+  if (result.m_edge_offsets.front() != 0 || result.m_edge_offsets.back() != header.n_edges) {
+    throw std::runtime_error("Call graph file has bad edge offsets");
+  }
+  for (auto edge : result.m_edges) {
+    if (edge >= header.n_nodes) {
+      throw std::runtime_error("Call graph file has a bad edge");
+    }
+  }
+  return result;
+}
+
+/*!
+ * Convert part of the call graph to DOT format: the functions named root (or object/root), the
+ * functions they call up to depth calls away, and the functions which call them directly.
+ */
+std::string CallGraph::to_dot(const std::string& root, int depth) const {
+  const int n_nodes = node_count();
+  std::vector<int> distance(n_nodes, -1);
+  std::vector<int> queue;
+  for (int i = 0; i < n_nodes; i++) {
+    if (root == node_name(i) || root == std::string(node_object(i)) + "/" + node_name(i)) {
+      distance[i] = 0;
+      queue.push_back(i);
+    }
+  }
+
+  if (queue.empty()) {
+    throw std::runtime_error("Call graph has no function named " + root);
+  }
+
+  int n_roots = queue.size();
+  for (size_t q = 0; q < queue.size(); q++) {
+    int node = queue[q];
+    if (distance[node] == depth) {
+      continue;
+    }
+    for (uint32_t e = m_edge_offsets[node]; e < m_edge_offsets[node + 1]; e++) {
+      if (distance[m_edges[e]] == -1) {
+        distance[m_edges[e]] = distance[node] + 1;
+        queue.push_back(m_edges[e]);
+      }
+    }
+  }
+
+  // direct callers of the roots
+  std::vector<std::pair<int, int>> caller_edges;
+  for (int caller = 0; caller < n_nodes; caller++) {
+    for (uint32_t e = m_edge_offsets[caller]; e < m_edge_offsets[caller + 1]; e++) {
+      if (distance[m_edges[e]] == 0 && (distance[caller] == -1 || distance[caller] >= depth)) {
+        caller_edges.push_back({caller, m_edges[e]});
+        if (distance[caller] == -1) {
+          distance[caller] = depth + 1;  // so we don't add it again, or expand it.
+          queue.push_back(caller);
+        }
+      }
+    }
+  }
+
+  std::string result = "digraph calls {\n";
+  for (size_t q = 0; q < queue.size(); q++) {
+    int node = queue[q];
+    const auto& info = m_nodes[node];
+    std::string label;
+    if (info.segment == -1) {
+      label = node_name(node);
+    } else if (node_name(node)[0]) {
+      label = std::string(node_name(node)) + "\\n" + node_object(node);
+    } else {
+      label = std::string(node_object(node)) + " seg " + std::to_string(info.segment) + " fn " +
+              std::to_string(info.function);
+    }
+
+    result += "  n" + std::to_string(node) + " [label=\"" + label + "\"";
+    if (int(q) < n_roots) {
+      result += ", style=bold";
+    } else if (info.segment == -1) {
+      result += ", style=dashed";
+    }
+    result += "];\n";
+  }
+
+  for (int node : queue) {
+    if (distance[node] >= depth) {
+      continue;
+    }
+    for (uint32_t e = m_edge_offsets[node]; e < m_edge_offsets[node + 1]; e++) {
+      result += "  n" + std::to_string(node) + " -> n" + std::to_string(m_edges[e]) + ";\n";
+    }
+  }
+  for (auto& edge : caller_edges) {
+    result += "  n" + std::to_string(edge.first) + " -> n" + std::to_string(edge.second) + ";\n";
+  }
+  result += "}\n";
+  return result;
+}
@@ -0,0 +1,73 @@
+/*!
+ * @file CallGraph.h
+ * Whole-game call graph, found from GOAL function calls.
+ */
+
+#ifndef JAK_DISASSEMBLER_CALLGRAPH_H
+#define JAK_DISASSEMBLER_CALLGRAPH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class LinkedObjectFile;
+
+/*!
+ * The calls made by the functions of a single object file.
+ * Functions are numbered in order of segment, then order in the segment.
+ */
+struct ObjectCalls {
+  std::vector<int> callers;                // function making the call
+  std::vector<std::string> callee_symbols;  // symbol holding the function which is called
+  int n_indirect = 0;                      // calls through something other than a symbol
+};
+
+ObjectCalls find_calls(const LinkedObjectFile& file);
+
+/*!
+ * A call graph in compressed sparse row format. There is a node for each function, followed by a
+ * node for each symbol which is called but doesn't have a function defined in the object files.
+ */
+class CallGraph {
+ public:
+  struct Node {
+    uint32_t name = 0;     // string table offset of the function's name, or the symbol's name
+    uint32_t object = 0;   // string table offset of the object file name
+    int32_t segment = -1;  // -1 for symbols without a function
+    int32_t function = -1;
+  };
+
+  /*!
+   * Information about a function, used to build the graph.
+   */
+  struct FunctionInfo {
+    std::string name;  // may be empty, if we don't know the name.
+    std::string object;
+    int segment;
+    int function;
+  };
+
+  static CallGraph build(const std::vector<FunctionInfo>& functions,
+                         const std::vector<int>& first_function_by_object,
+                         const std::vector<ObjectCalls>& calls);
+  static CallGraph from_binary(const std::vector<uint8_t>& data);
+  std::vector<uint8_t> to_binary() const;
+  std::string to_dot(const std::string& root, int depth) const;
+
+  int node_count() const { return int(m_nodes.size()); }
+  int edge_count() const { return int(m_edges.size()); }
+  int function_count() const { return m_n_functions; }
+  const char* node_name(int node) const { return m_strings.data() + m_nodes.at(node).name; }
+  const char* node_object(int node) const { return m_strings.data() + m_nodes.at(node).object; }
+
+ private:
+  uint32_t add_string(const std::string& str);
+
+  int m_n_functions = 0;
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_edge_offsets;  // callees of node n are m_edges[offsets[n]...offsets[n+1]]
+  std::vector<uint32_t> m_edges;
+  std::string m_strings;
+};
+
+#endif  // JAK_DISASSEMBLER_CALLGRAPH_H
@@ -7,24 +7,42 @@
 #include "Instruction.h"
 #include "LinkedObjectFile.h"
 #include <cassert>
+#include <cstdio>
 
 /*!
  * Convert atom to a string for disassembly.
  */
 std::string InstructionAtom::to_string(const LinkedObjectFile& file) const {
+  std::string result;
+  append_to(result, file);
+  return result;
+}
+
+/*!
+ * Append atom's disassembly to the end of a string. Doesn't allocate, other than growing dest.
+ */
+void InstructionAtom::append_to(std::string& dest, const LinkedObjectFile& file) const {
   switch (kind) {
     case REGISTER:
-      return reg.to_string();
-    case IMM:
-      return std::to_string(imm);
+      dest.append(reg.to_charp());
+      break;
+    case IMM: {
+      char buff[16];
+      int len = sprintf(buff, "%d", imm);
+      dest.append(buff, len);
+    } break;
     case LABEL:
-      return file.get_label_name(label_id);
+      dest.append(file.get_label_name(label_id));
+      break;
     case VU_ACC:
-      return "acc";
+      dest.append("acc");
+      break;
     case VU_Q:
-      return "Q";
+      dest.push_back('Q');
+      break;
     case IMM_SYM:
-      return sym;
+      dest.append(sym);
+      break;
     default:
       assert(false);
   }
@@ -115,95 +133,89 @@ bool InstructionAtom::is_link_or_label() const {
   return kind == IMM_SYM || kind == LABEL;
 }
 
+// Suffixes for COP2 opcodes, indexed by the value of the il, bc, and dest fields.
+static const char* const il_suffixes[2] = {".ni", ".i"};
+static const char bc_suffixes[4] = {'x', 'y', 'z', 'w'};
+static const char* const dest_suffixes[16] = {".",    ".w",   ".z",   ".zw",  ".y",   ".yw",
+                                              ".yz",  ".yzw", ".x",   ".xw",  ".xz",  ".xzw",
+                                              ".xy",  ".xyw", ".xyz", ".xyzw"};
+
 /*!
  * Convert entire instruction to a string.
  */
 std::string Instruction::to_string(const LinkedObjectFile& file) const {
+  std::string result;
+  append_to(result, file);
+  return result;
+}
+
+/*!
+ * Append the entire instruction to the end of a string. Doesn't allocate, other than growing dest.
+ */
+void Instruction::append_to(std::string& dest, const LinkedObjectFile& file) const {
   auto& info = gOpcodeInfo[(int)kind];
 
   // the name
-  std::string result = info.name;
+  dest.append(info.name);
 
   // optional "interlock" specification.
   if (il != 0xff) {
-    result.append(il ? ".i" : ".ni");
+    dest.append(il_suffixes[il ? 1 : 0]);
   }
 
   // optional "broadcast" specification for COP2 opcodes.
   if (cop2_bc != 0xff) {
-    switch (cop2_bc) {
-      case 0:
-        result.push_back('x');
-        break;
-      case 1:
-        result.push_back('y');
-        break;
-      case 2:
-        result.push_back('z');
-        break;
-      case 3:
-        result.push_back('w');
-        break;
-      default:
-        result.push_back('?');
-        break;
-    }
+    dest.push_back(cop2_bc < 4 ? bc_suffixes[cop2_bc] : '?');
   }
 
   // optional "destination" specification for COP2 opcodes.
   if (cop2_dest != 0xff) {
-    result += ".";
-    if (cop2_dest & 8)
-      result.push_back('x');
-    if (cop2_dest & 4)
-      result.push_back('y');
-    if (cop2_dest & 2)
-      result.push_back('z');
-    if (cop2_dest & 1)
-      result.push_back('w');
+    dest.append(dest_suffixes[cop2_dest & 0xf]);
   }
 
   // relative store and load instructions have a special syntax in MIPS
   if (info.is_store) {
     assert(n_dst == 0);
     assert(n_src == 3);
-    result += " ";
-    result += src[0].to_string(file);
-    result += ", ";
-    result += src[1].to_string(file);
-    result += "(";
-    result += src[2].to_string(file);
-    result += ")";
+    dest.push_back(' ');
+    src[0].append_to(dest, file);
+    dest.append(", ");
+    src[1].append_to(dest, file);
+    dest.push_back('(');
+    src[2].append_to(dest, file);
+    dest.push_back(')');
   } else if (info.is_load) {
     assert(n_dst == 1);
     assert(n_src == 2);
-    result += " ";
-    result += dst[0].to_string(file);
-    result += ", ";
-    result += src[0].to_string(file);
-    result += "(";
-    result += src[1].to_string(file);
-    result += ")";
+    dest.push_back(' ');
+    dst[0].append_to(dest, file);
+    dest.append(", ");
+    src[0].append_to(dest, file);
+    dest.push_back('(');
+    src[1].append_to(dest, file);
+    dest.push_back(')');
   } else {
     // for instructions that aren't a store or load, the dest/sources are comma separated.
     bool end_comma = false;
 
     for (uint8_t i = 0; i < n_dst; i++) {
-      result += " " + dst[i].to_string(file) + ",";
+      dest.push_back(' ');
+      dst[i].append_to(dest, file);
+      dest.push_back(',');
       end_comma = true;
     }
 
     for (uint8_t i = 0; i < n_src; i++) {
-      result += " " + src[i].to_string(file) + ",";
+      dest.push_back(' ');
+      src[i].append_to(dest, file);
+      dest.push_back(',');
       end_comma = true;
     }
 
     if (end_comma) {
-      result.pop_back();
+      dest.pop_back();
     }
   }
-
-  return result;
 }
 
 /*!
@@ -302,3 +314,53 @@ int Instruction::get_label_target() const {
   }
   return result;
 }
+
+/*!
+ * Add the register referenced by an atom (if any) to a set.
+ */
+static void add_atom_register(RegisterSet& set, const InstructionAtom& atom) {
+  switch (atom.kind) {
+    case InstructionAtom::REGISTER:
+      set.insert(atom.get_reg());
+      break;
+    case InstructionAtom::VU_ACC:
+      set.insert(Register(Reg::SPECIAL, Reg::VU_ACC));
+      break;
+    case InstructionAtom::VU_Q:
+      set.insert(Register(Reg::SPECIAL, Reg::VU_Q));
+      break;
+    default:
+      break;
+  }
+}
+
+/*!
+ * Get the registers read by this instruction.
+ */
+RegisterSet Instruction::reg_uses() const {
+  auto& info = get_info();
+  RegisterSet result = info.implicit_use;
+  for (int i = 0; i < n_src; i++) {
+    add_atom_register(result, src[i]);
+  }
+
+  // if the destination might not be completely overwritten (conditional move, or a COP2 op which
+  // doesn't write all of x, y, z, w), the old value is also used.
+  if (info.conditional_def || (cop2_dest != 0xff && cop2_dest != 0xf)) {
+    for (int i = 0; i < n_dst; i++) {
+      add_atom_register(result, dst[i]);
+    }
+  }
+  return result;
+}
+
+/*!
+ * Get the registers written by this instruction.
+ */
+RegisterSet Instruction::reg_defs() const {
+  RegisterSet result = get_info().implicit_def;
+  for (int i = 0; i < n_dst; i++) {
+    add_atom_register(result, dst[i]);
+  }
+  return result;
+}
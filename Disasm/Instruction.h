@@ -40,6 +40,7 @@ struct InstructionAtom {
   std::string get_sym() const;
 
   std::string to_string(const LinkedObjectFile& file) const;
+  void append_to(std::string& dest, const LinkedObjectFile& file) const;
 
   bool is_link_or_label() const;
 
@@ -58,6 +59,7 @@ class Instruction {
   InstructionKind kind = InstructionKind::UNKNOWN;
 
   std::string to_string(const LinkedObjectFile& file) const;
+  void append_to(std::string& dest, const LinkedObjectFile& file) const;
   bool is_valid() const;
 
   void add_src(InstructionAtom& a);
@@ -78,6 +80,9 @@ class Instruction {
 
   const OpcodeInfo& get_info() const;
 
+  RegisterSet reg_uses() const;
+  RegisterSet reg_defs() const;
+
   int get_label_target() const;
 
   // extra fields for some COP2 instructions.
@@ -6,77 +6,9 @@
 
 #include "InstructionDecode.h"
 #include <cassert>
+#include "OperandLayout.h"
 #include "../LinkedObjectFile.h"
 
-// utility class to extract fields of an opcode.
-struct OpcodeFields {
-  OpcodeFields(uint32_t _data) : data(_data) {}
-
-  // 26 - 31
-  uint32_t op() { return (data >> 26); }
-
-  //////////////
-  // R - Type //
-  //////////////
-
-  // 21 - 25
-  uint32_t rs() { return (data >> 21) & 0x1f; }
-
-  // 16 - 20
-  uint32_t rt() { return (data >> 16) & 0x1f; }
-
-  // 11 - 15
-  uint32_t rd() { return (data >> 11) & 0x1f; }
-
-  //  6 - 10
-  uint32_t sa() { return (data >> 6) & 0x1f; }
-
-  // 0 - 5
-  uint32_t function() { return (data)&0x3f; }
-
-  ////////////////
-  // Immediates //
-  ////////////////
-
-  int32_t simm16() { return (int16_t)(data); }
-
-  int32_t zimm16() { return (uint16_t)(data); }
-
-  uint32_t imm5() { return (data >> 6) & 0x1f; }
-
-  uint32_t imm15() { return (data >> 6) & 0b111111111111111; }
-
-  ////////////////////
-  // Floating Point //
-  ////////////////////
-
-  uint32_t cop_func() { return (data >> 21) & 0x1f; }
-
-  uint32_t ft() { return (data >> 16) & 0x1f; }
-
-  uint32_t fs() { return (data >> 11) & 0x1f; }
-
-  uint32_t fd() { return (data >> 6) & 0x1f; }
-
-  ////////////
-  // Others //
-  ////////////
-
-  uint32_t pcreg() { return (data >> 1) & 0x1f; }
-
-  uint32_t syscall() { return (data >> 6) & 0xfffff; }
-
-  uint32_t MMI_func() { return (data >> 6) & 0x1f; }
-
-  uint32_t lower11() { return (uint32_t)(data & 0x7ff); }
-
-  uint32_t lower6() { return (uint32_t)(data & 0b111111); }
-
-  uint32_t dest() { return (data >> 21) & 0b1111; }
-
-  uint32_t data;
-};
-
 //////////////////
 // OPCODE DECODE
 //////////////////
@@ -1001,6 +933,14 @@ static InstructionKind decode_opcode(uint32_t code) {
   }
 }
 
+/*!
+ * Get the label for a branch target at the given offset (in words) from the instruction after the
+ * branch.
+ */
+int get_branch_target_label(LinkedObjectFile& file, int seg_id, int word_id, int32_t offset) {
+  return file.get_label_id_for(seg_id, (word_id + offset + 1) * 4);
+}
+
 /*!
  * Top level decode function.
  */
@@ -1013,126 +953,8 @@ Instruction decode_instruction(LinkedWord& word, LinkedObjectFile& file, int seg
     return i;
   }
   i.kind = op;
-  OpcodeFields fields(word.data);
-
-  // loop through decoding steps to extract a value
-  for (int j = 0; j < info.step_count; j++) {
-    auto& step = info.steps[j];
-    int32_t value;
-    switch (step.field) {
-      case FieldType::RS:
-        value = fields.rs();
-        break;
-      case FieldType::RT:
-        value = fields.rt();
-        break;
-      case FieldType::RD:
-        value = fields.rd();
-        break;
-      case FieldType::FT:
-        value = fields.ft();
-        break;
-      case FieldType::FS:
-        value = fields.fs();
-        break;
-      case FieldType::FD:
-        value = fields.fd();
-        break;
-      case FieldType::SIMM16:
-        value = fields.simm16();
-        break;
-      case FieldType::ZIMM16:
-        value = fields.zimm16();
-        break;
-      case FieldType::SA:
-        value = fields.sa();
-        break;
-      case FieldType::SYSCALL:
-        value = fields.syscall();
-        break;
-      case FieldType::PCR:
-        value = fields.pcreg();
-        break;
-      case FieldType::DEST:
-        value = fields.dest();
-        break;
-      case FieldType::BC:
-        value = fields.data & 0b11;
-        break;
-      case FieldType::IMM5:
-        value = fields.imm5();
-        break;
-      case FieldType::IL:
-        value = fields.data & 1;
-        break;
-      case FieldType::IMM15:
-        value = fields.imm15();
-        break;
-      case FieldType::ZERO:
-        value = 0;
-        break;
-      default:
-        assert(false);
-    }
-
-    // use the value, to possibly add an atom
-    InstructionAtom atom;
-    switch (step.decode) {
-      case DecodeType::GPR:
-        atom.set_reg(Register(Reg::GPR, value));
-        break;
-      case DecodeType::FPR:
-        atom.set_reg(Register(Reg::FPR, value));
-        break;
-      case DecodeType::COP0:
-        atom.set_reg(Register(Reg::COP0, value));
-        break;
-      case DecodeType::PCR:
-        atom.set_reg(Register(Reg::PCR, value));
-        break;
-      case DecodeType::IMM:
-        atom.set_imm(value);
-        break;
-      case DecodeType::VF:
-        atom.set_reg(Register(Reg::VF, value));
-        break;
-      case DecodeType::VI:
-        atom.set_reg(Register(Reg::VI, value));
-        break;
-      case DecodeType::VU_ACC:
-        atom.set_vu_acc();
-        break;
-      case DecodeType::VU_Q:
-        atom.set_vu_q();
-        break;
-      case DecodeType::VCALLMS_TARGET:
-        atom.set_imm(value * 8);
-        break;
-      case DecodeType::BRANCH_TARGET:
-        atom.set_label(file.get_label_id_for(seg_id, (word_id + value + 1) * 4));
-        break;
-
-        // NOTE - these change a property of the instruction and don't add an atom.
-      case DecodeType::IL:
-        i.il = value;
-        continue;
-      case DecodeType::DEST:
-        i.cop2_dest = value;
-        continue;
-      case DecodeType::BC:
-        i.cop2_bc = value;
-        continue;
-
-      default:
-        assert(false);
-    }
-
-    if (step.is_src) {
-      i.add_src(atom);
-    } else {
-      i.add_dst(atom);
-    }
-  }
+  // extract operands with the routine generated for this opcode's layout
+  info.extract_operands(i, word.data, file, seg_id, word_id);
 
   if (word.kind == LinkedWord::SYM_OFFSET) {
     bool fixed = false;
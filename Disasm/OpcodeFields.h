@@ -0,0 +1,80 @@
+/*!
+ * @file OpcodeFields.h
+ * Utility to extract the fields of a 32-bit EE instruction.
+ */
+
+#ifndef NEXT_OPCODEFIELDS_H
+#define NEXT_OPCODEFIELDS_H
+
+#include <cstdint>
+
+// utility class to extract fields of an opcode.
+struct OpcodeFields {
+  OpcodeFields(uint32_t _data) : data(_data) {}
+
+  // 26 - 31
+  uint32_t op() { return (data >> 26); }
+
+  //////////////
+  // R - Type //
+  //////////////
+
+  // 21 - 25
+  uint32_t rs() { return (data >> 21) & 0x1f; }
+
+  // 16 - 20
+  uint32_t rt() { return (data >> 16) & 0x1f; }
+
+  // 11 - 15
+  uint32_t rd() { return (data >> 11) & 0x1f; }
+
+  //  6 - 10
+  uint32_t sa() { return (data >> 6) & 0x1f; }
+
+  // 0 - 5
+  uint32_t function() { return (data)&0x3f; }
+
+  ////////////////
+  // Immediates //
+  ////////////////
+
+  int32_t simm16() { return (int16_t)(data); }
+
+  int32_t zimm16() { return (uint16_t)(data); }
+
+  uint32_t imm5() { return (data >> 6) & 0x1f; }
+
+  uint32_t imm15() { return (data >> 6) & 0b111111111111111; }
+
+  ////////////////////
+  // Floating Point //
+  ////////////////////
+
+  uint32_t cop_func() { return (data >> 21) & 0x1f; }
+
+  uint32_t ft() { return (data >> 16) & 0x1f; }
+
+  uint32_t fs() { return (data >> 11) & 0x1f; }
+
+  uint32_t fd() { return (data >> 6) & 0x1f; }
+
+  ////////////
+  // Others //
+  ////////////
+
+  uint32_t pcreg() { return (data >> 1) & 0x1f; }
+
+  uint32_t syscall() { return (data >> 6) & 0xfffff; }
+
+  uint32_t MMI_func() { return (data >> 6) & 0x1f; }
+
+  uint32_t lower11() { return (uint32_t)(data & 0x7ff); }
+
+  uint32_t lower6() { return (uint32_t)(data & 0b111111); }
+
+  uint32_t dest() { return (data >> 21) & 0b1111; }
+
+  uint32_t data;
+};
+
+#endif  // NEXT_OPCODEFIELDS_H
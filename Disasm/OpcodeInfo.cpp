@@ -1,499 +1,461 @@
 #include "OpcodeInfo.h"
 #include <cassert>
-
-OpcodeInfo gOpcodeInfo[(uint32_t)InstructionKind::EE_OP_MAX];
+#include "OperandLayout.h"
 
 typedef InstructionKind IK;
 typedef FieldType FT;
 typedef DecodeType DT;
 
-static OpcodeInfo& def(IK k, const char* name) {
-  gOpcodeInfo[(uint32_t)k].defined = true;
-  gOpcodeInfo[(uint32_t)k].name = name;
-  return gOpcodeInfo[(uint32_t)k];
-}
-
-static OpcodeInfo& def_branch(IK k, const char* name) {
-  auto& result = def(k, name);
-  result.is_branch = true;
-  result.has_delay_slot = true;
-  return result;
-}
-
-static OpcodeInfo& def_branch_likely(IK k, const char* name) {
-  auto& result = def(k, name);
-  result.is_branch = true;
-  result.is_branch_likely = true;
-  result.has_delay_slot = true;
-  return result;
-}
-
-static OpcodeInfo& def_store(IK k, const char* name) {
-  auto& result = def(k, name);
-  result.is_store = true;
-  return result;
-}
-
-static OpcodeInfo& def_load(IK k, const char* name) {
-  auto& result = def(k, name);
-  result.is_load = true;
-  return result;
-}
-
-static OpcodeInfo& drt_srs_ssimm16(OpcodeInfo& info) {
-  return info.dst_gpr(FT::RT).src_gpr(FT::RS).src(FT::SIMM16, DT::IMM);
-}
-
-static OpcodeInfo& srt_ssimm16_srs(OpcodeInfo& info) {
-  return info.src_gpr(FT::RT).src(FT::SIMM16, DT::IMM).src_gpr(FT::RS);
-}
-
-static OpcodeInfo& drt_ssimm16_srs(OpcodeInfo& info) {
-  return info.dst_gpr(FT::RT).src(FT::SIMM16, DT::IMM).src_gpr(FT::RS);
-}
-
-static OpcodeInfo& drd_srs_srt(OpcodeInfo& info) {
-  return info.dst_gpr(FT::RD).src_gpr(FT::RS).src_gpr(FT::RT);
-}
-
-static OpcodeInfo& drd_srt_srs(OpcodeInfo& info) {
-  return info.dst_gpr(FT::RD).src_gpr(FT::RT).src_gpr(FT::RS);
-}
-
-static OpcodeInfo& drd_srt_ssa(OpcodeInfo& info) {
-  return info.dst_gpr(FT::RD).src_gpr(FT::RT).src(FT::SA, DT::IMM);
-}
-
-static OpcodeInfo& srs_srt_bt(OpcodeInfo& info) {
-  return info.src_gpr(FT::RS).src_gpr(FT::RT).src(FT::SIMM16, DT::BRANCH_TARGET);
-}
-
-static OpcodeInfo& srs_bt(OpcodeInfo& info) {
-  return info.src_gpr(FT::RS).src(FT::SIMM16, DT::BRANCH_TARGET);
-}
-
-static OpcodeInfo& bt(OpcodeInfo& info) {
-  return info.src(FT::SIMM16, DT::BRANCH_TARGET);
-}
-
-static OpcodeInfo& dfd_sfs_sft(OpcodeInfo& info) {
-  return info.dst_fpr(FT::FD).src_fpr(FT::FS).src_fpr(FT::FT);
-}
-
-static OpcodeInfo& sfs_sft(OpcodeInfo& info) {
-  return info.src_fpr(FT::FS).src_fpr(FT::FT);
-}
-
-static OpcodeInfo& dfd_sfs(OpcodeInfo& info) {
-  return info.dst_fpr(FT::FD).src_fpr(FT::FS);
-}
-
-static OpcodeInfo& drd(OpcodeInfo& info) {
-  return info.dst_gpr(FT::RD);
-}
-
-static OpcodeInfo& cd_dvft_svfs(OpcodeInfo& info) {
-  return info.src(FT::DEST, DT::DEST).dst_vf(FT::FT).src_vf(FT::FS);
-}
-
-static OpcodeInfo& cd_dvfd_svfs_svft(OpcodeInfo& info) {
-  return info.src(FT::DEST, DT::DEST).dst_vf(FT::FD).src_vf(FT::FS).src_vf(FT::FT);
-}
-
-static OpcodeInfo& cb_cd_dvfd_svfs_svft(OpcodeInfo& info) {
-  return info.src(FT::BC, DT::BC)
-      .src(FT::DEST, DT::DEST)
-      .dst_vf(FT::FD)
-      .src_vf(FT::FS)
-      .src_vf(FT::FT);
-}
+// registers implicitly used by some instructions
+constexpr Register HI(Reg::SPECIAL, Reg::HI);
+constexpr Register LO(Reg::SPECIAL, Reg::LO);
+constexpr Register HI1(Reg::SPECIAL, Reg::HI1);
+constexpr Register LO1(Reg::SPECIAL, Reg::LO1);
+constexpr Register FPU_ACC(Reg::SPECIAL, Reg::FPU_ACC);
+constexpr Register FPU_CC(Reg::SPECIAL, Reg::FPU_CC);
+constexpr Register VU_ACC(Reg::SPECIAL, Reg::VU_ACC);
+constexpr Register VU_Q(Reg::SPECIAL, Reg::VU_Q);
+constexpr Register RA(Reg::GPR, Reg::RA);
+
+namespace {
+/*!
+ * The table of all opcodes, built by make_opcode_table at compile time.
+ */
+struct OpcodeTable {
+  OpcodeInfo info[(uint32_t)IK::EE_OP_MAX];
+
+  template <typename Layout>
+  constexpr OpcodeInfo& def(IK k, const char* name) {
+    auto& result = info[(uint32_t)k];
+    result.defined = true;
+    result.name = name;
+    Layout::add_steps(result);
+    result.extract_operands = &extract_operands<Layout>;
+    return result;
+  }
 
-static OpcodeInfo& cb_cd_dacc_svfs_svft(OpcodeInfo& info) {
-  return info.src(FT::BC, DT::BC)
-      .src(FT::DEST, DT::DEST)
-      .dst(FT::ZERO, DT::VU_ACC)
-      .src_vf(FT::FS)
-      .src_vf(FT::FT);
-}
+  template <typename Layout>
+  constexpr OpcodeInfo& def_branch(IK k, const char* name) {
+    auto& result = def<Layout>(k, name);
+    result.is_branch = true;
+    result.has_delay_slot = true;
+    return result;
+  }
 
-static OpcodeInfo& cd_dvfd_svfs_sq(OpcodeInfo& info) {
-  return info.src(FT::DEST, DT::DEST).dst_vf(FT::FD).src_vf(FT::FS).src(FT::ZERO, DT::VU_Q);
-}
+  template <typename Layout>
+  constexpr OpcodeInfo& def_branch_likely(IK k, const char* name) {
+    auto& result = def<Layout>(k, name);
+    result.is_branch = true;
+    result.is_branch_likely = true;
+    result.has_delay_slot = true;
+    return result;
+  }
 
-static OpcodeInfo& cd_dacc_svfs_svft(OpcodeInfo& info) {
-  return info.src(FT::DEST, DT::DEST).dst(FT::ZERO, DT::VU_ACC).src_vf(FT::FS).src_vf(FT::FT);
-}
+  template <typename Layout>
+  constexpr OpcodeInfo& def_store(IK k, const char* name) {
+    auto& result = def<Layout>(k, name);
+    result.is_store = true;
+    result.writes_memory = true;
+    return result;
+  }
 
-void init_opcode_info() {
-  gOpcodeInfo[0].name = ";; ??????";
+  template <typename Layout>
+  constexpr OpcodeInfo& def_load(IK k, const char* name) {
+    auto& result = def<Layout>(k, name);
+    result.is_load = true;
+    result.reads_memory = true;
+    return result;
+  }
+};
+}  // namespace
+
+// Operand layouts. The name lists the steps in order: d = destination, s = source,
+// cd = COP2 dest field, cb = COP2 broadcast field, cil = COP2 interlock bit, bt = branch target.
+typedef OperandLayout<DstGpr<FT::RT>, SrcGpr<FT::RS>, Src<FT::SIMM16, DT::IMM>> drt_srs_ssimm16;
+typedef OperandLayout<SrcGpr<FT::RT>, Src<FT::SIMM16, DT::IMM>, SrcGpr<FT::RS>> srt_ssimm16_srs;
+typedef OperandLayout<DstGpr<FT::RT>, Src<FT::SIMM16, DT::IMM>, SrcGpr<FT::RS>> drt_ssimm16_srs;
+typedef OperandLayout<DstGpr<FT::RD>, SrcGpr<FT::RS>, SrcGpr<FT::RT>> drd_srs_srt;
+typedef OperandLayout<DstGpr<FT::RD>, SrcGpr<FT::RT>, SrcGpr<FT::RS>> drd_srt_srs;
+typedef OperandLayout<DstGpr<FT::RD>, SrcGpr<FT::RT>, Src<FT::SA, DT::IMM>> drd_srt_ssa;
+typedef OperandLayout<SrcGpr<FT::RS>, SrcGpr<FT::RT>, Src<FT::SIMM16, DT::BRANCH_TARGET>>
+    srs_srt_bt;
+typedef OperandLayout<SrcGpr<FT::RS>, Src<FT::SIMM16, DT::BRANCH_TARGET>> srs_bt;
+typedef OperandLayout<Src<FT::SIMM16, DT::BRANCH_TARGET>> bt;
+typedef OperandLayout<DstFpr<FT::FD>, SrcFpr<FT::FS>, SrcFpr<FT::FT>> dfd_sfs_sft;
+typedef OperandLayout<SrcFpr<FT::FS>, SrcFpr<FT::FT>> sfs_sft;
+typedef OperandLayout<DstFpr<FT::FD>, SrcFpr<FT::FS>> dfd_sfs;
+typedef OperandLayout<DstGpr<FT::RD>> drd;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>, DstVf<FT::FT>, SrcVf<FT::FS>> cd_dvft_svfs;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>, DstVf<FT::FD>, SrcVf<FT::FS>, SrcVf<FT::FT>>
+    cd_dvfd_svfs_svft;
+typedef OperandLayout<Src<FT::BC, DT::BC>,
+                      Src<FT::DEST, DT::DEST>,
+                      DstVf<FT::FD>,
+                      SrcVf<FT::FS>,
+                      SrcVf<FT::FT>>
+    cb_cd_dvfd_svfs_svft;
+typedef OperandLayout<Src<FT::BC, DT::BC>,
+                      Src<FT::DEST, DT::DEST>,
+                      Dst<FT::ZERO, DT::VU_ACC>,
+                      SrcVf<FT::FS>,
+                      SrcVf<FT::FT>>
+    cb_cd_dacc_svfs_svft;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>,
+                      DstVf<FT::FD>,
+                      SrcVf<FT::FS>,
+                      Src<FT::ZERO, DT::VU_Q>>
+    cd_dvfd_svfs_sq;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>,
+                      Dst<FT::ZERO, DT::VU_ACC>,
+                      SrcVf<FT::FS>,
+                      SrcVf<FT::FT>>
+    cd_dacc_svfs_svft;
+typedef OperandLayout<SrcGpr<FT::RS>, SrcGpr<FT::RT>> srs_srt;
+typedef OperandLayout<DstGpr<FT::RT>, SrcGpr<FT::RS>, Src<FT::ZIMM16, DT::IMM>> drt_srs_szimm16;
+typedef OperandLayout<DstGpr<FT::RT>, Src<FT::SIMM16, DT::IMM>> drt_ssimm16;
+typedef OperandLayout<DstGpr<FT::RD>, SrcGpr<FT::RS>> drd_srs;
+typedef OperandLayout<SrcGpr<FT::RS>> srs;
+typedef OperandLayout<DstFpr<FT::FT>, Src<FT::SIMM16, DT::IMM>, SrcGpr<FT::RS>> dft_ssimm16_srs;
+typedef OperandLayout<SrcFpr<FT::FT>, Src<FT::SIMM16, DT::IMM>, SrcGpr<FT::RS>> sft_ssimm16_srs;
+typedef OperandLayout<DstGpr<FT::RT>, SrcFpr<FT::FS>> drt_sfs;
+typedef OperandLayout<SrcGpr<FT::RT>, DstFpr<FT::FS>> srt_dfs;
+typedef OperandLayout<SrcGpr<FT::RT>, Dst<FT::RD, DT::COP0>> srt_dc0rd;
+typedef OperandLayout<DstGpr<FT::RT>, Src<FT::RD, DT::COP0>> drt_sc0rd;
+typedef OperandLayout<SrcGpr<FT::RT>> srt;
+typedef OperandLayout<DstGpr<FT::RT>, Src<FT::PCR, DT::PCR>> drt_spcr;
+typedef OperandLayout<SrcGpr<FT::RT>, Dst<FT::PCR, DT::PCR>> srt_dpcr;
+typedef OperandLayout<Src<FT::SYSCALL, DT::IMM>> ssyscall;
+typedef OperandLayout<SrcGpr<FT::RS>, Src<FT::SIMM16, DT::IMM>> srs_ssimm16;
+typedef OperandLayout<> no_operands;
+typedef OperandLayout<DstGpr<FT::RD>, SrcGpr<FT::RT>> drd_srt;
+typedef OperandLayout<SrcVf<FT::FT>, Src<FT::SIMM16, DT::IMM>, SrcGpr<FT::RS>> svft_ssimm16_srs;
+typedef OperandLayout<DstVf<FT::FT>, Src<FT::SIMM16, DT::IMM>, SrcGpr<FT::RS>> dvft_ssimm16_srs;
+typedef OperandLayout<Dst<FT::ZERO, DT::VU_Q>, SrcVf<FT::FS>, SrcVf<FT::FT>, Src<FT::BC, DT::BC>>
+    dq_svfs_svft_cb;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>, SrcVf<FT::FS>, SrcVf<FT::FT>> cd_svfs_svft;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>,
+                      Dst<FT::ZERO, DT::VU_ACC>,
+                      SrcVf<FT::FS>,
+                      Src<FT::ZERO, DT::VU_Q>>
+    cd_dacc_svfs_sq;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>, DstVf<FT::FT>> cd_dvft;
+typedef OperandLayout<DstVi<FT::RT>, SrcVf<FT::FS>, Src<FT::BC, DT::BC>> dvirt_svfs_cb;
+typedef OperandLayout<DstVi<FT::FD>, SrcVi<FT::FS>, SrcVi<FT::FT>> dvifd_svifs_svift;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>, DstVf<FT::FT>, SrcVi<FT::FS>> cd_dvft_svifs;
+typedef OperandLayout<Src<FT::DEST, DT::DEST>, SrcVf<FT::FS>, SrcVi<FT::FT>> cd_svfs_svift;
+typedef OperandLayout<DstVi<FT::FT>, SrcVi<FT::FS>, Src<FT::IMM5, DT::IMM>> dvift_svifs_simm5;
+typedef OperandLayout<Src<FT::IL, DT::IL>, DstGpr<FT::RT>, SrcVf<FT::FS>> cil_drt_svfs;
+typedef OperandLayout<Src<FT::IL, DT::IL>, SrcGpr<FT::RT>, DstVf<FT::FS>> cil_srt_dvfs;
+typedef OperandLayout<Src<FT::BC, DT::BC>, Dst<FT::ZERO, DT::VU_Q>, SrcVf<FT::FT>> cb_dq_svft;
+typedef OperandLayout<Src<FT::BC, DT::BC>, SrcVf<FT::FS>> cb_svfs;
+typedef OperandLayout<Src<FT::IL, DT::IL>, SrcGpr<FT::RT>, DstVi<FT::RD>> cil_srt_dvird;
+typedef OperandLayout<Src<FT::IL, DT::IL>, DstGpr<FT::RT>, SrcVi<FT::RD>> cil_drt_svird;
+typedef OperandLayout<Src<FT::IMM15, DT::VCALLMS_TARGET>> vcallms;
+
+namespace {
+constexpr OpcodeTable make_opcode_table() {
+  OpcodeTable t;
+  t.info[0].name = ";; ??????";
 
   // RT, RS, SIMM
-  drt_srs_ssimm16(def(IK::DADDIU, "daddiu"));  // Doubleword Add Immediate Unsigned
-  drt_srs_ssimm16(def(IK::ADDIU, "addiu"));    // Add Immediate Unsigned Word
-  drt_srs_ssimm16(def(IK::SLTI, "slti"));      // Set on Less Than Immediate
-  drt_srs_ssimm16(def(IK::SLTIU, "sltiu"));    // Set on Less Than Immediate Unsigned
+  t.def<drt_srs_ssimm16>(IK::DADDIU, "daddiu");  // Doubleword Add Immediate Unsigned
+  t.def<drt_srs_ssimm16>(IK::ADDIU, "addiu");    // Add Immediate Unsigned Word
+  t.def<drt_srs_ssimm16>(IK::SLTI, "slti");      // Set on Less Than Immediate
+  t.def<drt_srs_ssimm16>(IK::SLTIU, "sltiu");    // Set on Less Than Immediate Unsigned
 
   // stores in srt_ssimm16_srs
-  srt_ssimm16_srs(def_store(IK::SB, "sb"));  // Store Byte
-  srt_ssimm16_srs(def_store(IK::SH, "sh"));  // Store Halfword
-  srt_ssimm16_srs(def_store(IK::SW, "sw"));  // Store Word
-  srt_ssimm16_srs(def_store(IK::SD, "sd"));  // Store Doubleword
-  srt_ssimm16_srs(def_store(IK::SQ, "sq"));  // Store Quadword
+  t.def_store<srt_ssimm16_srs>(IK::SB, "sb");  // Store Byte
+  t.def_store<srt_ssimm16_srs>(IK::SH, "sh");  // Store Halfword
+  t.def_store<srt_ssimm16_srs>(IK::SW, "sw");  // Store Word
+  t.def_store<srt_ssimm16_srs>(IK::SD, "sd");  // Store Doubleword
+  t.def_store<srt_ssimm16_srs>(IK::SQ, "sq");  // Store Quadword
 
   // loads in dsrt_ssimm16_srs
-  drt_ssimm16_srs(def_load(IK::LB, "lb"));    // Load Byte
-  drt_ssimm16_srs(def_load(IK::LBU, "lbu"));  // Load Byte Unsigned
-  drt_ssimm16_srs(def_load(IK::LH, "lh"));    // Load Halfword
-  drt_ssimm16_srs(def_load(IK::LHU, "lhu"));  // Load Halfword Unsigned
-  drt_ssimm16_srs(def_load(IK::LW, "lw"));    // Load Word
-  drt_ssimm16_srs(def_load(IK::LWU, "lwu"));  // Load Word Unsigned
-  drt_ssimm16_srs(def_load(IK::LD, "ld"));    // Load Doubleword
-  drt_ssimm16_srs(def_load(IK::LQ, "lq"));    // Load Quadword
-  drt_ssimm16_srs(def_load(IK::LDR, "ldr"));  // Load Doubleword Left
-  drt_ssimm16_srs(def_load(IK::LDL, "ldl"));  // Load Doubleword Right
-  drt_ssimm16_srs(def_load(IK::LWL, "lwl"));  // Load Word Left
-  drt_ssimm16_srs(def_load(IK::LWR, "lwr"));  // Load Word Right
+  t.def_load<drt_ssimm16_srs>(IK::LB, "lb");    // Load Byte
+  t.def_load<drt_ssimm16_srs>(IK::LBU, "lbu");  // Load Byte Unsigned
+  t.def_load<drt_ssimm16_srs>(IK::LH, "lh");    // Load Halfword
+  t.def_load<drt_ssimm16_srs>(IK::LHU, "lhu");  // Load Halfword Unsigned
+  t.def_load<drt_ssimm16_srs>(IK::LW, "lw");    // Load Word
+  t.def_load<drt_ssimm16_srs>(IK::LWU, "lwu");  // Load Word Unsigned
+  t.def_load<drt_ssimm16_srs>(IK::LD, "ld");    // Load Doubleword
+  t.def_load<drt_ssimm16_srs>(IK::LQ, "lq");    // Load Quadword
+  t.def_load<drt_ssimm16_srs>(IK::LDR, "ldr");  // Load Doubleword Left
+  t.def_load<drt_ssimm16_srs>(IK::LDL, "ldl");  // Load Doubleword Right
+  t.def_load<drt_ssimm16_srs>(IK::LWL, "lwl");  // Load Word Left
+  t.def_load<drt_ssimm16_srs>(IK::LWR, "lwr");  // Load Word Right
 
   // drd_srs_srt
-  drd_srs_srt(def(IK::DADDU, "daddu"));    // Doubleword Add Unsigned
-  drd_srs_srt(def(IK::SUBU, "subu"));      // Subtract Unsigned Word
-  drd_srs_srt(def(IK::ADDU, "addu"));      // Add Unsigned Word
-  drd_srs_srt(def(IK::DSUBU, "dsubu"));    // Doubleword Subtract Unsigned
-  drd_srs_srt(def(IK::MULT3, "mult3"));    // Multiply Word
-  drd_srs_srt(def(IK::MULTU3, "multu3"));  // Multiply Unsigned Word
-  drd_srs_srt(def(IK::AND, "and"));        // And
-  drd_srs_srt(def(IK::OR, "or"));          // Or
-  drd_srs_srt(def(IK::NOR, "nor"));        // Not Or
-  drd_srs_srt(def(IK::XOR, "xor"));        // Exclusive Or
-  drd_srs_srt(def(IK::MOVN, "movn"));      // Move Conditional on Not Zero
-  drd_srs_srt(def(IK::MOVZ, "movz"));      // Move Conditional on Zero
-  drd_srs_srt(def(IK::SLT, "slt"));        // Set on Less Than
-  drd_srs_srt(def(IK::SLTU, "sltu"));      // Set on Less Than Unsigned
+  t.def<drd_srs_srt>(IK::DADDU, "daddu");                          // Doubleword Add Unsigned
+  t.def<drd_srs_srt>(IK::SUBU, "subu");                            // Subtract Unsigned Word
+  t.def<drd_srs_srt>(IK::ADDU, "addu");                            // Add Unsigned Word
+  t.def<drd_srs_srt>(IK::DSUBU, "dsubu");                          // Doubleword Subtract Unsigned
+  t.def<drd_srs_srt>(IK::MULT3, "mult3").writes(HI).writes(LO);    // Multiply Word
+  t.def<drd_srs_srt>(IK::MULTU3, "multu3").writes(HI).writes(LO);  // Multiply Unsigned Word
+  t.def<drd_srs_srt>(IK::AND, "and");                              // And
+  t.def<drd_srs_srt>(IK::OR, "or");                                // Or
+  t.def<drd_srs_srt>(IK::NOR, "nor");                              // Not Or
+  t.def<drd_srs_srt>(IK::XOR, "xor");                              // Exclusive Or
+  t.def<drd_srs_srt>(IK::MOVN, "movn").conditional_def = true;     // Move Conditional on Not Zero
+  t.def<drd_srs_srt>(IK::MOVZ, "movz").conditional_def = true;     // Move Conditional on Zero
+  t.def<drd_srs_srt>(IK::SLT, "slt");                              // Set on Less Than
+  t.def<drd_srs_srt>(IK::SLTU, "sltu");                            // Set on Less Than Unsigned
 
   // fixed shifts
-  drd_srt_ssa(def(IK::SLL, "sll"));        // Shift Left Logical
-  drd_srt_ssa(def(IK::SRA, "sra"));        // Shift Right Arithmetic
-  drd_srt_ssa(def(IK::SRL, "srl"));        // Shift Right Logical
-  drd_srt_ssa(def(IK::DSLL, "dsll"));      // Doubleword Shift Left Logical
-  drd_srt_ssa(def(IK::DSLL32, "dsll32"));  // Doubleword Shift Left Logical Plus 32
-  drd_srt_ssa(def(IK::DSRA, "dsra"));      // Doubleword Shift Right Arithmetic
-  drd_srt_ssa(def(IK::DSRA32, "dsra32"));  // Doubleword Shift Right Arithmetic Plus 32
-  drd_srt_ssa(def(IK::DSRL, "dsrl"));      // Doubleword Shift Right Logical
-  drd_srt_ssa(def(IK::DSRL32, "dsrl32"));  // Doubleword Shift Right Logical Plus 32
+  t.def<drd_srt_ssa>(IK::SLL, "sll");        // Shift Left Logical
+  t.def<drd_srt_ssa>(IK::SRA, "sra");        // Shift Right Arithmetic
+  t.def<drd_srt_ssa>(IK::SRL, "srl");        // Shift Right Logical
+  t.def<drd_srt_ssa>(IK::DSLL, "dsll");      // Doubleword Shift Left Logical
+  t.def<drd_srt_ssa>(IK::DSLL32, "dsll32");  // Doubleword Shift Left Logical Plus 32
+  t.def<drd_srt_ssa>(IK::DSRA, "dsra");      // Doubleword Shift Right Arithmetic
+  t.def<drd_srt_ssa>(IK::DSRA32, "dsra32");  // Doubleword Shift Right Arithmetic Plus 32
+  t.def<drd_srt_ssa>(IK::DSRL, "dsrl");      // Doubleword Shift Right Logical
+  t.def<drd_srt_ssa>(IK::DSRL32, "dsrl32");  // Doubleword Shift Right Logical Plus 32
 
   // variable shifts
-  drd_srt_srs(def(IK::DSRAV, "dsrav"));  // Doubleword Shift Right Arithmetic Variable
-  drd_srt_srs(def(IK::SLLV, "sllv"));    // Shift Word Left Logical Variable
-  drd_srt_srs(def(IK::DSLLV, "dsllv"));  // Doubleword Shift Left Logical Variable
-  drd_srt_srs(def(IK::DSRLV, "dsrlv"));  // Doubleword Shift Right Logical Variable
+  t.def<drd_srt_srs>(IK::DSRAV, "dsrav");  // Doubleword Shift Right Arithmetic Variable
+  t.def<drd_srt_srs>(IK::SLLV, "sllv");    // Shift Word Left Logical Variable
+  t.def<drd_srt_srs>(IK::DSLLV, "dsllv");  // Doubleword Shift Left Logical Variable
+  t.def<drd_srt_srs>(IK::DSRLV, "dsrlv");  // Doubleword Shift Right Logical Variable
 
   // branch (two registers)
-  srs_srt_bt(def_branch(IK::BEQ, "beq"));           // Branch on Equal
-  srs_srt_bt(def_branch(IK::BNE, "bne"));           // Branch on Not Equal
-  srs_srt_bt(def_branch_likely(IK::BEQL, "beql"));  // Branch on Equal Likely
-  srs_srt_bt(def_branch_likely(IK::BNEL, "bnel"));  // Branch on Not Equal Likely
+  t.def_branch<srs_srt_bt>(IK::BEQ, "beq");           // Branch on Equal
+  t.def_branch<srs_srt_bt>(IK::BNE, "bne");           // Branch on Not Equal
+  t.def_branch_likely<srs_srt_bt>(IK::BEQL, "beql");  // Branch on Equal Likely
+  t.def_branch_likely<srs_srt_bt>(IK::BNEL, "bnel");  // Branch on Not Equal Likely
 
   // branch (one register)
-  srs_bt(def_branch(IK::BLTZ, "bltz"));      // Branch on Less Than Zero
-  srs_bt(def_branch(IK::BGEZ, "bgez"));      // Branch on Greater Than or Equal to Zero
-  srs_bt(def_branch(IK::BLEZ, "blez"));      // Branch on Less Than or Equal to Zero
-  srs_bt(def_branch(IK::BGTZ, "bgtz"));      // Branch on Greater Than Zero
-  srs_bt(def_branch(IK::BGEZAL, "bgezal"));  // Branch on Greater Than or Equal to Zero and Link
-  srs_bt(def_branch_likely(IK::BLTZL, "bltzl"));  // Branch on Less Than Zero Likely
-  srs_bt(def_branch_likely(IK::BGTZL, "bgtzl"));  // Branch on Greater Than Zero Likely
-  srs_bt(def_branch_likely(IK::BGEZL, "bgezl"));  // Branch on Greater Than or Equal to Zero Likely
+  t.def_branch<srs_bt>(IK::BLTZ, "bltz");  // Branch on Less Than Zero
+  t.def_branch<srs_bt>(IK::BGEZ, "bgez");  // Branch on Greater Than or Equal to Zero
+  t.def_branch<srs_bt>(IK::BLEZ, "blez");  // Branch on Less Than or Equal to Zero
+  t.def_branch<srs_bt>(IK::BGTZ, "bgtz");  // Branch on Greater Than Zero
+  // Branch on Greater Than or Equal to Zero and Link
+  t.def_branch<srs_bt>(IK::BGEZAL, "bgezal").writes(RA);
+  t.def_branch_likely<srs_bt>(IK::BLTZL, "bltzl");  // Branch on Less Than Zero Likely
+  t.def_branch_likely<srs_bt>(IK::BGTZL, "bgtzl");  // Branch on Greater Than Zero Likely
+  // Branch on Greater Than or Equal to Zero Likely
+  t.def_branch_likely<srs_bt>(IK::BGEZL, "bgezl");
 
   // weird ones
-  def(IK::DIV, "div").src_gpr(FT::RS).src_gpr(FT::RT);    // Divide Word
-  def(IK::DIVU, "divu").src_gpr(FT::RS).src_gpr(FT::RT);  // Divide Unsigned Word
-
-  def(IK::ORI, "ori").dst_gpr(FT::RT).src_gpr(FT::RS).src(FT::ZIMM16, DT::IMM);  // Or Immediate
-  def(IK::XORI, "xori")
-      .dst_gpr(FT::RT)
-      .src_gpr(FT::RS)
-      .src(FT::ZIMM16, DT::IMM);  // Exclusive Or Immediate
-  def(IK::ANDI, "andi").dst_gpr(FT::RT).src_gpr(FT::RS).src(FT::ZIMM16, DT::IMM);  // And Immediate
-
-  def(IK::LUI, "lui").dst_gpr(FT::RT).src(FT::SIMM16, DT::IMM);  // Load Upper Immediate
-  def(IK::JALR, "jalr").dst_gpr(FT::RD).src_gpr(FT::RS).has_delay_slot =
-      true;                                                 // Jump and Link Register
-  def(IK::JR, "jr").src_gpr(FT::RS).has_delay_slot = true;  // Jump Register
-
-  def_load(IK::LWC1, "lwc1")
-      .dst_fpr(FT::FT)
-      .src(FT::SIMM16, DT::IMM)
-      .src_gpr(FT::RS);  // Load Word to Floating Point
-  def_store(IK::SWC1, "swc1")
-      .src_fpr(FT::FT)
-      .src(FT::SIMM16, DT::IMM)
-      .src_gpr(FT::RS);  // Store Word from Floating Point
+  t.def<srs_srt>(IK::DIV, "div").writes(HI).writes(LO);    // Divide Word
+  t.def<srs_srt>(IK::DIVU, "divu").writes(HI).writes(LO);  // Divide Unsigned Word
+
+  t.def<drt_srs_szimm16>(IK::ORI, "ori");    // Or Immediate
+  t.def<drt_srs_szimm16>(IK::XORI, "xori");  // Exclusive Or Immediate
+  t.def<drt_srs_szimm16>(IK::ANDI, "andi");  // And Immediate
+
+  t.def<drt_ssimm16>(IK::LUI, "lui");                      // Load Upper Immediate
+  t.def<drd_srs>(IK::JALR, "jalr").has_delay_slot = true;  // Jump and Link Register
+  t.def<srs>(IK::JR, "jr").has_delay_slot = true;          // Jump Register
+
+  t.def_load<dft_ssimm16_srs>(IK::LWC1, "lwc1");   // Load Word to Floating Point
+  t.def_store<sft_ssimm16_srs>(IK::SWC1, "swc1");  // Store Word from Floating Point
 
   // weird moves
-  def(IK::MFC1, "mfc1").dst_gpr(FT::RT).src_fpr(FT::FS);  // Move Word from Floating Point
-  def(IK::MTC1, "mtc1").src_gpr(FT::RT).dst_fpr(FT::FS);  // Move Word to Floating Point
-  def(IK::MTC0, "mtc0")
-      .src_gpr(FT::RT)
-      .dst(FT::RD, DT::COP0);  // Move to System Control Coprocessor
-  def(IK::MFC0, "mfc0")
-      .dst_gpr(FT::RT)
-      .src(FT::RD, DT::COP0);                 // Move from System Control Coprocessor
-  def(IK::MTDAB, "mtdab").src_gpr(FT::RT);    // Move to Data Address Breakpoint Register
-  def(IK::MTDABM, "mtdabm").src_gpr(FT::RT);  // Move to Data Address Breakpoint Mask Register
-  drd(def(IK::MFHI, "mfhi"));                 // Move from HI Register
-  drd(def(IK::MFLO, "mflo"));                 // Move from LO Register
-  def(IK::MTLO1, "mtlo1").src_gpr(FT::RS);    // Move to LO1 Register
-  drd(def(IK::MFLO1, "mflo1"));               // Move from LO1 Register
-  drd(def(IK::PMFHL_UW, "pmfhl.uw"));         // Parallel Move From HI/LO Register
-  drd(def(IK::PMFHL_LW, "pmfhl.lw"));
-  drd(def(IK::PMFHL_LH, "pmfhl.lh"));
-  def(IK::MFPC, "mfpc").dst_gpr(FT::RT).src(FT::PCR, DT::PCR);  // Move from Performance Counter
-  def(IK::MTPC, "mtpc").src_gpr(FT::RT).dst(FT::PCR, DT::PCR);  // Move to Performance Counter
+  t.def<drt_sfs>(IK::MFC1, "mfc1");            // Move Word from Floating Point
+  t.def<srt_dfs>(IK::MTC1, "mtc1");            // Move Word to Floating Point
+  t.def<srt_dc0rd>(IK::MTC0, "mtc0");          // Move to System Control Coprocessor
+  t.def<drt_sc0rd>(IK::MFC0, "mfc0");          // Move from System Control Coprocessor
+  t.def<srt>(IK::MTDAB, "mtdab");              // Move to Data Address Breakpoint Register
+  t.def<srt>(IK::MTDABM, "mtdabm");            // Move to Data Address Breakpoint Mask Register
+  t.def<drd>(IK::MFHI, "mfhi").reads(HI);      // Move from HI Register
+  t.def<drd>(IK::MFLO, "mflo").reads(LO);      // Move from LO Register
+  t.def<srs>(IK::MTLO1, "mtlo1").writes(LO1);  // Move to LO1 Register
+  t.def<drd>(IK::MFLO1, "mflo1").reads(LO1);   // Move from LO1 Register
+  // Parallel Move From HI/LO Register. These read both halves of the 128-bit HI and LO.
+  t.def<drd>(IK::PMFHL_UW, "pmfhl.uw").reads(HI).reads(LO).reads(HI1).reads(LO1);
+  t.def<drd>(IK::PMFHL_LW, "pmfhl.lw").reads(HI).reads(LO).reads(HI1).reads(LO1);
+  t.def<drd>(IK::PMFHL_LH, "pmfhl.lh").reads(HI).reads(LO).reads(HI1).reads(LO1);
+  t.def<drt_spcr>(IK::MFPC, "mfpc");  // Move from Performance Counter
+  t.def<srt_dpcr>(IK::MTPC, "mtpc");  // Move to Performance Counter
 
   // other weirds
-  def(IK::SYSCALL, "syscall").src(FT::SYSCALL, DT::IMM);  // System Call
-  def(IK::CACHE_DXWBIN, "cache dxwbin")
-      .src_gpr(FT::RS)
-      .src(FT::SIMM16, DT::IMM);  // Cache Operation (Index Writeback Invalidate)
-  def(IK::PREF, "pref").src_gpr(FT::RT).src(FT::SIMM16, DT::IMM).src_gpr(FT::RS);  // Prefetch
+  t.def<ssyscall>(IK::SYSCALL, "syscall");  // System Call
+  // Cache Operation (Index Writeback Invalidate)
+  t.def<srs_ssimm16>(IK::CACHE_DXWBIN, "cache dxwbin");
+  t.def<srt_ssimm16_srs>(IK::PREF, "pref");  // Prefetch
 
   // plains
-  def(IK::SYNCP, "sync.p");  // Synchronize Shared Memory (Pipeline)
-  def(IK::SYNCL, "sync.l");  // Synchronize Shared Memory (Load)
-  def(IK::ERET, "eret");     // Exception Return
-  def(IK::EI, "ei");         // Enable Interrupt
-
-  drd_srs_srt(def(IK::PPACB, "ppacb"));    // Parallel Pack to Byte
-  drd_srs_srt(def(IK::PPACH, "ppach"));    // Parallel Pack to Halfword
-  drd_srs_srt(def(IK::PPACW, "ppacw"));    // Parallel Pack to Word
-  drd_srs_srt(def(IK::PADDH, "paddh"));    // Parallel Add Halfword
-  drd_srs_srt(def(IK::PADDW, "paddw"));    // Parallel Add Word
-  drd_srs_srt(def(IK::PSUBW, "psubw"));    // Parallel Subtract Word
-  drd_srs_srt(def(IK::PMINH, "pminh"));    // Parallel Minimize Halfword
-  drd_srs_srt(def(IK::PMINW, "pminw"));    // Parallel Minimize Word
-  drd_srs_srt(def(IK::PMAXH, "pmaxh"));    // Parallel Maximize Halfword
-  drd_srs_srt(def(IK::PMAXW, "pmaxw"));    // Parallel Maximize Word
-  drd_srs_srt(def(IK::PEXTLB, "pextlb"));  // Parallel Extend Lower from Byte
-  drd_srs_srt(def(IK::PEXTLH, "pextlh"));  // Parallel Extend Lower from Halfword
-  drd_srs_srt(def(IK::PEXTLW, "pextlw"));  // Parallel Extend Lower from Word
-  drd_srs_srt(def(IK::PCGTW, "pcgtw"));    // Parallel Compare for Greater Than Word
-  drd_srs_srt(def(IK::PCEQB, "pceqb"));    // Parallel Compare for Equal Byte
-  drd_srs_srt(def(IK::PCEQW, "pceqw"));    // Parallel Compare for Equal Word
-  drd_srs_srt(def(IK::PEXTUB, "pextub"));  // Parallel Extend Upper from Byte
-  drd_srs_srt(def(IK::PEXTUH, "pextuh"));  // Parallel Extend Upper from Halfword
-  drd_srs_srt(def(IK::PEXTUW, "pextuw"));  // Parallel Extend Upper from Word
-  drd_srs_srt(def(IK::PCPYUD, "pcpyud"));  // Parallel Copy Upper Doubleword
-  drd_srs_srt(def(IK::PCPYLD, "pcpyld"));  // Parallel Copy Lower Doubleword
-  drd_srs_srt(def(IK::PMADDH, "pmaddh"));  // Parallel Multiply-Add Halfword
-  drd_srs_srt(def(IK::PMULTH, "pmulth"));  // Parallel Multiply Halfword
-  drd_srs_srt(def(IK::PEXEW, "pexew"));    // Parallel Exchange Even Word
-  drd_srs_srt(def(IK::PINTEH, "pinteh"));  // Parallel Interleave Even Halfword
-  drd_srs_srt(def(IK::PAND, "pand"));      // Parallel And
-  drd_srs_srt(def(IK::POR, "por"));        // Parallel Or
-  drd_srs_srt(def(IK::PNOR, "pnor"));      // Parallel Not Or
-
-  drd_srt_ssa(def(IK::PSLLW, "psllw"));  // Parallel Shift Left Logical Word
-  drd_srt_ssa(def(IK::PSLLH, "psllh"));  // Parallel Shift Left Logical Halfword
-  drd_srt_ssa(def(IK::PSRAW, "psraw"));  // Parallel Shift Right Arithmetic Word
-  drd_srt_ssa(def(IK::PSRAH, "psrah"));  // Parallel Shift Right Arithmetic Halfword
-  drd_srt_ssa(def(IK::PSRLH, "psrlh"));  // Parallel Shift Right Logical Halfword
-
-  def(IK::PLZCW, "plzcw").dst_gpr(FT::RD).src_gpr(FT::RS);    // Parallel Leading Zero Count Word
-  def(IK::PABSW, "pabsw").dst_gpr(FT::RD).src_gpr(FT::RT);    // Parallel Absolute Word
-  def(IK::PROT3W, "prot3w").dst_gpr(FT::RD).src_gpr(FT::RT);  // Parallel Rotate 3 Word
-  def(IK::PCPYH, "pcpyh").dst_gpr(FT::RD).src_gpr(FT::RT);    // Parallel Copy Halfword
+  t.def<no_operands>(IK::SYNCP, "sync.p");  // Synchronize Shared Memory (Pipeline)
+  t.def<no_operands>(IK::SYNCL, "sync.l");  // Synchronize Shared Memory (Load)
+  t.def<no_operands>(IK::ERET, "eret");     // Exception Return
+  t.def<no_operands>(IK::EI, "ei");         // Enable Interrupt
+
+  t.def<drd_srs_srt>(IK::PPACB, "ppacb");    // Parallel Pack to Byte
+  t.def<drd_srs_srt>(IK::PPACH, "ppach");    // Parallel Pack to Halfword
+  t.def<drd_srs_srt>(IK::PPACW, "ppacw");    // Parallel Pack to Word
+  t.def<drd_srs_srt>(IK::PADDH, "paddh");    // Parallel Add Halfword
+  t.def<drd_srs_srt>(IK::PADDW, "paddw");    // Parallel Add Word
+  t.def<drd_srs_srt>(IK::PSUBW, "psubw");    // Parallel Subtract Word
+  t.def<drd_srs_srt>(IK::PMINH, "pminh");    // Parallel Minimize Halfword
+  t.def<drd_srs_srt>(IK::PMINW, "pminw");    // Parallel Minimize Word
+  t.def<drd_srs_srt>(IK::PMAXH, "pmaxh");    // Parallel Maximize Halfword
+  t.def<drd_srs_srt>(IK::PMAXW, "pmaxw");    // Parallel Maximize Word
+  t.def<drd_srs_srt>(IK::PEXTLB, "pextlb");  // Parallel Extend Lower from Byte
+  t.def<drd_srs_srt>(IK::PEXTLH, "pextlh");  // Parallel Extend Lower from Halfword
+  t.def<drd_srs_srt>(IK::PEXTLW, "pextlw");  // Parallel Extend Lower from Word
+  t.def<drd_srs_srt>(IK::PCGTW, "pcgtw");    // Parallel Compare for Greater Than Word
+  t.def<drd_srs_srt>(IK::PCEQB, "pceqb");    // Parallel Compare for Equal Byte
+  t.def<drd_srs_srt>(IK::PCEQW, "pceqw");    // Parallel Compare for Equal Word
+  t.def<drd_srs_srt>(IK::PEXTUB, "pextub");  // Parallel Extend Upper from Byte
+  t.def<drd_srs_srt>(IK::PEXTUH, "pextuh");  // Parallel Extend Upper from Halfword
+  t.def<drd_srs_srt>(IK::PEXTUW, "pextuw");  // Parallel Extend Upper from Word
+  t.def<drd_srs_srt>(IK::PCPYUD, "pcpyud");  // Parallel Copy Upper Doubleword
+  t.def<drd_srs_srt>(IK::PCPYLD, "pcpyld");  // Parallel Copy Lower Doubleword
+  // Parallel Multiply-Add Halfword and Parallel Multiply Halfword, on the 128-bit HI and LO.
+  t.def<drd_srs_srt>(IK::PMADDH, "pmaddh")
+      .reads(HI)
+      .reads(LO)
+      .reads(HI1)
+      .reads(LO1)
+      .writes(HI)
+      .writes(LO)
+      .writes(HI1)
+      .writes(LO1);
+  t.def<drd_srs_srt>(IK::PMULTH, "pmulth").writes(HI).writes(LO).writes(HI1).writes(LO1);
+  t.def<drd_srs_srt>(IK::PEXEW, "pexew");    // Parallel Exchange Even Word
+  t.def<drd_srs_srt>(IK::PINTEH, "pinteh");  // Parallel Interleave Even Halfword
+  t.def<drd_srs_srt>(IK::PAND, "pand");      // Parallel And
+  t.def<drd_srs_srt>(IK::POR, "por");        // Parallel Or
+  t.def<drd_srs_srt>(IK::PNOR, "pnor");      // Parallel Not Or
+
+  t.def<drd_srt_ssa>(IK::PSLLW, "psllw");  // Parallel Shift Left Logical Word
+  t.def<drd_srt_ssa>(IK::PSLLH, "psllh");  // Parallel Shift Left Logical Halfword
+  t.def<drd_srt_ssa>(IK::PSRAW, "psraw");  // Parallel Shift Right Arithmetic Word
+  t.def<drd_srt_ssa>(IK::PSRAH, "psrah");  // Parallel Shift Right Arithmetic Halfword
+  t.def<drd_srt_ssa>(IK::PSRLH, "psrlh");  // Parallel Shift Right Logical Halfword
+
+  t.def<drd_srs>(IK::PLZCW, "plzcw");    // Parallel Leading Zero Count Word
+  t.def<drd_srt>(IK::PABSW, "pabsw");    // Parallel Absolute Word
+  t.def<drd_srt>(IK::PROT3W, "prot3w");  // Parallel Rotate 3 Word
+  t.def<drd_srt>(IK::PCPYH, "pcpyh");    // Parallel Copy Halfword
 
   // COP1
 
   // branch (no registers)
-  bt(def_branch(IK::BC1F, "bc1f"));           // Branch on FP False
-  bt(def_branch(IK::BC1T, "bc1t"));           // Branch on FP True
-  bt(def_branch_likely(IK::BC1FL, "bc1fl"));  // Branch on FP False Likely
-  bt(def_branch_likely(IK::BC1TL, "bc1tl"));  // Branch on FP True Likely
-
-  dfd_sfs_sft(def(IK::ADDS, "add.s"));      // Floating Point Add
-  dfd_sfs_sft(def(IK::SUBS, "sub.s"));      // Floating Point Subtract
-  dfd_sfs_sft(def(IK::MULS, "mul.s"));      // Floating Point Multiply
-  dfd_sfs_sft(def(IK::DIVS, "div.s"));      // Floating Point Divide
-  dfd_sfs_sft(def(IK::MINS, "min.s"));      // Floating Point Minimum
-  dfd_sfs_sft(def(IK::MAXS, "max.s"));      // Floating Point Maximum
-  dfd_sfs_sft(def(IK::MADDS, "madd.s"));    // Floating Point Multiply-Add
-  dfd_sfs_sft(def(IK::MSUBS, "msub.s"));    // Floating Point Multiply and Subtract
-  dfd_sfs_sft(def(IK::RSQRTS, "rsqrt.s"));  // Floating Point Reciporcal Square Root
-
-  dfd_sfs(def(IK::ABSS, "abs.s"));     // Floating Point Absolute Value
-  dfd_sfs(def(IK::NEGS, "neg.s"));     // Floating Point Negate
-  dfd_sfs(def(IK::CVTSW, "cvt.s.w"));  // Fixed-point Convert to Single Floating Point
-  dfd_sfs(def(IK::CVTWS, "cvt.w.s"));  // Floating Point Convert to Word Fixed-point
-  dfd_sfs(def(IK::MOVS, "mov.s"));     // Floating Point Move
-  dfd_sfs(def(IK::SQRTS, "sqrt.s"));   // Floating Point Square Root
-
-  sfs_sft(def(IK::CLTS, "c.lt.s"));     // Floating Point Compare
-  sfs_sft(def(IK::CLES, "c.le.s"));     // Floating Point Compare
-  sfs_sft(def(IK::CEQS, "c.eq.s"));     // Floating Point Compare
-  sfs_sft(def(IK::MULAS, "mula.s"));    // Floating Point Multiply to Accumulator
-  sfs_sft(def(IK::MADDAS, "madda.s"));  // Floating Point Multiply-Add to Accumulator
-  sfs_sft(def(IK::ADDAS, "adda.s"));    // Floating Point Add to Accumulator
-  sfs_sft(def(IK::MSUBAS, "msuba.s"));  // Floating Point Multiply and Subtract from Accumulator
+  t.def_branch<bt>(IK::BC1F, "bc1f").reads(FPU_CC);           // Branch on FP False
+  t.def_branch<bt>(IK::BC1T, "bc1t").reads(FPU_CC);           // Branch on FP True
+  t.def_branch_likely<bt>(IK::BC1FL, "bc1fl").reads(FPU_CC);  // Branch on FP False Likely
+  t.def_branch_likely<bt>(IK::BC1TL, "bc1tl").reads(FPU_CC);  // Branch on FP True Likely
+
+  t.def<dfd_sfs_sft>(IK::ADDS, "add.s");                   // Floating Point Add
+  t.def<dfd_sfs_sft>(IK::SUBS, "sub.s");                   // Floating Point Subtract
+  t.def<dfd_sfs_sft>(IK::MULS, "mul.s");                   // Floating Point Multiply
+  t.def<dfd_sfs_sft>(IK::DIVS, "div.s");                   // Floating Point Divide
+  t.def<dfd_sfs_sft>(IK::MINS, "min.s");                   // Floating Point Minimum
+  t.def<dfd_sfs_sft>(IK::MAXS, "max.s");                   // Floating Point Maximum
+  t.def<dfd_sfs_sft>(IK::MADDS, "madd.s").reads(FPU_ACC);  // Floating Point Multiply-Add
+  t.def<dfd_sfs_sft>(IK::MSUBS, "msub.s").reads(FPU_ACC);  // Floating Point Multiply and Subtract
+  t.def<dfd_sfs_sft>(IK::RSQRTS, "rsqrt.s");               // Floating Point Reciporcal Square Root
+
+  t.def<dfd_sfs>(IK::ABSS, "abs.s");     // Floating Point Absolute Value
+  t.def<dfd_sfs>(IK::NEGS, "neg.s");     // Floating Point Negate
+  t.def<dfd_sfs>(IK::CVTSW, "cvt.s.w");  // Fixed-point Convert to Single Floating Point
+  t.def<dfd_sfs>(IK::CVTWS, "cvt.w.s");  // Floating Point Convert to Word Fixed-point
+  t.def<dfd_sfs>(IK::MOVS, "mov.s");     // Floating Point Move
+  t.def<dfd_sfs>(IK::SQRTS, "sqrt.s");   // Floating Point Square Root
+
+  t.def<sfs_sft>(IK::CLTS, "c.lt.s").writes(FPU_CC);    // Floating Point Compare
+  t.def<sfs_sft>(IK::CLES, "c.le.s").writes(FPU_CC);    // Floating Point Compare
+  t.def<sfs_sft>(IK::CEQS, "c.eq.s").writes(FPU_CC);    // Floating Point Compare
+  t.def<sfs_sft>(IK::MULAS, "mula.s").writes(FPU_ACC);  // Floating Point Multiply to Accumulator
+  // Floating Point Multiply-Add to Accumulator
+  t.def<sfs_sft>(IK::MADDAS, "madda.s").reads(FPU_ACC).writes(FPU_ACC);
+  t.def<sfs_sft>(IK::ADDAS, "adda.s").writes(FPU_ACC);  // Floating Point Add to Accumulator
+  // Floating Point Multiply and Subtract from Accumulator
+  t.def<sfs_sft>(IK::MSUBAS, "msuba.s").reads(FPU_ACC).writes(FPU_ACC);
 
   // COP2 weirds
-  def_store(IK::SQC2, "sqc2")
-      .src(FT::FT, DT::VF)
-      .src(FT::SIMM16, DT::IMM)
-      .src_gpr(FT::RS);  // Store Quadword from COP2
-  def_load(IK::LQC2, "lqc2")
-      .dst(FT::FT, DT::VF)
-      .src(FT::SIMM16, DT::IMM)
-      .src_gpr(FT::RS);  // Load Quadword to COP2
+  t.def_store<svft_ssimm16_srs>(IK::SQC2, "sqc2");  // Store Quadword from COP2
+  t.def_load<dvft_ssimm16_srs>(IK::LQC2, "lqc2");   // Load Quadword to COP2
 
   // COP2
-  cd_dvft_svfs(def(IK::VMOVE, "vmove"));      // Transfer between Floating-Point Registers
-  cd_dvft_svfs(def(IK::VFTOI0, "vftoi0"));    // Conversion to Fixed Point
-  cd_dvft_svfs(def(IK::VFTOI4, "vftoi4"));    // Conversion to Fixed Point
-  cd_dvft_svfs(def(IK::VFTOI12, "vftoi12"));  // Conversion to Fixed Point
-  cd_dvft_svfs(def(IK::VITOF0, "vitof0"));    // Conversion to Floating Point Number
-  cd_dvft_svfs(def(IK::VITOF12, "vitof12"));  // Conversion to Floating Point Number
-  cd_dvft_svfs(def(IK::VITOF15, "vitof15"));  // Conversion to Floating Point Number
-  cd_dvft_svfs(def(IK::VABS, "vabs"));        // Absolute Value
-
-  cd_dvfd_svfs_svft(def(IK::VADD, "vadd"));
-  cd_dvfd_svfs_svft(def(IK::VSUB, "vsub"));
-  cd_dvfd_svfs_svft(def(IK::VMUL, "vmul"));
-  cd_dvfd_svfs_svft(def(IK::VMINI, "vmini"));
-  cd_dvfd_svfs_svft(def(IK::VMAX, "vmax"));
-  cd_dvfd_svfs_svft(def(IK::VOPMSUB, "vopmsub"));
-  cd_dvfd_svfs_svft(def(IK::VMADD, "vmadd"));
-  cd_dvfd_svfs_svft(def(IK::VMSUB, "vmsub"));
-
-  cb_cd_dvfd_svfs_svft(def(IK::VSUB_BC, "vsub"));
-  cb_cd_dvfd_svfs_svft(def(IK::VADD_BC, "vadd"));
-  cb_cd_dvfd_svfs_svft(def(IK::VMADD_BC, "vmadd"));
-  cb_cd_dvfd_svfs_svft(def(IK::VMSUB_BC, "vmsub"));
-  cb_cd_dvfd_svfs_svft(def(IK::VMUL_BC, "vmul"));
-  cb_cd_dvfd_svfs_svft(def(IK::VMINI_BC, "vmini"));
-  cb_cd_dvfd_svfs_svft(def(IK::VMAX_BC, "vmax"));
-
-  cb_cd_dacc_svfs_svft(def(IK::VADDA_BC, "vadda"));
-  cb_cd_dacc_svfs_svft(def(IK::VMADDA_BC, "vmadda"));
-  cb_cd_dacc_svfs_svft(def(IK::VMULA_BC, "vmula"));
-  cb_cd_dacc_svfs_svft(def(IK::VMSUBA_BC, "vmsuba"));
-
-  cd_dvfd_svfs_sq(def(IK::VADDQ, "vaddq"));
-  cd_dvfd_svfs_sq(def(IK::VSUBQ, "vsubq"));
-  cd_dvfd_svfs_sq(def(IK::VMULQ, "vmulq"));
-  cd_dvfd_svfs_sq(def(IK::VMSUBQ, "vmsubq"));
-
-  cd_dacc_svfs_svft(def(IK::VMULA, "vmula"));
-  cd_dacc_svfs_svft(def(IK::VADDA, "vadda"));
-  cd_dacc_svfs_svft(def(IK::VMADDA, "vmadda"));
-
-  cd_dacc_svfs_svft(def(IK::VOPMULA, "vopmula"));
+  t.def<cd_dvft_svfs>(IK::VMOVE, "vmove");      // Transfer between Floating-Point Registers
+  t.def<cd_dvft_svfs>(IK::VFTOI0, "vftoi0");    // Conversion to Fixed Point
+  t.def<cd_dvft_svfs>(IK::VFTOI4, "vftoi4");    // Conversion to Fixed Point
+  t.def<cd_dvft_svfs>(IK::VFTOI12, "vftoi12");  // Conversion to Fixed Point
+  t.def<cd_dvft_svfs>(IK::VITOF0, "vitof0");    // Conversion to Floating Point Number
+  t.def<cd_dvft_svfs>(IK::VITOF12, "vitof12");  // Conversion to Floating Point Number
+  t.def<cd_dvft_svfs>(IK::VITOF15, "vitof15");  // Conversion to Floating Point Number
+  t.def<cd_dvft_svfs>(IK::VABS, "vabs");        // Absolute Value
+
+  t.def<cd_dvfd_svfs_svft>(IK::VADD, "vadd");
+  t.def<cd_dvfd_svfs_svft>(IK::VSUB, "vsub");
+  t.def<cd_dvfd_svfs_svft>(IK::VMUL, "vmul");
+  t.def<cd_dvfd_svfs_svft>(IK::VMINI, "vmini");
+  t.def<cd_dvfd_svfs_svft>(IK::VMAX, "vmax");
+  t.def<cd_dvfd_svfs_svft>(IK::VOPMSUB, "vopmsub").reads(VU_ACC);
+  t.def<cd_dvfd_svfs_svft>(IK::VMADD, "vmadd").reads(VU_ACC);
+  t.def<cd_dvfd_svfs_svft>(IK::VMSUB, "vmsub").reads(VU_ACC);
+
+  t.def<cb_cd_dvfd_svfs_svft>(IK::VSUB_BC, "vsub");
+  t.def<cb_cd_dvfd_svfs_svft>(IK::VADD_BC, "vadd");
+  t.def<cb_cd_dvfd_svfs_svft>(IK::VMADD_BC, "vmadd").reads(VU_ACC);
+  t.def<cb_cd_dvfd_svfs_svft>(IK::VMSUB_BC, "vmsub").reads(VU_ACC);
+  t.def<cb_cd_dvfd_svfs_svft>(IK::VMUL_BC, "vmul");
+  t.def<cb_cd_dvfd_svfs_svft>(IK::VMINI_BC, "vmini");
+  t.def<cb_cd_dvfd_svfs_svft>(IK::VMAX_BC, "vmax");
+
+  t.def<cb_cd_dacc_svfs_svft>(IK::VADDA_BC, "vadda");
+  t.def<cb_cd_dacc_svfs_svft>(IK::VMADDA_BC, "vmadda").reads(VU_ACC);
+  t.def<cb_cd_dacc_svfs_svft>(IK::VMULA_BC, "vmula");
+  t.def<cb_cd_dacc_svfs_svft>(IK::VMSUBA_BC, "vmsuba").reads(VU_ACC);
+
+  t.def<cd_dvfd_svfs_sq>(IK::VADDQ, "vaddq");
+  t.def<cd_dvfd_svfs_sq>(IK::VSUBQ, "vsubq");
+  t.def<cd_dvfd_svfs_sq>(IK::VMULQ, "vmulq");
+  t.def<cd_dvfd_svfs_sq>(IK::VMSUBQ, "vmsubq").reads(VU_ACC);
+
+  t.def<cd_dacc_svfs_svft>(IK::VMULA, "vmula");
+  t.def<cd_dacc_svfs_svft>(IK::VADDA, "vadda");
+  t.def<cd_dacc_svfs_svft>(IK::VMADDA, "vmadda").reads(VU_ACC);
+
+  t.def<cd_dacc_svfs_svft>(IK::VOPMULA, "vopmula");
 
   // weird
-  def(IK::VDIV, "vdiv")
-      .dst(FT::ZERO, DT::VU_Q)
-      .src_vf(FT::FS)
-      .src_vf(FT::FT)
-      .src(FT::BC, DT::BC);  // todo
-  def(IK::VRSQRT, "vrsqrt")
-      .dst(FT::ZERO, DT::VU_Q)
-      .src_vf(FT::FS)
-      .src_vf(FT::FT)
-      .src(FT::BC, DT::BC);  // todo
-  def(IK::VCLIP, "vclip").src(FT::DEST, DT::DEST).src_vf(FT::FS).src_vf(FT::FT);
-  def(IK::VMULAQ, "vmulaq")
-      .src(FT::DEST, DT::DEST)
-      .dst(FT::ZERO, DT::VU_ACC)
-      .src_vf(FT::FS)
-      .src(FT::ZERO, DT::VU_Q);
-
-  def(IK::VRGET, "vrget").src(FT::DEST, DT::DEST).dst_vf(FT::FT);
+  t.def<dq_svfs_svft_cb>(IK::VDIV, "vdiv");      // todo
+  t.def<dq_svfs_svft_cb>(IK::VRSQRT, "vrsqrt");  // todo
+  t.def<cd_svfs_svft>(IK::VCLIP, "vclip");
+  t.def<cd_dacc_svfs_sq>(IK::VMULAQ, "vmulaq");
+
+  t.def<cd_dvft>(IK::VRGET, "vrget");
 
   // integer
-  def(IK::VMTIR, "vmtir").dst(FT::RT, DT::VI).src_vf(FT::FS).src(FT::BC, DT::BC);
-  def(IK::VIAND, "viand").dst_vi(FT::FD).src_vi(FT::FS).src_vi(FT::FT);
-  def(IK::VLQI, "vlqi").src(FT::DEST, DT::DEST).dst_vf(FT::FT).src_vi(FT::FS);  // todo inc
-  def(IK::VSQI, "vsqi").src(FT::DEST, DT::DEST).src_vf(FT::FS).src_vi(FT::FT);  // todo inc
-  def(IK::VIADDI, "viaddi").dst_vi(FT::FT).src_vi(FT::FS).src(FT::IMM5, DT::IMM);
-
-  def(IK::QMFC2, "qmfc2").src(FT::IL, DT::IL).dst_gpr(FT::RT).src_vf(FT::FS);
-  def(IK::QMTC2, "qmtc2").src(FT::IL, DT::IL).src_gpr(FT::RT).dst_vf(FT::FS);
-  def(IK::VSQRT, "vsqrt").src(FT::BC, DT::BC).dst(FT::ZERO, DT::VU_Q).src_vf(FT::FT);
-  def(IK::VRXOR, "vrxor").src(FT::BC, DT::BC).src_vf(FT::FS);
-  def(IK::VRNEXT, "vrnext").src(FT::DEST, DT::DEST).dst_vf(FT::FT);
-  def(IK::CTC2, "ctc2").src(FT::IL, DT::IL).src_gpr(FT::RT).dst(FT::RD, DT::VI);
-  def(IK::CFC2, "cfc2").src(FT::IL, DT::IL).dst_gpr(FT::RT).src(FT::RD, DT::VI);
-
-  def(IK::VCALLMS, "vcallms").src(FT::IMM15, DT::VCALLMS_TARGET);
-
-  def(IK::VNOP, "vnop");
-  def(IK::VWAITQ, "vwaitq");
-
-  uint32_t valid_count = 0, total_count = 0;
-  for (auto& info : gOpcodeInfo) {
-    if (info.defined) {
-      valid_count++;
+  t.def<dvirt_svfs_cb>(IK::VMTIR, "vmtir");
+  t.def<dvifd_svifs_svift>(IK::VIAND, "viand");
+  t.def<cd_dvft_svifs>(IK::VLQI, "vlqi").reads_memory = true;   // todo inc
+  t.def<cd_svfs_svift>(IK::VSQI, "vsqi").writes_memory = true;  // todo inc
+  t.def<dvift_svifs_simm5>(IK::VIADDI, "viaddi");
+
+  t.def<cil_drt_svfs>(IK::QMFC2, "qmfc2");
+  t.def<cil_srt_dvfs>(IK::QMTC2, "qmtc2");
+  t.def<cb_dq_svft>(IK::VSQRT, "vsqrt");
+  t.def<cb_svfs>(IK::VRXOR, "vrxor");
+  t.def<cd_dvft>(IK::VRNEXT, "vrnext");
+  t.def<cil_srt_dvird>(IK::CTC2, "ctc2");
+  t.def<cil_drt_svird>(IK::CFC2, "cfc2");
+
+  t.def<vcallms>(IK::VCALLMS, "vcallms");
+
+  t.def<no_operands>(IK::VNOP, "vnop");
+  t.def<no_operands>(IK::VWAITQ, "vwaitq").reads(VU_Q);
+
+  return t;
+}
+
+/*!
+ * Check that every opcode except UNKNOWN is in the table.
+ */
+constexpr bool all_opcodes_defined(const OpcodeTable& table) {
+  for (uint32_t i = 1; i < (uint32_t)IK::EE_OP_MAX; i++) {
+    if (!table.info[i].defined) {
+      return false;
     }
-    total_count++;
   }
-
-  // for the UNKNOWN op which shouldn't be valid.
-  total_count--;
-  assert(total_count == valid_count);
+  return !table.info[0].defined;
 }
 
-void OpcodeInfo::step(DecodeStep& s) {
-  assert(step_count < MAX_DECODE_STEPS);
-  steps[step_count] = s;
-  step_count++;
-  defined = true;
-}
-
-OpcodeInfo& OpcodeInfo::src(FieldType field, DecodeType decode) {
-  DecodeStep new_step;
-  new_step.is_src = true;
-  new_step.field = field;
-  new_step.decode = decode;
-  step(new_step);
-  return *this;
-}
-
-OpcodeInfo& OpcodeInfo::src_gpr(FieldType field) {
-  return src(field, DT::GPR);
-}
-
-OpcodeInfo& OpcodeInfo::src_fpr(FieldType field) {
-  return src(field, DT::FPR);
-}
-
-OpcodeInfo& OpcodeInfo::src_vf(FieldType field) {
-  return src(field, DT::VF);
-}
-
-OpcodeInfo& OpcodeInfo::src_vi(FieldType field) {
-  return src(field, DT::VI);
-}
-
-OpcodeInfo& OpcodeInfo::dst(FieldType field, DecodeType decode) {
-  DecodeStep new_step;
-  new_step.is_src = false;
-  new_step.field = field;
-  new_step.decode = decode;
-  step(new_step);
-  return *this;
-}
-
-OpcodeInfo& OpcodeInfo::dst_gpr(FieldType field) {
-  return dst(field, DT::GPR);
-}
-
-OpcodeInfo& OpcodeInfo::dst_fpr(FieldType field) {
-  return dst(field, DT::FPR);
-}
-
-OpcodeInfo& OpcodeInfo::dst_vf(FieldType field) {
-  return dst(field, DT::VF);
-}
+constexpr OpcodeTable opcode_table = make_opcode_table();
+static_assert(all_opcodes_defined(opcode_table), "opcode table is missing an opcode");
+}  // namespace
 
-OpcodeInfo& OpcodeInfo::dst_vi(FieldType field) {
-  return dst(field, DT::VI);
-}
\ No newline at end of file
+const OpcodeInfo (&gOpcodeInfo)[(uint32_t)InstructionKind::EE_OP_MAX] = opcode_table.info;
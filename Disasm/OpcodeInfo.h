@@ -6,7 +6,11 @@
 #ifndef NEXT_OPCODEINFO_H
 #define NEXT_OPCODEINFO_H
 
-#include <string>
+#include <cstdint>
+#include "Register.h"
+
+class Instruction;
+class LinkedObjectFile;
 
 enum class InstructionKind {
   UNKNOWN,
@@ -309,43 +313,63 @@ enum class DecodeType {
 
 struct DecodeStep {
   bool is_src = false;
-  FieldType field;
-  DecodeType decode;
+  FieldType field = FieldType::ZERO;
+  DecodeType decode = DecodeType::IMM;
 };
 
 constexpr int MAX_DECODE_STEPS = 5;
 
+typedef void (*OperandExtractor)(Instruction& instr,
+                                 uint32_t data,
+                                 LinkedObjectFile& file,
+                                 int seg_id,
+                                 int word_id);
+
+/*!
+ * Information about an opcode. The table of these is built at compile time, in OpcodeInfo.cpp.
+ */
 struct OpcodeInfo {
-  std::string name;
+  const char* name = nullptr;
 
   bool is_branch = false;
   bool is_branch_likely = false;
   bool can_lo16_link = false;
   bool defined = false;
-  bool is_store = false;
-  bool is_load = false;
+  bool is_store = false;  // printed with store syntax. (all stores also write memory)
+  bool is_load = false;   // printed with load syntax. (all loads also read memory)
   bool has_delay_slot = false;
 
-  void step(DecodeStep& s);
-
-  OpcodeInfo& src(FieldType field, DecodeType decode);
-  OpcodeInfo& src_gpr(FieldType field);
-  OpcodeInfo& src_fpr(FieldType field);
-  OpcodeInfo& src_vf(FieldType field);
-  OpcodeInfo& src_vi(FieldType field);
-
-  OpcodeInfo& dst(FieldType field, DecodeType decode);
-  OpcodeInfo& dst_gpr(FieldType field);
-  OpcodeInfo& dst_fpr(FieldType field);
-  OpcodeInfo& dst_vf(FieldType field);
-  OpcodeInfo& dst_vi(FieldType field);
-
-  uint8_t step_count;
-  DecodeStep steps[MAX_DECODE_STEPS];
+  // def/use information, in addition to the source/destination operands.
+  bool reads_memory = false;
+  bool writes_memory = false;
+  bool conditional_def = false;  // destination is only sometimes written, so it's also read
+  RegisterSet implicit_use;      // registers read that aren't source operands (hi, lo, acc, ...)
+  RegisterSet implicit_def;      // registers written that aren't destination operands
+
+  constexpr OpcodeInfo& reads(Register r) {
+    implicit_use.insert(r);
+    return *this;
+  }
+
+  constexpr OpcodeInfo& writes(Register r) {
+    implicit_def.insert(r);
+    return *this;
+  }
+
+  constexpr void step(const DecodeStep& s) {
+    assert(step_count < MAX_DECODE_STEPS);
+    steps[step_count] = s;
+    step_count++;
+    defined = true;
+  }
+
+  // fills out the operands of an instruction, generated from the operand layout.
+  OperandExtractor extract_operands = nullptr;
+
+  uint8_t step_count = 0;
+  DecodeStep steps[MAX_DECODE_STEPS] = {};
 };
 
-extern OpcodeInfo gOpcodeInfo[(uint32_t)InstructionKind::EE_OP_MAX];
-
-void init_opcode_info();
+extern const OpcodeInfo (&gOpcodeInfo)[(uint32_t)InstructionKind::EE_OP_MAX];
 
 #endif  // NEXT_OPCODEINFO_H
@@ -0,0 +1,222 @@
+/*!
+ * @file OperandLayout.h
+ * Compile-time operand layouts for EE instructions.
+ * Each layout is a list of decode steps. From a single layout we generate both the DecodeStep
+ * table stored in OpcodeInfo and a specialized function to extract the operands of an instruction,
+ * so decoding doesn't have to interpret the steps at runtime.
+ */
+
+#ifndef NEXT_OPERANDLAYOUT_H
+#define NEXT_OPERANDLAYOUT_H
+
+#include "Instruction.h"
+#include "OpcodeFields.h"
+
+/*!
+ * Get the label for a branch target. Implemented in InstructionDecode.cpp so that layouts don't
+ * depend on LinkedObjectFile.
+ */
+int get_branch_target_label(LinkedObjectFile& file, int seg_id, int word_id, int32_t offset);
+
+/*!
+ * Extract a single field. The switch is on a template parameter, so only one case is kept.
+ */
+template <FieldType field>
+inline int32_t extract_field(OpcodeFields fields) {
+  switch (field) {
+    case FieldType::RS:
+      return fields.rs();
+    case FieldType::RT:
+      return fields.rt();
+    case FieldType::RD:
+      return fields.rd();
+    case FieldType::SA:
+      return fields.sa();
+    case FieldType::FT:
+      return fields.ft();
+    case FieldType::FS:
+      return fields.fs();
+    case FieldType::FD:
+      return fields.fd();
+    case FieldType::SYSCALL:
+      return fields.syscall();
+    case FieldType::SIMM16:
+      return fields.simm16();
+    case FieldType::ZIMM16:
+      return fields.zimm16();
+    case FieldType::PCR:
+      return fields.pcreg();
+    case FieldType::DEST:
+      return fields.dest();
+    case FieldType::BC:
+      return fields.data & 0b11;
+    case FieldType::IMM5:
+      return fields.imm5();
+    case FieldType::IMM15:
+      return fields.imm15();
+    case FieldType::IL:
+      return fields.data & 1;
+    case FieldType::ZERO:
+      return 0;
+  }
+  return 0;
+}
+
+/*!
+ * A single decode step: read a field, then turn it into an atom (or an instruction property).
+ */
+template <bool is_src, FieldType field, DecodeType decode>
+struct OperandStep {
+  // does this step add an atom? (IL, DEST and BC set a property of the instruction instead)
+  static constexpr bool has_atom =
+      decode != DecodeType::IL && decode != DecodeType::DEST && decode != DecodeType::BC;
+  static constexpr int n_src = (is_src && has_atom) ? 1 : 0;
+  static constexpr int n_dst = (!is_src && has_atom) ? 1 : 0;
+
+  static constexpr void add_step(OpcodeInfo& info) {
+    DecodeStep s;
+    s.is_src = is_src;
+    s.field = field;
+    s.decode = decode;
+    info.step(s);
+  }
+
+  static void extract(Instruction& instr,
+                      OpcodeFields fields,
+                      LinkedObjectFile& file,
+                      int seg_id,
+                      int word_id) {
+    int32_t value = extract_field<field>(fields);
+
+    switch (decode) {
+      case DecodeType::IL:
+        instr.il = value;
+        return;
+      case DecodeType::DEST:
+        instr.cop2_dest = value;
+        return;
+      case DecodeType::BC:
+        instr.cop2_bc = value;
+        return;
+      default:
+        break;
+    }
+
+    // the layout's atom count is checked at compile time, so we can write the atom in place.
+    InstructionAtom& atom = is_src ? instr.src[instr.n_src++] : instr.dst[instr.n_dst++];
+    switch (decode) {
+      case DecodeType::GPR:
+        atom.set_reg(Register(Reg::GPR, value));
+        break;
+      case DecodeType::FPR:
+        atom.set_reg(Register(Reg::FPR, value));
+        break;
+      case DecodeType::COP0:
+        atom.set_reg(Register(Reg::COP0, value));
+        break;
+      case DecodeType::PCR:
+        atom.set_reg(Register(Reg::PCR, value));
+        break;
+      case DecodeType::IMM:
+        atom.set_imm(value);
+        break;
+      case DecodeType::VF:
+        atom.set_reg(Register(Reg::VF, value));
+        break;
+      case DecodeType::VI:
+        atom.set_reg(Register(Reg::VI, value));
+        break;
+      case DecodeType::VU_ACC:
+        atom.set_vu_acc();
+        break;
+      case DecodeType::VU_Q:
+        atom.set_vu_q();
+        break;
+      case DecodeType::VCALLMS_TARGET:
+        atom.set_imm(value * 8);
+        break;
+      case DecodeType::BRANCH_TARGET:
+        atom.set_label(get_branch_target_label(file, seg_id, word_id, value));
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+template <FieldType field, DecodeType decode>
+using Src = OperandStep<true, field, decode>;
+template <FieldType field, DecodeType decode>
+using Dst = OperandStep<false, field, decode>;
+
+template <FieldType field>
+using SrcGpr = Src<field, DecodeType::GPR>;
+template <FieldType field>
+using SrcFpr = Src<field, DecodeType::FPR>;
+template <FieldType field>
+using SrcVf = Src<field, DecodeType::VF>;
+template <FieldType field>
+using SrcVi = Src<field, DecodeType::VI>;
+
+template <FieldType field>
+using DstGpr = Dst<field, DecodeType::GPR>;
+template <FieldType field>
+using DstFpr = Dst<field, DecodeType::FPR>;
+template <FieldType field>
+using DstVf = Dst<field, DecodeType::VF>;
+template <FieldType field>
+using DstVi = Dst<field, DecodeType::VI>;
+
+/*!
+ * An operand layout: a list of OperandSteps, applied in order.
+ */
+template <typename... Steps>
+struct OperandLayout;
+
+template <>
+struct OperandLayout<> {
+  static constexpr int n_steps = 0;
+  static constexpr int n_src = 0;
+  static constexpr int n_dst = 0;
+
+  static constexpr void add_steps(OpcodeInfo&) {}
+  static void extract(Instruction&, OpcodeFields, LinkedObjectFile&, int, int) {}
+};
+
+template <typename First, typename... Rest>
+struct OperandLayout<First, Rest...> {
+  static constexpr int n_steps = 1 + OperandLayout<Rest...>::n_steps;
+  static constexpr int n_src = First::n_src + OperandLayout<Rest...>::n_src;
+  static constexpr int n_dst = First::n_dst + OperandLayout<Rest...>::n_dst;
+  static_assert(n_steps <= MAX_DECODE_STEPS, "too many decode steps");
+  static_assert(n_src <= MAX_INSTRUCTION_SOURCE, "too many source atoms");
+  static_assert(n_dst <= MAX_INTRUCTION_DEST, "too many destination atoms");
+
+  static constexpr void add_steps(OpcodeInfo& info) {
+    First::add_step(info);
+    OperandLayout<Rest...>::add_steps(info);
+  }
+
+  static void extract(Instruction& instr,
+                      OpcodeFields fields,
+                      LinkedObjectFile& file,
+                      int seg_id,
+                      int word_id) {
+    First::extract(instr, fields, file, seg_id, word_id);
+    OperandLayout<Rest...>::extract(instr, fields, file, seg_id, word_id);
+  }
+};
+
+/*!
+ * The function called by decode_instruction to fill out the operands of an instruction.
+ */
+template <typename Layout>
+void extract_operands(Instruction& instr,
+                      uint32_t data,
+                      LinkedObjectFile& file,
+                      int seg_id,
+                      int word_id) {
+  Layout::extract(instr, OpcodeFields(data), file, seg_id, word_id);
+}
+
+#endif  // NEXT_OPERANDLAYOUT_H
@@ -39,6 +39,9 @@ const static char* vi_names[32] = {
 
 const static char* pcr_names[2] = {"pcr0", "pcr1"};
 
+const static char* special_names[Reg::MAX_SPECIAL] = {"hi",     "lo",     "hi1", "lo1",
+                                                      "fpuacc", "fpucc",  "acc", "Q"};
+
 /////////////////////////////
 // Register Names Conversion
 /////////////////////////////
@@ -73,6 +76,11 @@ const char* pcr_to_charp(uint32_t pcr) {
   assert(pcr < 2);
   return pcr_names[pcr];
 }
+
+const char* special_to_charp(Reg::Special reg) {
+  assert(reg < Reg::MAX_SPECIAL);
+  return special_names[reg];
+}
 }  // namespace
 
 /////////////////////////////
@@ -85,29 +93,6 @@ const char* pcr_to_charp(uint32_t pcr) {
 // Note: VI / COP2 are separate "kinds" of registers, each with 16 registers.
 // It might make sense to make this a single "kind" instead?
 
-/*!
- * Create a register. The kind and num must both be valid.
- */
-Register::Register(Reg::RegisterKind kind, uint32_t num) {
-  id = (kind << 8) | num;
-
-  // check range:
-  switch (kind) {
-    case Reg::GPR:
-    case Reg::FPR:
-    case Reg::VF:
-    case Reg::COP0:
-    case Reg::VI:
-      assert(num < 32);
-      break;
-    case Reg::PCR:
-      assert(num < 2);
-      break;
-    default:
-      assert(false);
-  }
-}
-
 /*!
  * Convert to string. The register must be valid.
  */
@@ -125,6 +110,8 @@ const char* Register::to_charp() const {
       return cop0_to_charp(get_cop0());
     case Reg::PCR:
       return pcr_to_charp(get_pcr());
+    case Reg::SPECIAL:
+      return special_to_charp(get_special());
     default:
       assert(false);
   }
@@ -206,10 +193,72 @@ uint32_t Register::get_pcr() const {
   return kind;
 }
 
+/*!
+ * Get the special register. Must be a special register.
+ */
+Reg::Special Register::get_special() const {
+  assert(get_kind() == Reg::SPECIAL);
+  uint16_t kind = id & 0xff;
+  assert(kind < Reg::MAX_SPECIAL);
+  return (Reg::Special)(kind);
+}
+
 bool Register::operator==(const Register& other) const {
   return id == other.id;
 }
 
 bool Register::operator!=(const Register& other) const {
   return id != other.id;
-}
\ No newline at end of file
+}
+
+/////////////////////////////
+// Register Set
+/////////////////////////////
+
+/*!
+ * Is the set empty?
+ */
+bool RegisterSet::empty() const {
+  for (auto bits : m_bits) {
+    if (bits) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * Count the registers in the set.
+ */
+int RegisterSet::size() const {
+  int result = 0;
+  for (auto bits : m_bits) {
+    for (; bits; bits &= bits - 1) {
+      result++;
+    }
+  }
+  return result;
+}
+
+/*!
+ * Print the registers in the set, separated by spaces.
+ */
+std::string RegisterSet::to_string() const {
+  std::string result;
+  for_each([&](Register r) {
+    if (!result.empty()) {
+      result.push_back(' ');
+    }
+    result.append(r.to_charp());
+  });
+  return result;
+}
+
+bool RegisterSet::operator==(const RegisterSet& other) const {
+  for (int i = 0; i < Reg::MAX_KIND; i++) {
+    if (m_bits[i] != other.m_bits[i]) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -6,6 +6,7 @@
 #ifndef NEXT_REGISTER_H
 #define NEXT_REGISTER_H
 
+#include <cassert>
 #include <cstdint>
 #include <string>
 
@@ -19,7 +20,8 @@ enum RegisterKind {
       3,  // VU0 Integer registers from EE, the first 16 are vi00 - vi15, the rest are control regs.
   COP0 = 4,  // EE COP0 Control Registers: full of fancy names (there are 32 of them)
   PCR = 5,   // Performance Counter registers (PCR0, PCR1)
-  MAX_KIND = 6
+  SPECIAL = 6,  // Registers that are only implicitly accessed, see Reg::Special
+  MAX_KIND = 7
 };
 
 // nicknames for GPRs
@@ -118,13 +120,50 @@ enum Vi {
   CMSAR1 = 31,
   MAX_COP2 = 32
 };
+
+// registers that never appear as operands, but are implicitly read or written by some instructions
+enum Special {
+  HI = 0,
+  LO = 1,
+  HI1 = 2,
+  LO1 = 3,
+  FPU_ACC = 4,  // COP1 accumulator (mula.s, madd.s, ...)
+  FPU_CC = 5,   // COP1 condition flag (c.eq.s, bc1t, ...)
+  VU_ACC = 6,   // VU0 accumulator
+  VU_Q = 7,     // VU0 Q register (vdiv, vsqrt, ...)
+  MAX_SPECIAL = 8
+};
 }  // namespace Reg
 
 // Representation of a register.  Uses a 32-bit integer internally.
 class Register {
  public:
   Register() = default;
-  Register(Reg::RegisterKind kind, uint32_t num);
+
+  /*!
+   * Create a register. The kind and num must both be valid.
+   */
+  constexpr Register(Reg::RegisterKind kind, uint32_t num) : id((kind << 8) | num) {
+    // check range:
+    switch (kind) {
+      case Reg::GPR:
+      case Reg::FPR:
+      case Reg::VF:
+      case Reg::COP0:
+      case Reg::VI:
+        assert(num < 32);
+        break;
+      case Reg::PCR:
+        assert(num < 2);
+        break;
+      case Reg::SPECIAL:
+        assert(num < Reg::MAX_SPECIAL);
+        break;
+      default:
+        assert(false);
+    }
+  }
+
   const char* to_charp() const;
   std::string to_string() const;
   Reg::RegisterKind get_kind() const;
@@ -134,14 +173,84 @@ class Register {
   uint32_t get_vi() const;
   Reg::Cop0 get_cop0() const;
   uint32_t get_pcr() const;
+  Reg::Special get_special() const;
+  uint16_t get_id() const { return id; }  // kind << 8 | number, for saving to a file.
 
   bool operator==(const Register& other) const;
   bool operator!=(const Register& other) const;
 
  private:
+  friend class RegisterSet;
   uint16_t id = -1;
 };
 
+/*!
+ * A set of registers, stored as a 32-bit mask per register kind.
+ * Set operations are a handful of word operations, for use in dataflow analysis.
+ */
+class RegisterSet {
+ public:
+  constexpr RegisterSet() = default;
+
+  constexpr void insert(Register r) { m_bits[r.id >> 8] |= (1u << (r.id & 0xff)); }
+  constexpr RegisterSet& add(Register r) {
+    insert(r);
+    return *this;
+  }
+  void erase(Register r) { m_bits[r.id >> 8] &= ~(1u << (r.id & 0xff)); }
+  bool contains(Register r) const { return m_bits[r.id >> 8] & (1u << (r.id & 0xff)); }
+  uint32_t mask(Reg::RegisterKind kind) const { return m_bits[kind]; }
+
+  bool empty() const;
+  int size() const;
+  std::string to_string() const;
+
+  /*!
+   * Call f(Register) on each register in the set, in order of kind, then number.
+   */
+  template <typename T>
+  void for_each(T f) const {
+    for (int kind = 0; kind < Reg::MAX_KIND; kind++) {
+      uint32_t bits = m_bits[kind];
+      for (uint32_t num = 0; bits; num++, bits >>= 1) {
+        if (bits & 1) {
+          f(Register((Reg::RegisterKind)kind, num));
+        }
+      }
+    }
+  }
+
+  constexpr RegisterSet& operator|=(const RegisterSet& other) {
+    for (int i = 0; i < Reg::MAX_KIND; i++) {
+      m_bits[i] |= other.m_bits[i];
+    }
+    return *this;
+  }
+
+  RegisterSet& operator&=(const RegisterSet& other) {
+    for (int i = 0; i < Reg::MAX_KIND; i++) {
+      m_bits[i] &= other.m_bits[i];
+    }
+    return *this;
+  }
+
+  // set difference
+  RegisterSet& operator-=(const RegisterSet& other) {
+    for (int i = 0; i < Reg::MAX_KIND; i++) {
+      m_bits[i] &= ~other.m_bits[i];
+    }
+    return *this;
+  }
 
+  RegisterSet operator|(const RegisterSet& other) const { return RegisterSet(*this) |= other; }
+  RegisterSet operator&(const RegisterSet& other) const { return RegisterSet(*this) &= other; }
+  RegisterSet operator-(const RegisterSet& other) const { return RegisterSet(*this) -= other; }
+
+  bool operator==(const RegisterSet& other) const;
+  bool operator!=(const RegisterSet& other) const { return !(*this == other); }
+
+ private:
+  uint32_t m_bits[Reg::MAX_KIND] = {};
+};
 
 #endif  // NEXT_REGISTER_H
@@ -1,31 +1,73 @@
-#include <algorithm>
 #include <cassert>
 #include "BasicBlocks.h"
 #include "LinkedObjectFile.h"
 
+namespace {
 /*!
- * Find all basic blocks in a function.
+ * Is this a branch which is always taken? GOAL uses beq r0, r0 for unconditional branches.
+ */
+bool is_always_taken(const Instruction& instr) {
+  switch (instr.kind) {
+    case InstructionKind::BEQ:
+    case InstructionKind::BEQL:
+      return instr.get_src(0).get_reg() == instr.get_src(1).get_reg();
+    case InstructionKind::BGEZ:
+    case InstructionKind::BGEZL:
+      return instr.get_src(0).get_reg() == Register(Reg::GPR, Reg::R0);
+    default:
+      return false;
+  }
+}
+
+/*!
+ * Convert per-block edge counts to CSR offsets, in place.
+ */
+void counts_to_offsets(std::vector<int>& offsets) {
+  int total = 0;
+  for (auto& x : offsets) {
+    int count = x;
+    x = total;
+    total += count;
+  }
+}
+}  // namespace
+
+/*!
+ * Find all basic blocks in a function, and build the control flow graph.
  * All delay slot instructions are grouped with the branch instruction.
- * This is done by finding all "dividers", which are after branch delay instructions and before
- * branch destinations, then sorting them, ignoring duplicates, and creating the blocks.
+ * Blocks are split after branch delay slots and before branch destinations.
+ *
+ * This makes a single pass over the instructions to find branches, then builds blocks and edges
+ * in time linear in the size of the function.
  */
-std::vector<BasicBlock> find_blocks_in_function(const LinkedObjectFile& file,
-                                                int seg,
-                                                const Function& func) {
-  std::vector<BasicBlock> basic_blocks;
+ControlFlowGraph find_blocks_in_function(const LinkedObjectFile& file,
+                                         int seg,
+                                         const Function& func) {
+  ControlFlowGraph cfg;
+  int n_instrs = int(func.instructions.size());
+
+  // the branches in the function: index of branch, index of target
+  struct Branch {
+    int idx;
+    int target;
+  };
+  std::vector<Branch> branches;
 
+  // block_starts[i] is set if a block starts at instruction i.
   // note - the first word of a function is the "function" type and should go in any basic block
-  std::vector<int> dividers = {0, int(func.instructions.size())};
+  std::vector<uint8_t> block_starts(n_instrs + 1, 0);
+  block_starts[0] = 1;
+  block_starts[n_instrs] = 1;
 
-  for (int i = 0; i < int(func.instructions.size()); i++) {
-    const auto& instr = func.instructions.at(i);
+  for (int i = 0; i < n_instrs; i++) {
+    const auto& instr = func.instructions[i];
     const auto& instr_info = instr.get_info();
 
     if (instr_info.is_branch || instr_info.is_branch_likely) {
       // make sure the delay slot of this branch is included in the function
       assert(i + func.start_word < func.end_word - 1);
       // divider after delay slot
-      dividers.push_back(i + 2);
+      block_starts[i + 2] = 1;
       auto label_id = instr.get_label_target();
       assert(label_id != -1);
       const auto& label = file.labels.at(label_id);
@@ -33,18 +75,76 @@ std::vector<BasicBlock> find_blocks_in_function(const LinkedObjectFile& file,
       assert(label.target_segment == seg);
       assert(label.offset / 4 > func.start_word);
       assert(label.offset / 4 < func.end_word - 1);
-      dividers.push_back(label.offset / 4 - func.start_word);
+      int target = label.offset / 4 - func.start_word;
+      block_starts[target] = 1;
+      branches.push_back({i, target});
     }
   }
 
-  std::sort(dividers.begin(), dividers.end());
+  // create blocks, and remember which block each instruction is in.
+  std::vector<int> block_of_instr(n_instrs);
+  for (int i = 0, block_start = 0; i < n_instrs; i++) {
+    block_of_instr[i] = int(cfg.blocks.size());
+    if (block_starts[i + 1]) {
+      cfg.blocks.emplace_back(block_start, i + 1);
+      block_start = i + 1;
+    }
+  }
 
-  for (size_t i = 0; i < dividers.size() - 1; i++) {
-    if (dividers[i] != dividers[i + 1]) {
-      basic_blocks.emplace_back(dividers[i], dividers[i + 1]);
-      assert(dividers[i] >= 0);
+  // a function without even a type tag has no blocks, and no entry.
+  int n_blocks = cfg.block_count();
+  cfg.entry = n_blocks ? 0 : -1;
+
+  // successors. Blocks are in order, and the branches are in order, so we can walk both at once.
+  cfg.succ_offsets.resize(n_blocks + 1);
+  cfg.succ_edges.reserve(n_blocks + branches.size());
+  size_t branch_idx = 0;
+  for (int b = 0; b < n_blocks; b++) {
+    const auto& block = cfg.blocks[b];
+    cfg.succ_offsets[b] = int(cfg.succ_edges.size());
+    int next = b + 1 < n_blocks ? b + 1 : -1;
+
+    // blocks end after a delay slot, so a branch can only be one of the last two instructions.
+    // If it's the last, a label split off its delay slot. GOAL doesn't do this, so we just use the
+    // edges of the branch and ignore that the delay slot is in the next block.
+    const Branch* branch = nullptr;
+    while (branch_idx < branches.size() && branches[branch_idx].idx < block.end_word) {
+      branch = &branches[branch_idx];
+      branch_idx++;
+    }
+
+    if (!branch) {
+      if (next != -1) {
+        cfg.succ_edges.push_back({next, EdgeKind::FALLTHROUGH});
+      }
+    } else {
+      const auto& instr = func.instructions[branch->idx];
+      if (!is_always_taken(instr) && next != -1) {
+        bool likely = instr.get_info().is_branch_likely;
+        cfg.succ_edges.push_back({next, likely ? EdgeKind::LIKELY_SKIP : EdgeKind::FALLTHROUGH});
+      }
+      cfg.succ_edges.push_back({block_of_instr[branch->target], EdgeKind::TAKEN});
+    }
+
+    if (cfg.succ_offsets[b] == int(cfg.succ_edges.size())) {
+      cfg.exits.push_back(b);
+    }
+  }
+  cfg.succ_offsets[n_blocks] = int(cfg.succ_edges.size());
+
+  // predecessors, by counting sort of the successor edges.
+  cfg.pred_offsets.assign(n_blocks + 1, 0);
+  for (auto& edge : cfg.succ_edges) {
+    cfg.pred_offsets[edge.block]++;
+  }
+  counts_to_offsets(cfg.pred_offsets);
+  cfg.pred_edges.resize(cfg.succ_edges.size());
+  std::vector<int> pred_fill(cfg.pred_offsets.begin(), cfg.pred_offsets.end() - 1);
+  for (int b = 0; b < n_blocks; b++) {
+    for (auto& edge : cfg.successors(b)) {
+      cfg.pred_edges[pred_fill[edge.block]++] = {b, edge.kind};
     }
   }
 
-  return basic_blocks;
-}
\ No newline at end of file
+  return cfg;
+}
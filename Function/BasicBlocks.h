@@ -1,6 +1,7 @@
 #ifndef JAK_DISASSEMBLER_BASICBLOCKS_H
 #define JAK_DISASSEMBLER_BASICBLOCKS_H
 
+#include <cstdint>
 #include <vector>
 
 class LinkedObjectFile;
@@ -13,7 +14,60 @@ struct BasicBlock {
   BasicBlock(int _start_word, int _end_word) : start_word(_start_word), end_word(_end_word) {}
 };
 
-std::vector<BasicBlock> find_blocks_in_function(const LinkedObjectFile& file,
-                                                int seg,
-                                                const Function& func);
+enum class EdgeKind : uint8_t {
+  FALLTHROUGH,  // not a branch, or a branch which isn't taken. (the delay slot still runs)
+  TAKEN,        // branch is taken
+  LIKELY_SKIP   // branch likely not taken, so the delay slot is skipped.
+};
+
+struct CfgEdge {
+  int block;
+  EdgeKind kind;
+};
+
+/*!
+ * A list of edges, pointing into the edge array of a ControlFlowGraph.
+ */
+struct CfgEdgeList {
+  const CfgEdge* first;
+  const CfgEdge* last;
+
+  const CfgEdge* begin() const { return first; }
+  const CfgEdge* end() const { return last; }
+  int size() const { return int(last - first); }
+  bool empty() const { return first == last; }
+  const CfgEdge& operator[](int i) const { return first[i]; }
+};
+
+/*!
+ * The control flow graph of a function.
+ * Edges are stored in compressed sparse row format: the successors of block b are
+ * succ_edges[succ_offsets[b]] up to succ_edges[succ_offsets[b + 1]], and the same for predecessors.
+ * If a branch targets the next block, there are two edges to that block, with different kinds.
+ */
+struct ControlFlowGraph {
+  std::vector<BasicBlock> blocks;
+  int entry = -1;          // block containing the first instruction, or -1 if there are none.
+  std::vector<int> exits;  // blocks which leave the function instead of going to another block.
+
+  std::vector<int> succ_offsets;
+  std::vector<CfgEdge> succ_edges;
+  std::vector<int> pred_offsets;
+  std::vector<CfgEdge> pred_edges;
+
+  int block_count() const { return int(blocks.size()); }
+  int edge_count() const { return int(succ_edges.size()); }
+
+  CfgEdgeList successors(int block) const {
+    return {succ_edges.data() + succ_offsets[block], succ_edges.data() + succ_offsets[block + 1]};
+  }
+
+  CfgEdgeList predecessors(int block) const {
+    return {pred_edges.data() + pred_offsets[block], pred_edges.data() + pred_offsets[block + 1]};
+  }
+};
+
+ControlFlowGraph find_blocks_in_function(const LinkedObjectFile& file,
+                                         int seg,
+                                         const Function& func);
 #endif  // JAK_DISASSEMBLER_BASICBLOCKS_H
@@ -0,0 +1,93 @@
+#ifndef JAK_DISASSEMBLER_DATAFLOW_H
+#define JAK_DISASSEMBLER_DATAFLOW_H
+
+#include <vector>
+#include "BasicBlocks.h"
+
+/*!
+ * Result of a dataflow analysis: the value at the start and end of each block.
+ */
+template <typename T>
+struct DataflowResult {
+  std::vector<T> in;   // value at the start of each block
+  std::vector<T> out;  // value at the end of each block
+  int iterations = 0;  // number of times a block was processed
+};
+
+/*!
+ * Solve a dataflow problem over the blocks of a control flow graph with a worklist.
+ *
+ * A Problem must provide:
+ *  - Value, the type of the dataflow facts.
+ *  - static constexpr bool backward, the direction of the analysis.
+ *  - Value initial(), the starting value for every block.
+ *  - Value boundary(), the value at the entry (forward) or at the exits (backward).
+ *  - void meet(Value& into, const Value& value, int from, const CfgEdge& edge), to combine the
+ *    value flowing across edge, which goes from block "from" to block edge.block.
+ *  - Value transfer(int block, const Value& value), the effect of the block on a value.
+ */
+template <typename Problem>
+DataflowResult<typename Problem::Value> solve_dataflow(const ControlFlowGraph& cfg,
+                                                       const Problem& problem) {
+  using Value = typename Problem::Value;
+  DataflowResult<Value> result;
+  int n_blocks = cfg.block_count();
+  result.in.assign(n_blocks, problem.initial());
+  result.out.assign(n_blocks, problem.initial());
+
+  // start with every block, ordered so that the first block popped is the first in the direction
+  // of the analysis. Blocks are in address order, which is usually close to the flow order.
+  std::vector<int> worklist;
+  std::vector<uint8_t> in_worklist(n_blocks, 1);
+  worklist.reserve(n_blocks);
+  for (int i = 0; i < n_blocks; i++) {
+    worklist.push_back(Problem::backward ? i : n_blocks - 1 - i);
+  }
+
+  while (!worklist.empty()) {
+    int b = worklist.back();
+    worklist.pop_back();
+    in_worklist[b] = 0;
+    result.iterations++;
+
+    if (Problem::backward) {
+      Value out = cfg.successors(b).empty() ? problem.boundary() : problem.initial();
+      for (auto& edge : cfg.successors(b)) {
+        problem.meet(out, result.in[edge.block], b, edge);
+      }
+      result.out[b] = out;
+
+      Value in = problem.transfer(b, out);
+      if (in != result.in[b]) {
+        result.in[b] = in;
+        for (auto& pred : cfg.predecessors(b)) {
+          if (!in_worklist[pred.block]) {
+            in_worklist[pred.block] = 1;
+            worklist.push_back(pred.block);
+          }
+        }
+      }
+    } else {
+      Value in = b == cfg.entry ? problem.boundary() : problem.initial();
+      for (auto& pred : cfg.predecessors(b)) {
+        problem.meet(in, result.out[pred.block], pred.block, CfgEdge{b, pred.kind});
+      }
+      result.in[b] = in;
+
+      Value out = problem.transfer(b, in);
+      if (out != result.out[b]) {
+        result.out[b] = out;
+        for (auto& succ : cfg.successors(b)) {
+          if (!in_worklist[succ.block]) {
+            in_worklist[succ.block] = 1;
+            worklist.push_back(succ.block);
+          }
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+#endif  // JAK_DISASSEMBLER_DATAFLOW_H
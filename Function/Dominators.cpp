@@ -0,0 +1,333 @@
+#include <algorithm>
+#include "Dominators.h"
+
+namespace {
+// functions with more blocks than this use Lengauer-Tarjan. Cooper-Harvey-Kennedy is faster on
+// small graphs, but it iterates, and its intersect walks can get long on big ones.
+constexpr int LENGAUER_TARJAN_MIN_BLOCKS = 256;
+
+/*!
+ * Depth first search from the entry block.
+ */
+struct DfsOrder {
+  std::vector<int> preorder;    // reachable blocks, in preorder
+  std::vector<int> postorder;   // reachable blocks, in postorder
+  std::vector<int> pre_number;  // index of each block in preorder, or -1 if unreachable
+  std::vector<int> parent;      // parent of each block in the DFS tree
+};
+
+DfsOrder depth_first_search(const ControlFlowGraph& cfg) {
+  DfsOrder result;
+  int n_blocks = cfg.block_count();
+  result.pre_number.assign(n_blocks, -1);
+  result.parent.assign(n_blocks, -1);
+  result.preorder.reserve(n_blocks);
+  result.postorder.reserve(n_blocks);
+
+  // stack of (block, index of next successor to visit)
+  std::vector<std::pair<int, int>> stack;
+  stack.emplace_back(cfg.entry, 0);
+  result.pre_number[cfg.entry] = 0;
+  result.preorder.push_back(cfg.entry);
+
+  while (!stack.empty()) {
+    auto& top = stack.back();
+    auto succs = cfg.successors(top.first);
+    if (top.second < succs.size()) {
+      int next = succs[top.second++].block;
+      if (result.pre_number[next] == -1) {
+        result.pre_number[next] = int(result.preorder.size());
+        result.preorder.push_back(next);
+        result.parent[next] = top.first;
+        stack.emplace_back(next, 0);
+      }
+    } else {
+      result.postorder.push_back(top.first);
+      stack.pop_back();
+    }
+  }
+
+  return result;
+}
+
+/*!
+ * Fill out the preorder/postorder numbers of the dominator tree from idom.
+ */
+void number_dominator_tree(const ControlFlowGraph& cfg, Dominators& dom) {
+  int n_blocks = cfg.block_count();
+  dom.pre.assign(n_blocks, -1);
+  dom.post.assign(n_blocks, -1);
+
+  // children of each block, in CSR format.
+  std::vector<int> child_offsets(n_blocks + 1, 0);
+  for (int b = 0; b < n_blocks; b++) {
+    if (dom.idom[b] != -1) {
+      child_offsets[dom.idom[b] + 1]++;
+    }
+  }
+  for (int b = 0; b < n_blocks; b++) {
+    child_offsets[b + 1] += child_offsets[b];
+  }
+  std::vector<int> children(child_offsets[n_blocks]);
+  std::vector<int> fill(child_offsets.begin(), child_offsets.end() - 1);
+  for (int b = 0; b < n_blocks; b++) {
+    if (dom.idom[b] != -1) {
+      children[fill[dom.idom[b]]++] = b;
+    }
+  }
+
+  int pre_count = 0, post_count = 0;
+  std::vector<std::pair<int, int>> stack;
+  stack.emplace_back(cfg.entry, child_offsets[cfg.entry]);
+  dom.pre[cfg.entry] = pre_count++;
+  while (!stack.empty()) {
+    auto& top = stack.back();
+    if (top.second < child_offsets[top.first + 1]) {
+      int child = children[top.second++];
+      dom.pre[child] = pre_count++;
+      stack.emplace_back(child, child_offsets[child]);
+    } else {
+      dom.post[top.first] = post_count++;
+      stack.pop_back();
+    }
+  }
+}
+}  // namespace
+
+/*!
+ * Find the dominator tree, using whichever algorithm is faster for the size of the graph.
+ */
+Dominators find_dominators(const ControlFlowGraph& cfg) {
+  if (cfg.block_count() > LENGAUER_TARJAN_MIN_BLOCKS) {
+    return find_dominators_lengauer_tarjan(cfg);
+  } else {
+    return find_dominators_cooper_harvey_kennedy(cfg);
+  }
+}
+
+/*!
+ * Find the dominator tree with the iterative algorithm from Cooper, Harvey and Kennedy,
+ * "A Simple, Fast Dominance Algorithm".
+ */
+Dominators find_dominators_cooper_harvey_kennedy(const ControlFlowGraph& cfg) {
+  Dominators dom;
+  int n_blocks = cfg.block_count();
+  dom.idom.assign(n_blocks, -1);
+  if (n_blocks == 0) {
+    return dom;
+  }
+
+  auto dfs = depth_first_search(cfg);
+  // blocks are processed in reverse postorder, and compared by their postorder number.
+  std::vector<int> post_number(n_blocks, -1);
+  for (int i = 0; i < int(dfs.postorder.size()); i++) {
+    post_number[dfs.postorder[i]] = i;
+  }
+
+  auto intersect = [&](int a, int b) {
+    while (a != b) {
+      while (post_number[a] < post_number[b]) {
+        a = dom.idom[a];
+      }
+      while (post_number[b] < post_number[a]) {
+        b = dom.idom[b];
+      }
+    }
+    return a;
+  };
+
+  // during the iteration, the entry is its own idom, so intersect can stop there.
+  dom.idom[cfg.entry] = cfg.entry;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = dfs.postorder.rbegin() + 1; it != dfs.postorder.rend(); ++it) {
+      int b = *it;
+      int new_idom = -1;
+      for (auto& pred : cfg.predecessors(b)) {
+        if (dom.idom[pred.block] == -1) {
+          continue;  // not processed yet, or unreachable
+        }
+        new_idom = new_idom == -1 ? pred.block : intersect(pred.block, new_idom);
+      }
+      if (dom.idom[b] != new_idom) {
+        dom.idom[b] = new_idom;
+        changed = true;
+      }
+    }
+  }
+  dom.idom[cfg.entry] = -1;
+
+  number_dominator_tree(cfg, dom);
+  return dom;
+}
+
+/*!
+ * Find the dominator tree with the Lengauer-Tarjan algorithm, using path compression.
+ * See "A Fast Algorithm for Finding Dominators in a Flowgraph". This takes O(E log V) time, so it
+ * is better on big functions.
+ */
+Dominators find_dominators_lengauer_tarjan(const ControlFlowGraph& cfg) {
+  Dominators dom;
+  int n_blocks = cfg.block_count();
+  dom.idom.assign(n_blocks, -1);
+  if (n_blocks == 0) {
+    return dom;
+  }
+
+  auto dfs = depth_first_search(cfg);
+  const auto& vertex = dfs.preorder;
+  const auto& dfnum = dfs.pre_number;
+  int n_reachable = int(vertex.size());
+
+  // all indexed by block.
+  std::vector<int> semi(dfnum);             // dfnum of the semidominator
+  std::vector<int> ancestor(n_blocks, -1);  // ancestor in the forest built by link
+  std::vector<int> label(n_blocks);         // block with the lowest semi on the compressed path
+  for (int b = 0; b < n_blocks; b++) {
+    label[b] = b;
+  }
+
+  // blocks with a given semidominator, as linked lists.
+  std::vector<int> bucket_head(n_blocks, -1);
+  std::vector<int> bucket_next(n_blocks, -1);
+
+  std::vector<int> path;
+  auto eval = [&](int v) {
+    if (ancestor[v] == -1) {
+      return v;
+    }
+
+    // compress the path from v up to the root of its tree.
+    for (int x = v; ancestor[ancestor[x]] != -1; x = ancestor[x]) {
+      path.push_back(x);
+    }
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      int x = *it;
+      int a = ancestor[x];
+      if (semi[label[a]] < semi[label[x]]) {
+        label[x] = label[a];
+      }
+      ancestor[x] = ancestor[a];
+    }
+    path.clear();
+    return label[v];
+  };
+
+  for (int i = n_reachable - 1; i > 0; i--) {
+    int w = vertex[i];
+    int p = dfs.parent[w];
+
+    for (auto& pred : cfg.predecessors(w)) {
+      if (dfnum[pred.block] == -1) {
+        continue;  // unreachable
+      }
+      int u = eval(pred.block);
+      semi[w] = std::min(semi[w], semi[u]);
+    }
+
+    int semi_block = vertex[semi[w]];
+    bucket_next[w] = bucket_head[semi_block];
+    bucket_head[semi_block] = w;
+    ancestor[w] = p;
+
+    for (int v = bucket_head[p]; v != -1; v = bucket_next[v]) {
+      int u = eval(v);
+      dom.idom[v] = semi[u] < semi[v] ? u : p;
+    }
+    bucket_head[p] = -1;
+  }
+
+  for (int i = 1; i < n_reachable; i++) {
+    int w = vertex[i];
+    if (dom.idom[w] != vertex[semi[w]]) {
+      dom.idom[w] = dom.idom[dom.idom[w]];
+    }
+  }
+  dom.idom[cfg.entry] = -1;
+
+  number_dominator_tree(cfg, dom);
+  return dom;
+}
+
+/*!
+ * Find the natural loops of a function. A back edge is an edge to a block which dominates the
+ * source of the edge. Irreducible loops don't have a back edge, so they aren't found.
+ */
+LoopNest find_loops(const ControlFlowGraph& cfg, const Dominators& dom) {
+  LoopNest result;
+  int n_blocks = cfg.block_count();
+  result.innermost.assign(n_blocks, -1);
+  if (n_blocks == 0) {
+    return result;
+  }
+
+  // the blocks of each loop, in CSR format.
+  std::vector<NaturalLoop> loops;
+  std::vector<int> body_offsets = {0};
+  std::vector<int> bodies;
+
+  // header of the last loop each block was added to, so we don't need to clear between loops.
+  std::vector<int> in_loop(n_blocks, -1);
+  std::vector<int> worklist;
+
+  for (int header = 0; header < n_blocks; header++) {
+    bool has_back_edge = false;
+    for (auto& pred : cfg.predecessors(header)) {
+      has_back_edge = has_back_edge || dom.dominates(header, pred.block);
+    }
+    if (!has_back_edge) {
+      continue;
+    }
+
+    NaturalLoop loop;
+    loop.header = header;
+    in_loop[header] = header;
+    bodies.push_back(header);
+    for (auto& pred : cfg.predecessors(header)) {
+      if (dom.dominates(header, pred.block) && in_loop[pred.block] != header) {
+        in_loop[pred.block] = header;
+        worklist.push_back(pred.block);
+      }
+    }
+
+    // walk backward from the back edges until we hit the header.
+    while (!worklist.empty()) {
+      int b = worklist.back();
+      worklist.pop_back();
+      bodies.push_back(b);
+      for (auto& pred : cfg.predecessors(b)) {
+        if (dom.reachable(pred.block) && in_loop[pred.block] != header) {
+          in_loop[pred.block] = header;
+          worklist.push_back(pred.block);
+        }
+      }
+    }
+
+    loop.n_blocks = int(bodies.size()) - body_offsets.back();
+    body_offsets.push_back(int(bodies.size()));
+    loops.push_back(loop);
+  }
+
+  // natural loops are either nested or disjoint, and a loop is bigger than the loops it contains.
+  // Handling bigger loops first means the innermost loop of each block is the last one to set it.
+  std::vector<int> order(loops.size());
+  for (int i = 0; i < int(order.size()); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int a, int b) { return loops[a].n_blocks > loops[b].n_blocks; });
+
+  for (int idx : order) {
+    auto loop = loops[idx];
+    int loop_id = int(result.loops.size());
+    loop.parent = result.innermost[loop.header];
+    loop.depth = loop.parent == -1 ? 1 : result.loops[loop.parent].depth + 1;
+    for (int i = body_offsets[idx]; i < body_offsets[idx + 1]; i++) {
+      result.innermost[bodies[i]] = loop_id;
+    }
+    result.loops.push_back(loop);
+  }
+
+  return result;
+}
@@ -0,0 +1,58 @@
+#ifndef JAK_DISASSEMBLER_DOMINATORS_H
+#define JAK_DISASSEMBLER_DOMINATORS_H
+
+#include <vector>
+#include "BasicBlocks.h"
+
+/*!
+ * The dominator tree of a function's control flow graph.
+ */
+struct Dominators {
+  // immediate dominator of each block. -1 for the entry block and unreachable blocks.
+  std::vector<int> idom;
+
+  // preorder/postorder numbers of each block in the dominator tree, for constant time dominance
+  // checks. -1 for unreachable blocks.
+  std::vector<int> pre;
+  std::vector<int> post;
+
+  bool reachable(int block) const { return pre[block] != -1; }
+
+  /*!
+   * Does block a dominate block b? Every block dominates itself.
+   */
+  bool dominates(int a, int b) const {
+    return reachable(a) && reachable(b) && pre[a] <= pre[b] && post[b] <= post[a];
+  }
+};
+
+/*!
+ * A natural loop: the header, plus all the blocks that can reach a back edge to the header without
+ * going through the header. Loops with the same header are merged.
+ */
+struct NaturalLoop {
+  int header = -1;
+  int parent = -1;  // innermost loop containing this loop, or -1 if it's not nested.
+  int depth = 1;    // 1 for outermost loops.
+  int n_blocks = 0;
+};
+
+/*!
+ * All the natural loops in a function.
+ */
+struct LoopNest {
+  std::vector<NaturalLoop> loops;  // outer loops come before the loops they contain.
+  std::vector<int> innermost;      // innermost loop containing each block, or -1.
+
+  int loop_depth(int block) const {
+    int loop = innermost.at(block);
+    return loop == -1 ? 0 : loops.at(loop).depth;
+  }
+};
+
+Dominators find_dominators(const ControlFlowGraph& cfg);
+Dominators find_dominators_cooper_harvey_kennedy(const ControlFlowGraph& cfg);
+Dominators find_dominators_lengauer_tarjan(const ControlFlowGraph& cfg);
+LoopNest find_loops(const ControlFlowGraph& cfg, const Dominators& dom);
+
+#endif  // JAK_DISASSEMBLER_DOMINATORS_H
@@ -1,9 +1,11 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdarg>
+#include <cstdio>
 #include <vector>
 #include "Function.h"
 #include "Disasm/InstructionMatching.h"
 #include "LinkedObjectFile.h"
-#include "TypeSystem/TypeInfo.h"
 
 namespace {
 std::vector<Register> gpr_backups = {make_gpr(Reg::GP), make_gpr(Reg::S5), make_gpr(Reg::S4),
@@ -45,6 +47,9 @@ Function::Function(int _start_word, int _end_word) : start_word(_start_word), en
  * Remove the function prologue from the first basic block and populate this->prologue with info.
  */
 void Function::analyze_prologue(const LinkedObjectFile& file) {
+  if (instructions.size() < 2 || cfg.blocks.empty()) {
+    return;  // nothing after the type tag, so there's no prologue.
+  }
   int idx = 1;
 
   // first we look for daddiu sp, sp, -x to determine how much stack is used
@@ -66,8 +71,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
       auto& instr = instructions.at(idx);
       // storing stack pointer on the stack is done by some ASM kernel functions
       if (instr.kind == InstructionKind::SW && instr.get_src(0).get_reg() == make_gpr(Reg::SP)) {
-        printf("[Warning] Suspected ASM function based on this instruction in prologue: %s\n",
-               instr.to_string(file).c_str());
+        log("[Warning] Suspected ASM function based on this instruction in prologue: %s\n",
+            instr.to_string(file).c_str());
         warnings += "Flagged as ASM function because of " + instr.to_string(file) + "\n";
         suspected_asm = true;
         return;
@@ -89,8 +94,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
       // storing s7 on the stack is done by interrupt handlers, which we probably don't want to
       // support
       if (instr.kind == InstructionKind::SD && instr.get_src(0).get_reg() == make_gpr(Reg::S7)) {
-        printf("[Warning] Suspected ASM function based on this instruction in prologue: %s\n",
-               instr.to_string(file).c_str());
+        log("[Warning] Suspected ASM function based on this instruction in prologue: %s\n",
+            instr.to_string(file).c_str());
         warnings += "Flagged as ASM function because of " + instr.to_string(file) + "\n";
         suspected_asm = true;
         return;
@@ -127,8 +132,7 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
       // sometimes stack memory is zeroed immediately after gpr backups, and this fools the previous
       // check.
       if (store_reg == make_gpr(Reg::R0)) {
-        printf(
-            "[Warning] Stack Zeroing Detected in Function::analyze_prologue, prologue may be "
+        log("[Warning] Stack Zeroing Detected in Function::analyze_prologue, prologue may be "
             "wrong\n");
         warnings += "Stack Zeroing Detected, prologue may be wrong\n";
         expect_nothing_after_gprs = true;
@@ -139,7 +143,7 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
       // avoid false positives here!
       if (store_reg == make_gpr(Reg::A0)) {
         suspected_asm = true;
-        printf("[Warning] Suspected ASM function because register $a0 was stored on the stack!\n");
+        log("[Warning] Suspected ASM function because register $a0 was stored on the stack!\n");
         warnings += "a0 on stack detected, flagging as asm\n";
         return;
       }
@@ -156,8 +160,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
         assert(this_offset == prologue.gpr_backup_offset + 16 * i);
         if (this_reg != get_expected_gpr_backup(i, n_gpr_backups)) {
           suspected_asm = true;
-          printf("[Warning] Suspected asm function that isn't flagged due to stack store %s\n",
-                 instructions.at(idx + i).to_string(file).c_str());
+          log("[Warning] Suspected asm function that isn't flagged due to stack store %s\n",
+              instructions.at(idx + i).to_string(file).c_str());
           warnings += "Suspected asm function due to stack store: " +
                       instructions.at(idx + i).to_string(file) + "\n";
           return;
@@ -185,8 +189,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
           assert(this_offset == prologue.fpr_backup_offset + 4 * i);
           if (this_reg != get_expected_fpr_backup(i, n_fpr_backups)) {
             suspected_asm = true;
-            printf("[Warning] Suspected asm function that isn't flagged due to stack store %s\n",
-                   instructions.at(idx + i).to_string(file).c_str());
+            log("[Warning] Suspected asm function that isn't flagged due to stack store %s\n",
+                instructions.at(idx + i).to_string(file).c_str());
             warnings += "Suspected asm function due to stack store: " +
                         instructions.at(idx + i).to_string(file) + "\n";
             return;
@@ -277,8 +281,8 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
 
   // it's fine to have the entire first basic block be the prologue - you could loop back to the
   // first instruction past the prologue.
-  assert(basic_blocks.at(0).end_word >= prologue_end);
-  basic_blocks.at(0).start_word = prologue_end;
+  assert(cfg.blocks.at(0).end_word >= prologue_end);
+  cfg.blocks.at(0).start_word = prologue_end;
   prologue.decoded = true;
 
   check_epilogue(file);
@@ -288,31 +292,41 @@ void Function::analyze_prologue(const LinkedObjectFile& file) {
  * Print info about the prologue and stack.
  */
 std::string Function::Prologue::to_string(int indent) const {
+  std::string result;
+  append_to(result, indent);
+  return result;
+}
+
+/*!
+ * Append info about the prologue and stack to the end of a string.
+ */
+void Function::Prologue::append_to(std::string& dest, int indent) const {
   char buff[512];
   char* buff_ptr = buff;
-  std::string indent_str(indent, ' ');
+  dest.append(indent, ' ');
   if (!decoded) {
-    return indent_str + "BAD PROLOGUE";
+    dest.append("BAD PROLOGUE");
+    return;
   }
-  buff_ptr += sprintf(buff_ptr, "%sstack: total 0x%02x, fp? %d ra? %d ep? %d", indent_str.c_str(),
-                      total_stack_usage, fp_set, ra_backed_up, epilogue_ok);
+  buff_ptr += sprintf(buff_ptr, "stack: total 0x%02x, fp? %d ra? %d ep? %d", total_stack_usage,
+                      fp_set, ra_backed_up, epilogue_ok);
   if (n_stack_var_bytes) {
-    buff_ptr += sprintf(buff_ptr, "\n%sstack_vars: %d bytes at %d", indent_str.c_str(),
-                        n_stack_var_bytes, stack_var_offset);
+    buff_ptr += sprintf(buff_ptr, "\n%*sstack_vars: %d bytes at %d", indent, "", n_stack_var_bytes,
+                        stack_var_offset);
   }
   if (n_gpr_backup) {
-    buff_ptr += sprintf(buff_ptr, "\n%sgprs:", indent_str.c_str());
+    buff_ptr += sprintf(buff_ptr, "\n%*sgprs:", indent, "");
     for (int i = 0; i < n_gpr_backup; i++) {
-      buff_ptr += sprintf(buff_ptr, " %s", gpr_backups.at(i).to_string().c_str());
+      buff_ptr += sprintf(buff_ptr, " %s", gpr_backups.at(i).to_charp());
     }
   }
   if (n_fpr_backup) {
-    buff_ptr += sprintf(buff_ptr, "\n%sfprs:", indent_str.c_str());
+    buff_ptr += sprintf(buff_ptr, "\n%*sfprs:", indent, "");
     for (int i = 0; i < n_fpr_backup; i++) {
-      buff_ptr += sprintf(buff_ptr, " %s", fpr_backups.at(i).to_string().c_str());
+      buff_ptr += sprintf(buff_ptr, " %s", fpr_backups.at(i).to_charp());
     }
   }
-  return {buff};
+  dest.append(buff, buff_ptr - buff);
 }
 
 /*!
@@ -321,7 +335,7 @@ std::string Function::Prologue::to_string(int indent) const {
 void Function::check_epilogue(const LinkedObjectFile& file) {
   (void)file;
   if (!prologue.decoded || suspected_asm) {
-    printf("not decoded, or suspected asm, skipping epilogue\n");
+    log("not decoded, or suspected asm, skipping epilogue\n");
     return;
   }
 
@@ -344,8 +358,7 @@ void Function::check_epilogue(const LinkedObjectFile& file) {
       idx--;
       assert(is_jr_ra(instructions.at(idx)));
       idx--;
-      printf(
-          "[Warning] Double Return Epilogue Hack!  This is probably an ASM function in disguise\n");
+      log("[Warning] Double Return Epilogue Hack!  This is probably an ASM function in disguise\n");
       warnings += "Double Return Epilogue - this is probably an ASM function\n";
     }
     // delay slot should be daddiu sp, sp, offset
@@ -397,22 +410,39 @@ void Function::check_epilogue(const LinkedObjectFile& file) {
     idx--;
   }
 
-  assert(!basic_blocks.empty());
-  assert(idx + 1 >= basic_blocks.back().start_word);
-  basic_blocks.back().end_word = idx + 1;
+  assert(!cfg.blocks.empty());
+  assert(idx + 1 >= cfg.blocks.back().start_word);
+  cfg.blocks.back().end_word = idx + 1;
   prologue.epilogue_ok = true;
   epilogue_start = idx + 1;
 }
 
+/*!
+ * Add a printf-style message to log_messages.
+ */
+void Function::log(const char* format, ...) {
+  char buff[512];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buff, sizeof(buff), format, args);
+  va_end(args);
+  if (len > 0) {
+    log_messages.append(buff, std::min(len, int(sizeof(buff)) - 1));
+  }
+}
+
 /*!
  * Look through all blocks in this function for storing the address of a function into a symbol.
  * This indicates the stored function address belongs to a global function with the same name as
  * the symbol.
  *
- * Updates the guessed_name of the function and updates type_info
+ * Doesn't modify anything, so this can run on many functions in parallel. The caller should apply
+ * the results to the guessed_name of the function and to type_info.
  */
-void Function::find_global_function_defs(LinkedObjectFile& file) {
-  for (auto& block : basic_blocks) {
+std::vector<GlobalFunctionDef> Function::find_global_function_defs(
+    const LinkedObjectFile& file) const {
+  std::vector<GlobalFunctionDef> result;
+  for (auto& block : cfg.blocks) {
     int label_id = -1;
     Register reg;
 
@@ -451,11 +481,7 @@ void Function::find_global_function_defs(LinkedObjectFile& file) {
           if(!file.label_points_to_code(label_id)) {
 //            printf("discard as not code: %s\n", name.c_str());
           } else {
-            auto& func = file.get_function_at_label(label_id);
-            assert(func.guessed_name.empty());
-            func.guessed_name = name;
-            get_type_info().inform_symbol(name, TypeSpec("function"));
-            // todo - inform function.
+            result.push_back({label_id, name});
           }
 
         } else {
@@ -464,4 +490,6 @@ void Function::find_global_function_defs(LinkedObjectFile& file) {
       }
     }
   }
-}
\ No newline at end of file
+
+  return result;
+}
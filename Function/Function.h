@@ -5,12 +5,22 @@
 #include <vector>
 #include "Disasm/Instruction.h"
 #include "BasicBlocks.h"
+#include "Dominators.h"
+#include "Liveness.h"
+
+/*!
+ * A function defined by storing its address into a symbol in a top-level function.
+ */
+struct GlobalFunctionDef {
+  int label_id = -1;  // label of the function being defined
+  std::string name;   // symbol it was stored into
+};
 
 class Function {
  public:
   Function(int _start_word, int _end_word);
   void analyze_prologue(const LinkedObjectFile& file);
-  void find_global_function_defs(LinkedObjectFile& file);
+  std::vector<GlobalFunctionDef> find_global_function_defs(const LinkedObjectFile& file) const;
 
   int segment = -1;
   int start_word = -1;
@@ -21,7 +31,10 @@ class Function {
   bool suspected_asm = false;
 
   std::vector<Instruction> instructions;
-  std::vector<BasicBlock> basic_blocks;
+  ControlFlowGraph cfg;
+  Dominators dominators;
+  LoopNest loops;
+  Liveness liveness;
 
   int prologue_start = -1;
   int prologue_end = -1;
@@ -31,6 +44,10 @@ class Function {
 
   std::string warnings;
 
+  // messages from analysis, to be printed by the caller. These are buffered instead of printed
+  // directly so functions can be analyzed in parallel and the output stays in a consistent order.
+  std::string log_messages;
+
   struct Prologue {
     bool decoded = false;  // have we removed the prologue from basic blocks?
     int total_stack_usage = -1;
@@ -56,6 +73,7 @@ class Function {
     bool epilogue_ok = false;
 
     std::string to_string(int indent = 0) const;
+    void append_to(std::string& dest, int indent = 0) const;
 
   } prologue;
 
@@ -63,6 +81,7 @@ class Function {
 
  private:
   void check_epilogue(const LinkedObjectFile& file);
+  void log(const char* format, ...);
 };
 
 #endif  // NEXT_FUNCTION_H
@@ -0,0 +1,186 @@
+#include "Liveness.h"
+#include "Dataflow.h"
+#include "Function.h"
+
+namespace {
+/*!
+ * Backward liveness problem for the dataflow solver. Values are sets of live registers.
+ */
+struct LivenessProblem {
+  using Value = RegisterSet;
+  static constexpr bool backward = true;
+
+  const Liveness* liveness = nullptr;
+  // for blocks ending in a branch likely, the use/def of the delay slot.
+  std::vector<uint8_t> has_likely_delay_slot;
+  std::vector<RegisterSet> delay_slot_use;
+  std::vector<RegisterSet> delay_slot_def;
+
+  Value initial() const { return {}; }
+  Value boundary() const { return live_at_function_exit(); }
+
+  void meet(Value& into, const Value& value, int from, const CfgEdge& edge) const {
+    if (edge.kind == EdgeKind::TAKEN && has_likely_delay_slot[from]) {
+      into |= delay_slot_use[from] | (value - delay_slot_def[from]);
+    } else {
+      into |= value;
+    }
+  }
+
+  Value transfer(int block, const Value& value) const {
+    return liveness->use[block] | (value - liveness->def[block]);
+  }
+};
+
+// registers which always hold the same value, so they don't need to be tracked.
+constexpr RegisterSet constant_registers = RegisterSet()
+                                               .add(Register(Reg::GPR, Reg::R0))
+                                               .add(Register(Reg::VF, 0))
+                                               .add(Register(Reg::VI, 0));
+
+/*!
+ * The registers a GOAL function has to restore before it returns.
+ */
+RegisterSet saved_registers() {
+  RegisterSet result;
+  for (auto gpr : {Reg::FP, Reg::GP, Reg::S0, Reg::S1, Reg::S2, Reg::S3, Reg::S4, Reg::S5}) {
+    result.insert(Register(Reg::GPR, gpr));
+  }
+  for (int fpr = 20; fpr <= 30; fpr += 2) {
+    result.insert(Register(Reg::FPR, fpr));
+  }
+  return result;
+}
+
+/*!
+ * The registers read by the function called by jalr, other than the function itself: the
+ * arguments, the stack pointer, the process pointer and the symbol table.
+ */
+RegisterSet make_call_uses() {
+  RegisterSet result;
+  for (auto gpr : {Reg::A0, Reg::A1, Reg::A2, Reg::A3, Reg::T0, Reg::T1, Reg::T2, Reg::T3,
+                   Reg::SP, Reg::S6, Reg::S7}) {
+    result.insert(Register(Reg::GPR, gpr));
+  }
+  return result;
+}
+
+/*!
+ * The registers which may be changed by the function called by jalr: the return value, and
+ * everything else which isn't saved, reserved, or always the same.
+ */
+RegisterSet make_call_defs() {
+  RegisterSet result;
+  for (int gpr = 0; gpr < Reg::MAX_GPR; gpr++) {
+    result.insert(Register(Reg::GPR, gpr));
+  }
+  for (int fpr = 0; fpr < 32; fpr++) {
+    result.insert(Register(Reg::FPR, fpr));
+  }
+  for (auto special : {Reg::HI, Reg::LO, Reg::HI1, Reg::LO1}) {
+    result.insert(Register(Reg::SPECIAL, special));
+  }
+  result -= saved_registers();
+  for (auto gpr : {Reg::R0, Reg::K0, Reg::K1, Reg::SP, Reg::S6, Reg::S7}) {
+    result.erase(Register(Reg::GPR, gpr));
+  }
+  return result;
+}
+
+/*!
+ * Update the use/def of a sequence of instructions with one more instruction at the end.
+ */
+void add_instruction(const Instruction& instr, RegisterSet& use, RegisterSet& def) {
+  use |= instr.reg_uses() - def - constant_registers;
+  def |= instr.reg_defs() - constant_registers;
+}
+
+/*!
+ * Update the use/def of a sequence of instructions with the call made by a jalr, which happens
+ * after its delay slot.
+ */
+void add_call(RegisterSet& use, RegisterSet& def) {
+  static const RegisterSet call_uses = make_call_uses();
+  static const RegisterSet call_defs = make_call_defs();
+  use |= call_uses - def;
+  def |= call_defs;
+}
+
+/*!
+ * Update the use/def of a sequence of instructions with the instructions in [start, end).
+ */
+void add_instructions(const Function& func,
+                      int start,
+                      int end,
+                      RegisterSet& use,
+                      RegisterSet& def) {
+  for (int i = start; i < end; i++) {
+    const auto& instr = func.instructions.at(i);
+    add_instruction(instr, use, def);
+    if (instr.kind == InstructionKind::JALR) {
+      if (i + 1 < end) {
+        add_instruction(func.instructions.at(++i), use, def);
+      }
+      add_call(use, def);
+    }
+  }
+}
+}  // namespace
+
+/*!
+ * The registers which are live when a GOAL function returns: the return value, the stack pointer,
+ * return address, the process pointer, the symbol table, and the saved registers.
+ */
+RegisterSet live_at_function_exit() {
+  RegisterSet result = saved_registers();
+  for (auto gpr : {Reg::V0, Reg::SP, Reg::RA, Reg::S6, Reg::S7}) {
+    result.insert(Register(Reg::GPR, gpr));
+  }
+  return result;
+}
+
+/*!
+ * Find which registers are live in and out of each block of a function.
+ * The function must have basic blocks.
+ *
+ * analyze_prologue removes the prologue and epilogue from the first and last blocks, but they are
+ * included here. Otherwise the epilogue's restores of saved registers aren't seen, and a saved
+ * register used as a temporary would look live until the function returns.
+ */
+Liveness find_liveness(const Function& func) {
+  Liveness result;
+  const auto& cfg = func.cfg;
+  int n_blocks = cfg.block_count();
+  if (n_blocks == 0) {
+    return result;
+  }
+  result.use.resize(n_blocks);
+  result.def.resize(n_blocks);
+
+  LivenessProblem problem;
+  problem.liveness = &result;
+  problem.has_likely_delay_slot.resize(n_blocks);
+  problem.delay_slot_use.resize(n_blocks);
+  problem.delay_slot_def.resize(n_blocks);
+
+  for (int b = 0; b < n_blocks; b++) {
+    const auto& block = cfg.blocks[b];
+    // the first word is the type tag, not an instruction.
+    int start = b == cfg.entry ? 1 : block.start_word;
+    int end = b == n_blocks - 1 ? int(func.instructions.size()) : block.end_word;
+    if (end - 2 >= start && func.instructions.at(end - 2).get_info().is_branch_likely) {
+      end--;
+      problem.has_likely_delay_slot[b] = 1;
+      add_instruction(func.instructions.at(end), problem.delay_slot_use[b],
+                      problem.delay_slot_def[b]);
+    }
+
+    add_instructions(func, start, end, result.use[b], result.def[b]);
+  }
+
+  auto solution = solve_dataflow(cfg, problem);
+  result.live_in = std::move(solution.in);
+  result.live_out = std::move(solution.out);
+  result.iterations = solution.iterations;
+  return result;
+}
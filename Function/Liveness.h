@@ -0,0 +1,26 @@
+#ifndef JAK_DISASSEMBLER_LIVENESS_H
+#define JAK_DISASSEMBLER_LIVENESS_H
+
+#include <vector>
+#include "Disasm/Register.h"
+
+class Function;
+
+/*!
+ * The registers which are live at the start and end of each basic block.
+ *
+ * If a block ends with a branch likely, its delay slot only runs if the branch is taken. The delay
+ * slot is handled on the taken edge, so use/def/live_out are for the block without the delay slot.
+ */
+struct Liveness {
+  std::vector<RegisterSet> use;  // registers read by the block before they are written
+  std::vector<RegisterSet> def;  // registers written by the block
+  std::vector<RegisterSet> live_in;
+  std::vector<RegisterSet> live_out;
+  int iterations = 0;  // how many times a block was processed by the solver
+};
+
+RegisterSet live_at_function_exit();
+Liveness find_liveness(const Function& func);
+
+#endif  // JAK_DISASSEMBLER_LIVENESS_H
@@ -81,22 +81,51 @@ bool LinkedObjectFile::label_points_to_code(int label_id) const {
  * Get the function starting at this label, or error if there is none.
  */
 Function& LinkedObjectFile::get_function_at_label(int label_id) {
-  auto& label = labels.at(label_id);
-  for (auto& func : functions_by_seg.at(label.target_segment)) {
-    // + 4 to skip past type tag to the first word, which is were the label points.
-    if (func.start_word * 4 + 4 == label.offset) {
-      return func;
-    }
+  auto loc = locate_label_in_function(label_id);
+  // the label should point to the first word after the type tag.
+  assert(loc.valid() && loc.instruction == 1);
+  return functions_by_seg.at(labels.at(label_id).target_segment).at(loc.function);
+}
+
+/*!
+ * Find the function and instruction containing the given byte offset, in O(log n) time.
+ * Must be called after find_functions.
+ */
+FunctionLocation LinkedObjectFile::locate_in_function(int seg, int byte_offset) const {
+  FunctionLocation result;
+  if (seg >= int(function_starts_by_seg.size()) || byte_offset < 0) {
+    return result;
+  }
+
+  // find the last function that starts before or at this word.
+  int word = byte_offset / 4;
+  const auto& starts = function_starts_by_seg[seg];
+  auto it = std::upper_bound(starts.begin(), starts.end(), word);
+  if (it == starts.begin()) {
+    return result;
+  }
+
+  int idx = int(it - starts.begin()) - 1;
+  const auto& func = functions_by_seg.at(seg).at(idx);
+  if (word < func.end_word) {
+    result.function = idx;
+    result.instruction = word - func.start_word;
   }
+  return result;
+}
 
-  assert(false);
-  return functions_by_seg.front().front(); // to avoid error
+/*!
+ * Find the function and instruction that a label points to.
+ */
+FunctionLocation LinkedObjectFile::locate_label_in_function(int label_id) const {
+  const auto& label = labels.at(label_id);
+  return locate_in_function(label.target_segment, label.offset);
 }
 
 /*!
  * Get the name of the label.
  */
-std::string LinkedObjectFile::get_label_name(int label_id) const {
+const std::string& LinkedObjectFile::get_label_name(int label_id) const {
   return labels.at(label_id).name;
 }
 
@@ -207,8 +236,8 @@ static const char* segment_names[] = {"main segment", "debug segment", "top-leve
 /*!
  * Print all the words, with link information and labels.
  */
-std::string LinkedObjectFile::print_words() {
-  std::string result;
+void LinkedObjectFile::print_words(TextSink& out) const {
+  std::string& result = out.buffer();
 
   assert(segments <= 3);
   for (int seg = segments; seg-- > 0;) {
@@ -217,65 +246,162 @@ std::string LinkedObjectFile::print_words() {
     result += segment_names[seg];
     result += "\n;------------------------------------------\n";
 
+    // offsets of labels in this segment, in order, so we can find the next labeled word without
+    // looking up every word.
+    std::vector<int> label_offsets;
+    for (auto& label : labels) {
+      if (label.target_segment == seg) {
+        label_offsets.push_back(label.offset);
+      }
+    }
+    std::sort(label_offsets.begin(), label_offsets.end());
+
     // print each word in the segment
-    for (size_t i = 0; i < words_by_seg.at(seg).size(); i++) {
-      for (int j = 0; j < 4; j++) {
-        auto label_id = get_label_at(seg, i * 4 + j);
-        if (label_id != -1) {
-          result += labels.at(label_id).name + ":";
-          if (j != 0) {
-            result += " (offset " + std::to_string(j) + ")";
-          }
-          result += "\n";
+    auto& words = words_by_seg.at(seg);
+    size_t next_label = 0;
+    size_t i = 0;
+    while (i < words.size()) {
+      if (next_label < label_offsets.size() && size_t(label_offsets[next_label] / 4) == i) {
+        append_labels_at_word(result, seg, i);
+        while (next_label < label_offsets.size() && size_t(label_offsets[next_label] / 4) == i) {
+          next_label++;
         }
       }
 
-      auto& word = words_by_seg[seg][i];
-      append_word_to_string(result, word);
+      if (words[i].kind == LinkedWord::PLAIN_DATA) {
+        // batch plain data words up to the next label or linked word.
+        size_t end = words.size();
+        if (next_label < label_offsets.size()) {
+          end = std::min(end, size_t(label_offsets[next_label] / 4));
+        }
+        size_t run_end = i + 1;
+        while (run_end < end && words[run_end].kind == LinkedWord::PLAIN_DATA) {
+          run_end++;
+        }
+        append_plain_data_words(result, &words[i], run_end - i);
+        i = run_end;
+      } else {
+        append_word_to_string(result, words[i]);
+        i++;
+      }
+      out.done_with_part();
     }
   }
+}
 
-  return result;
+/*!
+ * Write a 32-bit value as lowercase hex, without leading zeros (like printf's %x). Always writes 8
+ * bytes to out, but only the returned number of characters are valid.
+ * The conversion is done on all 8 digits at once in a 64-bit integer, without branches.
+ */
+static int write_hex_u32(char* out, uint32_t value) {
+  // spread the nibbles so byte k holds nibble k
+  uint64_t x = value;
+  x = ((x & 0xffff0000ull) << 16) | (x & 0xffffull);
+  x = ((x & 0x0000ff000000ff00ull) << 8) | (x & 0x000000ff000000ffull);
+  x = ((x & 0x00f000f000f000f0ull) << 4) | (x & 0x000f000f000f000full);
+
+  // convert each nibble to an ascii digit, adding 'a' - '0' - 10 to those greater than 9.
+  uint64_t letters = ((x + 0x0606060606060606ull) >> 4) & 0x0101010101010101ull;
+  x += 0x3030303030303030ull + letters * ('a' - '0' - 10);
+
+  // drop leading zeros, then reverse so the most significant digit comes first in memory.
+  int digits = 1 + (value > 0xf) + (value > 0xff) + (value > 0xfff) + (value > 0xffff) +
+               (value > 0xfffff) + (value > 0xffffff) + (value > 0xfffffff);
+  x <<= 8 * (8 - digits);
+  x = ((x & 0x00ff00ff00ff00ffull) << 8) | ((x >> 8) & 0x00ff00ff00ff00ffull);
+  x = ((x & 0x0000ffff0000ffffull) << 16) | ((x >> 16) & 0x0000ffff0000ffffull);
+  x = (x << 32) | (x >> 32);
+  memcpy(out, &x, 8);
+  return digits;
+}
+
+/*!
+ * Add a run of PLAIN_DATA words to the end of a string, formatted like append_word_to_string.
+ */
+void LinkedObjectFile::append_plain_data_words(std::string& dest,
+                                               const LinkedWord* words,
+                                               size_t count) const {
+  const char prefix[] = "    .word 0x";
+  const size_t prefix_len = sizeof(prefix) - 1;
+  size_t start = dest.size();
+  dest.resize(start + count * (prefix_len + 8 + 1));
+  char* out = &dest[start];
+  for (size_t i = 0; i < count; i++) {
+    assert(words[i].kind == LinkedWord::PLAIN_DATA);
+    memcpy(out, prefix, prefix_len);
+    out += prefix_len;
+    out += write_hex_u32(out, words[i].data);
+    *out++ = '\n';
+  }
+  dest.resize(out - dest.data());
+}
+
+/*!
+ * Add the labels pointing into a word to the end of a string. Internal helper for printing.
+ */
+void LinkedObjectFile::append_labels_at_word(std::string& dest, int seg, int word_idx) const {
+  for (int j = 0; j < 4; j++) {
+    auto label_id = get_label_at(seg, word_idx * 4 + j);
+    if (label_id != -1) {
+      dest += labels.at(label_id).name;
+      dest += ':';
+      if (j != 0) {
+        dest += " (offset ";
+        dest += char('0' + j);
+        dest += ')';
+      }
+      dest += '\n';
+    }
+  }
 }
 
 /*!
  * Add a word's printed representation to the end of a string. Internal helper for print_words.
  */
 void LinkedObjectFile::append_word_to_string(std::string& dest, const LinkedWord& word) const {
-  char buff[128];
+  char buff[32];
 
   switch (word.kind) {
     case LinkedWord::PLAIN_DATA:
-      sprintf(buff, "    .word 0x%x\n", word.data);
+      append_plain_data_words(dest, &word, 1);
       break;
     case LinkedWord::PTR:
-      sprintf(buff, "    .word %s\n", labels.at(word.label_id).name.c_str());
+      dest += "    .word ";
+      dest += labels.at(word.label_id).name;
+      dest += '\n';
       break;
     case LinkedWord::SYM_PTR:
-      sprintf(buff, "    .symbol %s\n", word.symbol_name.c_str());
+      dest += "    .symbol ";
+      dest += word.symbol_name;
+      dest += '\n';
       break;
     case LinkedWord::TYPE_PTR:
-      sprintf(buff, "    .type %s\n", word.symbol_name.c_str());
+      dest += "    .type ";
+      dest += word.symbol_name;
+      dest += '\n';
       break;
     case LinkedWord::EMPTY_PTR:
-      sprintf(buff, "    .empty-list\n");  // ?
+      dest += "    .empty-list\n";  // ?
       break;
     case LinkedWord::HI_PTR:
-      sprintf(buff, "    .ptr-hi 0x%x %s\n", word.data >> 16,
-              labels.at(word.label_id).name.c_str());
+      dest.append(buff, sprintf(buff, "    .ptr-hi 0x%x ", word.data >> 16));
+      dest += labels.at(word.label_id).name;
+      dest += '\n';
       break;
     case LinkedWord::LO_PTR:
-      sprintf(buff, "    .ptr-lo 0x%x %s\n", word.data >> 16,
-              labels.at(word.label_id).name.c_str());
+      dest.append(buff, sprintf(buff, "    .ptr-lo 0x%x ", word.data >> 16));
+      dest += labels.at(word.label_id).name;
+      dest += '\n';
       break;
     case LinkedWord::SYM_OFFSET:
-      sprintf(buff, "    .sym-off 0x%x %s\n", word.data >> 16, word.symbol_name.c_str());
+      dest.append(buff, sprintf(buff, "    .sym-off 0x%x ", word.data >> 16));
+      dest += word.symbol_name;
+      dest += '\n';
       break;
     default:
       throw std::runtime_error("nyi");
   }
-
-  dest += buff;
 }
 
 /*!
@@ -397,6 +523,15 @@ void LinkedObjectFile::find_functions() {
       std::reverse(functions_by_seg.at(seg).begin(), functions_by_seg.at(seg).end());
     }
   }
+
+  // build an index for looking up functions by address
+  function_starts_by_seg.clear();
+  function_starts_by_seg.resize(segments);
+  for (int seg = 0; seg < segments; seg++) {
+    for (auto& func : functions_by_seg.at(seg)) {
+      function_starts_by_seg.at(seg).push_back(func.start_word);
+    }
+  }
 }
 
 /*!
@@ -503,9 +638,9 @@ void LinkedObjectFile::process_fp_relative_links() {
 /*!
  * Print disassembled functions and data segments.
  */
-std::string LinkedObjectFile::print_disassembly() {
+void LinkedObjectFile::print_disassembly(TextSink& out) const {
   bool write_hex = get_config().write_hex_near_instructions;
-  std::string result;
+  std::string& result = out.buffer();
 
   assert(segments <= 3);
   for (int seg = segments; seg-- > 0;) {
@@ -517,9 +652,11 @@ std::string LinkedObjectFile::print_disassembly() {
     // functions
     for (auto& func : functions_by_seg.at(seg)) {
       result += ";;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;\n";
-      result += "; .function " + func.guessed_name + "\n";
-      result += ";;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;\n";
-      result += func.prologue.to_string(2) + "\n";
+      result += "; .function ";
+      result += func.guessed_name;
+      result += "\n;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;\n";
+      func.prologue.append_to(result, 2);
+      result += '\n';
 
       // print each instruction in the function.
       bool in_delay_slot = false;
@@ -527,7 +664,8 @@ std::string LinkedObjectFile::print_disassembly() {
       for (int i = 1; i < func.end_word - func.start_word; i++) {
         auto label_id = get_label_at(seg, (func.start_word + i) * 4);
         if (label_id != -1) {
-          result += labels.at(label_id).name + ":\n";
+          result += labels.at(label_id).name;
+          result += ":\n";
         }
 
         for (int j = 1; j < 4; j++) {
@@ -540,98 +678,96 @@ std::string LinkedObjectFile::print_disassembly() {
         }
 
         auto& instr = func.instructions.at(i);
-        std::string line = "    " + instr.to_string(*this);
+        size_t line_start = result.size();
+        result += "    ";
+        instr.append_to(result, *this);
 
         if (write_hex) {
-          if (line.length() < 60) {
-            line.append(60 - line.length(), ' ');
+          size_t line_length = result.size() - line_start;
+          if (line_length < 60) {
+            result.append(60 - line_length, ' ');
           }
-          result += line;
           result += " ;;";
           auto& word = words_by_seg[seg].at(func.start_word + i);
           append_word_to_string(result, word);
         } else {
-          result += line + "\n";
+          result += '\n';
         }
 
         if (in_delay_slot) {
-          result += "\n";
+          result += '\n';
           in_delay_slot = false;
         }
 
         if (gOpcodeInfo[(int)instr.kind].has_delay_slot) {
           in_delay_slot = true;
         }
+        out.done_with_part();
       }
-      result += "\n";
-      //
-      //      int bid = 0;
-      //      for(auto& bblock : func.basic_blocks) {
-      //        result += "BLOCK " + std::to_string(bid++)+ "\n";
-      //        for(int i = bblock.start_word; i < bblock.end_word; i++) {
-      //          if(i >= 0 && i < func.instructions.size()) {
-      //            result += func.instructions.at(i).to_string(*this) + "\n";
-      //          } else {
-      //            result += "BAD BBLOCK INSTR ID " + std::to_string(i);
-      //          }
-      //        }
-      //      }
+      result += '\n';
     }
 
     // print data
     for (size_t i = offset_of_data_zone_by_seg.at(seg); i < words_by_seg.at(seg).size(); i++) {
-      for (int j = 0; j < 4; j++) {
-        auto label_id = get_label_at(seg, i * 4 + j);
-        if (label_id != -1) {
-          result += labels.at(label_id).name + ":";
-          if (j != 0) {
-            result += " (offset " + std::to_string(j) + ")";
-          }
-          result += "\n";
-        }
-      }
+      append_labels_at_word(result, seg, i);
 
       auto& word = words_by_seg[seg][i];
       append_word_to_string(result, word);
 
       if (word.kind == LinkedWord::TYPE_PTR && word.symbol_name == "string") {
-        result += "; " + get_goal_string(seg, i) + "\n";
+        result += "; ";
+        append_goal_string(result, seg, i);
+        result += '\n';
       }
+      out.done_with_part();
     }
   }
+}
 
+/*!
+ * Hacky way to get a GOAL string object
+ */
+std::string LinkedObjectFile::get_goal_string(int seg, int word_idx) const {
+  std::string result;
+  append_goal_string(result, seg, word_idx);
   return result;
 }
 
 /*!
- * Hacky way to get a GOAL string object
+ * Append a GOAL string object (quoted) to the end of a string.
  */
-std::string LinkedObjectFile::get_goal_string(int seg, int word_idx) {
-  std::string result = "\"";
+void LinkedObjectFile::append_goal_string(std::string& dest, int seg, int word_idx) const {
+  size_t start = dest.size();
+  dest += '"';
   // next should be the size
   if (word_idx + 1 >= int(words_by_seg[seg].size())) {
-    return "invalid string!\n";
+    dest.resize(start);
+    dest += "invalid string!\n";
+    return;
   }
-  LinkedWord& size_word = words_by_seg[seg].at(word_idx + 1);
+  const LinkedWord& size_word = words_by_seg[seg].at(word_idx + 1);
   if (size_word.kind != LinkedWord::PLAIN_DATA) {
     // sometimes an array of string pointer triggers this!
-    return "invalid string!\n";
+    dest.resize(start);
+    dest += "invalid string!\n";
+    return;
   }
 
-  //  result += "(size " + std::to_string(size_word.data) + "): ";
   // now characters...
   for (size_t i = 0; i < size_word.data; i++) {
     int word_offset = word_idx + 2 + (i / 4);
     int byte_offset = i % 4;
     auto& word = words_by_seg[seg].at(word_offset);
     if (word.kind != LinkedWord::PLAIN_DATA) {
-      return "invalid string! (check me!)\n";
+      dest.resize(start);
+      dest += "invalid string! (check me!)\n";
+      return;
     }
     char cword[4];
     memcpy(cword, &word.data, 4);
-    result += cword[byte_offset];
+    dest += cword[byte_offset];
   }
-  return result + "\"";
+  dest += '"';
 }
 
 /*!
@@ -650,16 +786,18 @@ bool LinkedObjectFile::has_any_functions() {
  */
 std::string LinkedObjectFile::print_scripts() {
   std::string result;
+  FormPool pool;  // all the forms are freed once everything is printed.
   for (int seg = 0; seg < segments; seg++) {
-    std::vector<bool> already_printed(words_by_seg[seg].size(), false);
+    // the form for each pair we've converted, by the word index of its car.
+    std::vector<Form*> pairs(words_by_seg[seg].size(), nullptr);
+    std::vector<Form*> scripts;
 
     // the linked list layout algorithm of GOAL puts the first pair first.
     // so we want to go in forward order to catch the beginning correctly
     for (size_t word_idx = 0; word_idx < words_by_seg[seg].size(); word_idx++) {
-      // don't print parts of scripts we've already seen
-      // (note that scripts could share contents, which is supported, this is just for starting
-      // off a script print)
-      if (already_printed[word_idx])
+      // don't start a script in the middle of one we've already seen
+      // (scripts can also share contents, which are printed once, and referred to after that)
+      if (pairs[word_idx])
         continue;
 
       // check for linked list by looking for anything that accesses this as a pair (offset of 2)
@@ -667,10 +805,15 @@ std::string LinkedObjectFile::print_scripts() {
       if (label_id != -1) {
         auto& label = labels.at(label_id);
         if ((label.offset & 7) == 2) {
-          result += to_form_script(seg, word_idx, already_printed)->toStringPretty(0, 100) + "\n";
+          scripts.push_back(to_form_script(seg, word_idx, pairs));
         }
       }
     }
+
+    // print once they're all converted, so a list shared with a later script is labeled.
+    for (auto script : scripts) {
+      result += script->toStringPretty(0, 100) + "\n";
+    }
   }
   return result;
 }
@@ -688,34 +831,41 @@ bool LinkedObjectFile::is_empty_list(int seg, int byte_idx) {
  * Convert a linked list to a Form for easy printing.
  * Note : this takes the address of the car of the pair. which is perhaps a bit confusing
  * (in GOAL, this would be (&-> obj car))
+ * Each pair is only converted once. If the list reaches a pair which was already converted, that
+ * part is shared with another list (or is a loop), so it refers to the earlier form instead.
  */
-std::shared_ptr<Form> LinkedObjectFile::to_form_script(int seg,
-                                                       int word_idx,
-                                                       std::vector<bool>& seen) {
+Form* LinkedObjectFile::to_form_script(int seg, int word_idx, std::vector<Form*>& pairs) {
   // the object to currently print. to start off, create pair from the car address we've been given.
   int goal_print_obj = word_idx * 4 + 2;
 
   // resulting form. we can't have a totally empty list (as an empty list looks like a symbol,
-  // so it wouldn't be flagged), so it's safe to make this a pair.
-  auto result = std::make_shared<Form>();
-  result->kind = FormKind::PAIR;
+  // so it wouldn't be flagged), so it's safe to make this a pair, unless it's shared.
+  Form* result = nullptr;
 
-  // the current pair to fill out.
-  auto fill = result;
+  // where to put the next pair.
+  Form** fill = &result;
 
   // loop until we run out of things to add
   for (;;) {
     // check the thing to print is a a pair.
     if ((goal_print_obj & 7) == 2) {
+      auto& pair = pairs.at(goal_print_obj / 4);
+      if (pair) {
+        // the rest of the list was already converted.
+        *fill = to_form_script_reference(seg, goal_print_obj, pair);
+        return result;
+      }
+      pair = FormPool::current().alloc(FormKind::PAIR);
+      *fill = pair;
+
       // first convert the car (again, with (&-> obj car))
-      fill->pair[0] = to_form_script_object(seg, goal_print_obj - 2, seen);
-      seen.at(goal_print_obj / 4) = true;
+      pair->pair[0] = to_form_script_object(seg, goal_print_obj - 2, pairs);
 
       auto cdr_addr = goal_print_obj + 2;
 
       if (is_empty_list(seg, cdr_addr)) {
         // the list has ended!
-        fill->pair[1] = gSymbolTable.getEmptyPair();
+        pair->pair[1] = gSymbolTable.getEmptyPair();
         return result;
       } else {
         // cdr object should be aligned.
@@ -725,12 +875,10 @@ std::shared_ptr<Form> LinkedObjectFile::to_form_script(int seg,
         if (cdr_word.kind == LinkedWord::PTR && (labels.at(cdr_word.label_id).offset & 7) == 2) {
           // yes, proper list. add another pair and link it in to the list.
           goal_print_obj = labels.at(cdr_word.label_id).offset;
-          fill->pair[1] = std::make_shared<Form>();
-          fill->pair[1]->kind = FormKind::PAIR;
-          fill = fill->pair[1];
+          fill = &pair->pair[1];
         } else {
           // improper list, put the last thing in and end
-          fill->pair[1] = to_form_script_object(seg, cdr_addr, seen);
+          pair->pair[1] = to_form_script_object(seg, cdr_addr, pairs);
           return result;
         }
       }
@@ -743,6 +891,20 @@ std::shared_ptr<Form> LinkedObjectFile::to_form_script(int seg,
   return result;
 }
 
+/*!
+ * Refer to a list which to_form_script already converted, by its label, like #L12#.
+ * The list it refers to is printed with the label, like #L12=(...)
+ */
+Form* LinkedObjectFile::to_form_script_reference(int seg, int pair_offset, Form* list) {
+  auto label_id = get_label_at(seg, pair_offset);
+  assert(label_id != -1);
+  auto& name = labels.at(label_id).name;
+  if (!list->label) {
+    list->label = gSymbolTable.intern("#" + name + "=");
+  }
+  return toForm("#" + name + "#");
+}
+
 /*!
  * Is the thing pointed to a string?
  */
@@ -762,10 +924,8 @@ bool LinkedObjectFile::is_string(int seg, int byte_idx) {
 /*!
  * Convert a (pointer object) to some nice representation.
  */
-std::shared_ptr<Form> LinkedObjectFile::to_form_script_object(int seg,
-                                                              int byte_idx,
-                                                              std::vector<bool>& seen) {
-  std::shared_ptr<Form> result;
+Form* LinkedObjectFile::to_form_script_object(int seg, int byte_idx, std::vector<Form*>& pairs) {
+  Form* result = nullptr;
 
   switch (byte_idx & 7) {
     case 0:
@@ -782,7 +942,7 @@ std::shared_ptr<Form> LinkedObjectFile::to_form_script_object(int seg,
         auto offset = labels.at(word.label_id).offset;
         if ((offset & 7) == 2) {
           // list!
-          result = to_form_script(seg, offset / 4, seen);
+          result = to_form_script(seg, offset / 4, pairs);
         } else {
           if (is_string(seg, offset)) {
             result = toForm(get_goal_string(seg, offset / 4 - 1));
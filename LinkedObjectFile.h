@@ -14,6 +14,7 @@
 #include "LinkedWord.h"
 #include "Function/Function.h"
 #include "util/LispPrint.h"
+#include "util/TextSink.h"
 
 
 /*!
@@ -26,6 +27,17 @@ struct Label {
   int offset; // in bytes
 };
 
+/*!
+ * A location inside a function: the index of the function in functions_by_seg, and the index of
+ * the instruction in that function. Both are -1 if the location isn't in a function.
+ */
+struct FunctionLocation {
+  int function = -1;
+  int instruction = -1;
+
+  bool valid() const { return function != -1; }
+};
+
 /*!
  * An object file's data with linking information included.
  */
@@ -42,17 +54,20 @@ public:
   void symbol_link_word(int source_segment, int source_offset, const char* name, LinkedWord::Kind kind);
   void symbol_link_offset(int source_segment, int source_offset, const char* name);
   Function& get_function_at_label(int label_id);
-  std::string get_label_name(int label_id) const;
+  FunctionLocation locate_in_function(int seg, int byte_offset) const;
+  FunctionLocation locate_label_in_function(int label_id) const;
+  const std::string& get_label_name(int label_id) const;
   uint32_t set_ordered_label_names();
   void find_code();
-  std::string print_words();
+  void print_words(TextSink& out) const;
   void find_functions();
   void disassemble_functions();
   void process_fp_relative_links();
   std::string print_scripts();
-  std::string print_disassembly();
+  void print_disassembly(TextSink& out) const;
   bool has_any_functions();
   void append_word_to_string(std::string& dest, const LinkedWord& word) const;
+  void append_plain_data_words(std::string& dest, const LinkedWord* words, size_t count) const;
 
   struct Stats {
     uint32_t total_code_bytes = 0;
@@ -117,13 +132,19 @@ public:
   std::vector<Label> labels;
 
 private:
-  std::shared_ptr<Form> to_form_script(int seg, int word_idx, std::vector<bool>& seen);
-  std::shared_ptr<Form> to_form_script_object(int seg, int byte_idx, std::vector<bool> &seen);
+  Form* to_form_script(int seg, int word_idx, std::vector<Form*>& pairs);
+  Form* to_form_script_object(int seg, int byte_idx, std::vector<Form*>& pairs);
+  Form* to_form_script_reference(int seg, int pair_offset, Form* list);
   bool is_empty_list(int seg, int byte_idx);
   bool is_string(int seg, int byte_idx);
-  std::string get_goal_string(int seg, int word_idx);
+  std::string get_goal_string(int seg, int word_idx) const;
+  void append_goal_string(std::string& dest, int seg, int word_idx) const;
+  void append_labels_at_word(std::string& dest, int seg, int word_idx) const;
 
   std::vector<std::unordered_map<int, int>> label_per_seg_by_offset;
+
+  // start word of each function in functions_by_seg, for binary search.
+  std::vector<std::vector<int>> function_starts_by_seg;
 };
 
 
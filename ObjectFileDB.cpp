@@ -7,6 +7,7 @@
 
 #include "ObjectFileDB.h"
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include "LinkedObjectFileCreation.h"
 #include "config.h"
@@ -15,6 +16,13 @@
 #include "util/FileIO.h"
 #include "util/Timer.h"
 #include "Function/BasicBlocks.h"
+#include "TypeSystem/TypeInfo.h"
+#include "XrefDatabase.h"
+#include "BinaryExport.h"
+#include "CallGraph.h"
+#include "util/OrderedFileWriter.h"
+#include "util/OutputIndex.h"
+#include "util/Compression.h"
 
 /*!
  * Get a unique name for this object file.
@@ -26,7 +34,8 @@ std::string ObjectFileRecord::to_unique_name() const {
 /*!
  * Build an object file DB for the given list of DGOs.
  */
-ObjectFileDB::ObjectFileDB(const std::vector<std::string>& _dgos) {
+ObjectFileDB::ObjectFileDB(const std::vector<std::string>& _dgos)
+    : thread_pool(get_config().num_threads) {
   Timer timer;
 
   printf("- Initializing ObjectFileDB...\n");
@@ -273,18 +282,23 @@ void ObjectFileDB::write_object_file_words(const std::string& output_dir, bool d
   }
 
   Timer timer;
-  uint32_t total_bytes = 0, total_files = 0;
-
+  std::vector<ObjectFileData*> objs;
   for_each_obj([&](ObjectFileData& obj) {
     if (obj.linked_data.segments == 3 || !dump_v3_only) {
-      auto file_text = obj.linked_data.print_words();
-      auto file_name = combine_path(output_dir, obj.record.to_unique_name() + ".txt");
-      total_bytes += file_text.size();
-      write_text_file(file_name, file_text);
-      total_files++;
+      objs.push_back(&obj);
     }
   });
 
+  std::vector<std::string> file_names;
+  for (auto obj : objs) {
+    file_names.push_back(combine_path(output_dir, obj->record.to_unique_name() + ".txt"));
+  }
+
+  uint32_t total_files = 0;
+  uint64_t total_bytes = 0;
+  auto print = [&](int i, TextSink& out) { objs[i]->linked_data.print_words(out); };
+  write_files_in_order(file_names, print, &total_files, &total_bytes);
+
   printf("Wrote object file dumps:\n");
   printf(" total %d files\n", total_files);
   printf(" total %.3f MB\n", total_bytes / ((float)(1u << 20u)));
@@ -300,18 +314,23 @@ void ObjectFileDB::write_disassembly(const std::string& output_dir,
                                      bool disassemble_objects_without_functions) {
   printf("- Writing functions...\n");
   Timer timer;
-  uint32_t total_bytes = 0, total_files = 0;
-
+  std::vector<ObjectFileData*> objs;
   for_each_obj([&](ObjectFileData& obj) {
     if (obj.linked_data.has_any_functions() || disassemble_objects_without_functions) {
-      auto file_text = obj.linked_data.print_disassembly();
-      auto file_name = combine_path(output_dir, obj.record.to_unique_name() + ".func");
-      total_bytes += file_text.size();
-      write_text_file(file_name, file_text);
-      total_files++;
+      objs.push_back(&obj);
     }
   });
 
+  std::vector<std::string> file_names;
+  for (auto obj : objs) {
+    file_names.push_back(combine_path(output_dir, obj->record.to_unique_name() + ".func"));
+  }
+
+  uint32_t total_files = 0;
+  uint64_t total_bytes = 0;
+  auto print = [&](int i, TextSink& out) { objs[i]->linked_data.print_disassembly(out); };
+  write_files_in_order(file_names, print, &total_files, &total_bytes);
+
   printf("Wrote functions dumps:\n");
   printf(" total %d files\n", total_files);
   printf(" total %.3f MB\n", total_bytes / ((float)(1u << 20u)));
@@ -320,6 +339,130 @@ void ObjectFileDB::write_disassembly(const std::string& output_dir,
   printf("\n");
 }
 
+/*!
+ * Generate text files on the thread pool, while a separate thread writes them to disk, so
+ * formatting and writing overlap. Files are created in order. Text is passed to the writer in
+ * blocks, so only a few blocks per thread are in memory, no matter how big the files are.
+ * generate(i, out) should print file i to out.
+ *
+ * If compression is enabled, blocks are LZO compressed by the thread which generated them. Files
+ * get a .lzo extension, unless they go in an archive.
+ */
+void ObjectFileDB::write_files_in_order(const std::vector<std::string>& file_names,
+                                        const std::function<void(int, TextSink&)>& generate,
+                                        uint32_t* total_files,
+                                        uint64_t* total_bytes) {
+  constexpr size_t block_size = 64 * 1024;
+  Timer timer;
+  int count = int(file_names.size());
+  bool compress = archive ? archive->compressed() : get_config().compress_outputs;
+  std::atomic<uint64_t> text_bytes(0);
+  std::atomic<int64_t> format_ns(0);  // generating text, not counting compressing or writing it
+  std::unique_ptr<FileOutput> output;
+  if (archive) {
+    output = std::make_unique<ArchiveFileOutput>(*archive);
+  } else {
+    output = make_file_output_with_index();
+  }
+  auto index_before = get_output_index().stats();
+  std::vector<std::string> output_names = file_names;
+  if (compress && !archive) {
+    for (auto& name : output_names) {
+      name += ".lzo";
+    }
+  }
+  OrderedFileWriter writer(output_names, 4 * thread_pool.size(), std::move(output));
+  std::atomic<int> next_file(0);
+
+  // each thread takes the next file, so only the files being generated are open.
+  thread_pool.parallel_for(thread_pool.size(), [&](int) {
+    for (int i = next_file++; i < count; i = next_file++) {
+      bool ok = true;
+      if (compress && !archive) {
+        ok = writer.write_block(i, compressed_file_header());
+      }
+      Timer format_timer;
+      int64_t sink_ns = 0;
+      TextSink out(block_size, [&](std::string&& block) {
+        Timer sink_timer;
+        text_bytes += block.size();
+        if (ok && compress) {
+          std::string chunks;
+          compress_chunks(block.data(), block.size(), chunks);
+          block = std::move(chunks);
+        }
+        if (ok) {
+          ok = writer.write_block(i, std::move(block));
+        }
+        sink_ns += sink_timer.getNs();
+      });
+
+      try {
+        generate(i, out);
+      } catch (...) {
+        writer.abort();
+        throw;
+      }
+      out.buffer() += '\n';  // like write_text_file
+      out.flush();
+      format_ns += format_timer.getNs() - sink_ns;
+      if (!ok || !writer.close_file(i)) {
+        return;
+      }
+    }
+  });
+
+  writer.finish();
+  *total_files = writer.files_written();
+  *total_bytes = writer.bytes_written();
+  if (format_ns > 0) {
+    printf(" formatted %.3f MB of text in %.3f ms of CPU time summed over threads (%.3f MB/sec)\n",
+           text_bytes / ((float)(1u << 20u)), format_ns / 1.e6,
+           text_bytes / ((1u << 20u) * (format_ns / 1.e9)));
+  }
+  printf(" wrote with %s: %.0f files/sec, %.3f MB/sec\n", writer.output_name(),
+         *total_files / timer.getSeconds(), *total_bytes / ((1u << 20u) * timer.getSeconds()));
+  if (compress) {
+    printf(" compressed %.3f MB to %.3f MB\n", text_bytes / ((float)(1u << 20u)),
+           *total_bytes / ((float)(1u << 20u)));
+  }
+  if (get_output_index().enabled() && !archive) {
+    auto index_after = get_output_index().stats();
+    printf(" skipped %d unchanged files (%.3f MB), wrote %d files (%.3f MB)\n",
+           index_after.skipped_files - index_before.skipped_files,
+           (index_after.skipped_bytes - index_before.skipped_bytes) / ((float)(1u << 20u)),
+           index_after.written_files - index_before.written_files,
+           (index_after.written_bytes - index_before.written_bytes) / ((float)(1u << 20u)));
+  }
+}
+
+/*!
+ * Get a FileOutput for writing separate files, which skips unchanged files if enabled.
+ */
+std::unique_ptr<FileOutput> ObjectFileDB::make_file_output_with_index() {
+  auto output = make_file_output(get_config().use_io_uring);
+  if (get_output_index().enabled()) {
+    output = std::make_unique<SkipUnchangedFileOutput>(get_output_index(), std::move(output));
+  }
+  return output;
+}
+
+/*!
+ * Put the disassembly and hexdump files into an archive, instead of writing separate files.
+ * Read it with jak_disassembler --archive.
+ */
+void ObjectFileDB::open_archive(const std::string& file_name, bool compress) {
+  assert(!archive);
+  archive = std::make_unique<ArchiveWriter>(file_name, compress);
+}
+
+void ObjectFileDB::finish_archive() {
+  if (archive) {
+    archive->finish();
+    archive.reset();
+  }
+}
+
 /*!
  * Find code/data zones, identify functions, and disassemble
  */
@@ -369,22 +512,47 @@ void ObjectFileDB::find_code() {
 void ObjectFileDB::find_and_write_scripts(const std::string& output_dir) {
   printf("- Finding scripts in object files...\n");
   Timer timer;
-  std::string all_scripts;
+  std::vector<ObjectFileData*> objs;
+  for_each_obj([&](ObjectFileData& obj) { objs.push_back(&obj); });
 
-  for_each_obj([&](ObjectFileData& obj) {
-    auto scripts = obj.linked_data.print_scripts();
-    if (!scripts.empty()) {
-      all_scripts += ";--------------------------------------\n";
-      all_scripts += "; " + obj.record.to_unique_name() + "\n";
-      all_scripts += ";---------------------------------------\n";
-      all_scripts += scripts;
+  // objects are done in batches on the thread pool, and each batch is written in order while the
+  // next one is found, so only a few batches of scripts are in memory at once.
+  auto file_name = combine_path(output_dir, "all_scripts.lisp");
+  OrderedFileWriter writer({file_name}, 1, make_file_output_with_index());
+  int batch_size = 4 * thread_pool.size();
+  std::vector<std::string> scripts(batch_size);
+  uint64_t total_bytes = 0;
+  bool ok = true;
+
+  for (int start = 0; ok && start < int(objs.size()); start += batch_size) {
+    int count = std::min(batch_size, int(objs.size()) - start);
+    thread_pool.parallel_for(count, [&](int i) {
+      auto obj = objs[start + i];
+      auto obj_scripts = obj->linked_data.print_scripts();
+      scripts[i].clear();
+      if (!obj_scripts.empty()) {
+        scripts[i] += ";--------------------------------------\n";
+        scripts[i] += "; " + obj->record.to_unique_name() + "\n";
+        scripts[i] += ";---------------------------------------\n";
+        scripts[i] += obj_scripts;
+      }
+    });
+
+    std::string block;
+    for (int i = 0; i < count; i++) {
+      block += scripts[i];
     }
-  });
+    total_bytes += block.size();
+    ok = writer.write_block(0, std::move(block));
+  }
 
-  auto file_name = combine_path(output_dir, "all_scripts.lisp");
-  write_text_file(file_name, all_scripts);
+  if (ok && writer.write_block(0, "\n")) {  // like write_text_file
+    writer.close_file(0);
+  }
+  writer.finish();
 
   printf("Found scripts:\n");
+  printf(" total %.3f MB\n", total_bytes / ((float)(1u << 20u)));
   printf(" total %.3f ms\n", timer.getMs());
   printf("\n");
 }
@@ -395,29 +563,208 @@ void ObjectFileDB::analyze_functions() {
 
   if (get_config().find_basic_blocks) {
     timer.start();
-    int total_basic_blocks = 0;
+
+    // functions are independent here, so analyze them all in parallel. Big object files have
+    // lots of functions, so splitting by function instead of by object keeps all threads busy.
+    struct Work {
+      Function* func;
+      int segment_id;
+      ObjectFileData* data;
+      double dominator_ms;
+      double liveness_ms;
+    };
+    std::vector<Work> work;
     for_each_function([&](Function& func, int segment_id, ObjectFileData& data) {
-      auto blocks = find_blocks_in_function(data.linked_data, segment_id, func);
-      total_basic_blocks += blocks.size();
-      func.basic_blocks = blocks;
-      func.analyze_prologue(data.linked_data);
+      work.push_back({&func, segment_id, &data, 0, 0});
+    });
+
+    thread_pool.parallel_for(int(work.size()), [&](int i) {
+      auto& w = work[i];
+      w.func->cfg = find_blocks_in_function(w.data->linked_data, w.segment_id, *w.func);
+
+      Timer dominator_timer;
+      w.func->dominators = find_dominators(w.func->cfg);
+      w.func->loops = find_loops(w.func->cfg, w.func->dominators);
+      w.dominator_ms = dominator_timer.getMs();
+
+      w.func->analyze_prologue(w.data->linked_data);
+
+      Timer liveness_timer;
+      w.func->liveness = find_liveness(*w.func);
+      w.liveness_ms = liveness_timer.getMs();
     });
 
-    printf("Found %d basic blocks in %.3f ms\n", total_basic_blocks, timer.getMs());
+    // print messages in function order, so the output doesn't depend on the scheduling.
+    int total_basic_blocks = 0;
+    int total_edges = 0;
+    int total_loops = 0;
+    double total_dominator_ms = 0;
+    double total_liveness_ms = 0;
+    int total_liveness_iterations = 0;
+    const Work* largest = nullptr;
+    for (auto& w : work) {
+      total_basic_blocks += w.func->cfg.block_count();
+      total_edges += w.func->cfg.edge_count();
+      total_loops += int(w.func->loops.loops.size());
+      total_dominator_ms += w.dominator_ms;
+      total_liveness_ms += w.liveness_ms;
+      total_liveness_iterations += w.func->liveness.iterations;
+      if (!largest || w.func->cfg.block_count() > largest->func->cfg.block_count()) {
+        largest = &w;
+      }
+      fputs(w.func->log_messages.c_str(), stdout);
+      w.func->log_messages.clear();
+    }
+
+    printf("Found %d basic blocks (%d edges) in %.3f ms\n", total_basic_blocks, total_edges,
+           timer.getMs());
+    if (largest) {
+      // the per function times are added up across threads, so this is CPU time, not wall time.
+      printf(
+          "Found dominators and %d loops in %.3f ms of CPU time summed over threads (largest "
+          "function: %d blocks, %.3f ms)\n",
+          total_loops, total_dominator_ms, largest->func->cfg.block_count(),
+          largest->dominator_ms);
+    }
+    printf("Found register liveness in %.3f ms of CPU time summed over threads (%d block "
+           "iterations)\n",
+           total_liveness_ms, total_liveness_iterations);
   }
 
   {
     timer.start();
+    std::vector<ObjectFileData*> top_level_objs;
     for_each_obj([&](ObjectFileData& data) {
-      if(data.linked_data.segments == 3) {
+      if (data.linked_data.segments == 3) {
         // the top level segment should have a single function
         assert(data.linked_data.functions_by_seg.at(2).size() == 1);
+        top_level_objs.push_back(&data);
+      }
+    });
+
+    // find in parallel...
+    std::vector<std::vector<GlobalFunctionDef>> defs(top_level_objs.size());
+    thread_pool.parallel_for(int(top_level_objs.size()), [&](int i) {
+      auto& file = top_level_objs[i]->linked_data;
+      defs[i] = file.functions_by_seg.at(2).front().find_global_function_defs(file);
+    });
+
+    // ...then update names and types in object file order.
+    for (size_t i = 0; i < top_level_objs.size(); i++) {
+      auto& file = top_level_objs[i]->linked_data;
+      auto& top_level_func = file.functions_by_seg.at(2).front();
+      assert(top_level_func.guessed_name.empty());
+      top_level_func.guessed_name = "(top-level-init)";
 
-        auto& func = data.linked_data.functions_by_seg.at(2).front();
+      for (auto& def : defs[i]) {
+        auto& func = file.get_function_at_label(def.label_id);
         assert(func.guessed_name.empty());
-        func.guessed_name = "(top-level-init)";
-        func.find_global_function_defs(data.linked_data);
+        func.guessed_name = def.name;
+        get_type_info().inform_symbol(def.name, TypeSpec("function"));
       }
-    });
+    }
+  }
+}
+
+/*!
+ * Find references to all symbols, types, and labels in all objects. These are used by the xref
+ * database and the binary export.
+ */
+void ObjectFileDB::find_all_xrefs() {
+  printf("- Finding cross references...\n");
+  Timer timer;
+
+  xrefs.objs.clear();
+  xrefs.names.clear();
+  for_each_obj([&](ObjectFileData& obj) {
+    xrefs.objs.push_back(&obj);
+    xrefs.names.push_back(obj.record.to_unique_name());
+  });
+
+  xrefs.refs.clear();
+  xrefs.refs.resize(xrefs.objs.size());
+  thread_pool.parallel_for(int(xrefs.objs.size()), [&](int i) {
+    xrefs.refs[i] = find_xrefs(xrefs.objs[i]->linked_data, i, xrefs.names[i]);
+  });
+
+  size_t total_refs = 0;
+  for (auto& obj : xrefs.refs) {
+    total_refs += obj.refs.size();
+  }
+  printf("Found %ld cross references in %.3f ms\n\n", total_refs, timer.getMs());
+}
+
+/*!
+ * Write the cross references to a database file which can be searched with
+ * jak_disassembler --xref.
+ */
+void ObjectFileDB::write_xrefs(const std::string& output_dir) {
+  printf("- Writing cross references...\n");
+  Timer timer;
+
+  auto data = build_xref_database(xrefs.names, xrefs.refs);
+  write_binary_file(combine_path(output_dir, "xrefs.bin"), data.data(), data.size());
+
+  printf("Wrote %ld bytes in %.3f ms\n\n", data.size(), timer.getMs());
+}
+
+/*!
+ * Write the objects, functions, instructions, labels, basic blocks and symbol references to a
+ * binary file for other tools. It can be checked with jak_disassembler --export-info.
+ */
+void ObjectFileDB::write_binary_export(const std::string& output_dir) {
+  printf("- Writing binary export...\n");
+  Timer timer;
+
+  BinaryExportBuilder builder;
+  for (size_t i = 0; i < xrefs.objs.size(); i++) {
+    builder.add_object(xrefs.names[i], xrefs.objs[i]->linked_data, xrefs.refs[i]);
+  }
+  auto data = builder.to_binary();
+  write_binary_file(combine_path(output_dir, "export.jdx"), data.data(), data.size());
+
+  printf("Exported %ld instructions (%ld bytes) in %.3f ms\n\n", builder.instruction_count(),
+         data.size(), timer.getMs());
+}
+
+/*!
+ * Find all function calls and write the whole-game call graph to a file. Parts of it can be
+ * converted to DOT with jak_disassembler --callgraph.
+ */
+void ObjectFileDB::write_call_graph(const std::string& output_dir) {
+  printf("- Finding call graph...\n");
+  Timer timer;
+
+  std::vector<ObjectFileData*> objs;
+  std::vector<int> first_function_by_object;
+  std::vector<CallGraph::FunctionInfo> functions;
+  for_each_obj([&](ObjectFileData& obj) {
+    objs.push_back(&obj);
+    first_function_by_object.push_back(functions.size());
+    auto name = obj.record.to_unique_name();
+    for (int seg = 0; seg < obj.linked_data.segments; seg++) {
+      auto& seg_functions = obj.linked_data.functions_by_seg.at(seg);
+      for (int fn = 0; fn < int(seg_functions.size()); fn++) {
+        functions.push_back({seg_functions[fn].guessed_name, name, seg, fn});
+      }
+    }
+  });
+
+  std::vector<ObjectCalls> calls(objs.size());
+  thread_pool.parallel_for(int(objs.size()),
+                           [&](int i) { calls[i] = find_calls(objs[i]->linked_data); });
+
+  auto graph = CallGraph::build(functions, first_function_by_object, calls);
+  auto data = graph.to_binary();
+  write_binary_file(combine_path(output_dir, "callgraph.bin"), data.data(), data.size());
+
+  size_t total_calls = 0;
+  int total_indirect = 0;
+  for (auto& obj : calls) {
+    total_calls += obj.callers.size();
+    total_indirect += obj.n_indirect;
   }
+  printf("Found %ld calls (%d edges, %d undefined functions, %d indirect calls) in %.3f ms\n\n",
+         total_calls, graph.edge_count(), graph.node_count() - graph.function_count(),
+         total_indirect, timer.getMs());
 }
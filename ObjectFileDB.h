@@ -9,10 +9,15 @@
 #define JAK2_DISASSEMBLER_OBJECTFILEDB_H
 
 #include <cassert>
+#include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "LinkedObjectFile.h"
+#include "XrefDatabase.h"
+#include "util/Archive.h"
+#include "util/ThreadPool.h"
 
 /*!
  * A "record" which can be used to identify an object file.
@@ -46,9 +51,20 @@ class ObjectFileDB {
   void write_object_file_words(const std::string& output_dir, bool dump_v3_only);
   void write_disassembly(const std::string& output_dir, bool disassemble_objects_without_functions);
   void analyze_functions();
+  void find_all_xrefs();
+  void write_xrefs(const std::string& output_dir);
+  void write_call_graph(const std::string& output_dir);
+  void write_binary_export(const std::string& output_dir);
+  void open_archive(const std::string& file_name, bool compress);
+  void finish_archive();
 
  private:
   void get_objs_from_dgo(const std::string& filename);
+  std::unique_ptr<FileOutput> make_file_output_with_index();
+  void write_files_in_order(const std::vector<std::string>& file_names,
+                            const std::function<void(int, TextSink&)>& generate,
+                            uint32_t* total_files,
+                            uint64_t* total_bytes);
   void add_obj_from_dgo(const std::string& obj_name,
                         uint8_t* obj_data,
                         uint32_t obj_size,
@@ -94,6 +110,16 @@ class ObjectFileDB {
 
   std::vector<std::string> obj_file_order;
 
+  ThreadPool thread_pool;
+  std::unique_ptr<ArchiveWriter> archive;  // if set, output files go here instead
+
+  // cross references from find_all_xrefs, for each object in the order of for_each_obj.
+  struct {
+    std::vector<ObjectFileData*> objs;
+    std::vector<std::string> names;
+    std::vector<ObjectXrefs> refs;
+  } xrefs;
+
   struct {
     uint32_t total_dgo_bytes = 0;
     uint32_t total_obj_files = 0;
@@ -1,7 +1,6 @@
 #ifndef JAK_DISASSEMBLER_GOALSYMBOL_H
 #define JAK_DISASSEMBLER_GOALSYMBOL_H
 
-#include <cassert>
 #include <string>
 #include "TypeSpec.h"
 
@@ -17,16 +16,22 @@ class GoalSymbol {
     return m_has_type_info;
   }
 
-  void set_type(TypeSpec ts) {
-    if(m_has_type_info) {
-      if(ts != m_type) {
-        printf("symbol %s %s -> %s", m_name.c_str(), m_type.to_string().c_str(), ts.to_string().c_str());
-        assert(false);
-      }
+  const TypeSpec& type() const {
+    return m_type;
+  }
+
+  /*!
+   * Set the type of the symbol. Returns false, and leaves it alone, if it already has a different
+   * one, so the caller can report it.
+   */
+  bool set_type(TypeSpec ts) {
+    if (m_has_type_info) {
+      return ts == m_type;
     }
 
     m_has_type_info = true;
     m_type = std::move(ts);
+    return true;
   }
 
  private:
@@ -1,42 +1,115 @@
 #include "TypeInfo.h"
 
+#include <cassert>
+#include <cstdio>
+#include <functional>
 #include <utility>
 
 namespace {
 TypeInfo gTypeInfo;
+
+/*!
+ * A symbol was informed of a type which isn't the one it already has. Called after the shard is
+ * unlocked, so other threads aren't stuck behind the report.
+ */
+void report_type_conflict(const std::string& name,
+                          const std::string& old_type,
+                          const TypeSpec& new_type) {
+  printf("symbol %s %s -> %s\n", name.c_str(), old_type.c_str(), new_type.to_string().c_str());
+  assert(false);
 }
+}  // namespace
 
 TypeInfo::TypeInfo() {
-  GoalType type_type("type");
-  m_types["type"] = type_type;
-  GoalSymbol type_symbol("type");
-  m_symbols["type"] = type_symbol;
+  update("type", [](Entry& entry) { make_type(entry); });
 }
 
 TypeInfo& get_type_info() {
   return gTypeInfo;
 }
 
-std::string TypeInfo::get_summary() {
-  int total_symbols = 0;
-  int syms_with_type_info = 0;
-  for (const auto& kv : m_symbols) {
-    total_symbols++;
-    if (kv.second.has_type_info()) {
-      syms_with_type_info++;
+/*!
+ * Find the entry for a name, adding it if there isn't one. The shard must be locked.
+ */
+TypeInfo::Entry& TypeInfo::Shard::find_or_insert(const std::string& name, size_t hash) {
+  if (2 * (entries.size() + 1) > slots.size()) {
+    grow();
+  }
+
+  auto mask = slots.size() - 1;
+  for (auto i = hash & mask;; i = (i + 1) & mask) {
+    auto& slot = slots[i];
+    if (!slot.entry) {
+      entries.emplace_back(name);
+      slot.hash = hash;
+      slot.entry = &entries.back();
+      return entries.back();
+    }
+    if (slot.hash == hash && slot.entry->name == name) {
+      return *slot.entry;
     }
   }
+}
 
+/*!
+ * Double the number of slots. The entries don't move.
+ */
+void TypeInfo::Shard::grow() {
+  std::vector<Slot> old_slots(slots.empty() ? 32 : 2 * slots.size());
+  std::swap(slots, old_slots);
+  auto mask = slots.size() - 1;
+  for (auto& old : old_slots) {
+    if (old.entry) {
+      auto i = old.hash & mask;
+      while (slots[i].entry) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = old;
+    }
+  }
+}
+
+/*!
+ * Lock the shard with this name, and call f with its entry.
+ */
+template <typename Func>
+void TypeInfo::update(const std::string& name, Func f) {
+  auto hash = std::hash<std::string>()(name);
+  auto& shard = m_shards[hash & (SHARD_COUNT - 1)];
+  std::lock_guard<std::mutex> lk(shard.mutex);
+  f(shard.find_or_insert(name, hash >> SHARD_BITS));
+}
+
+void TypeInfo::make_type(Entry& entry) {
+  if (!entry.is_type) {
+    entry.type = GoalType(entry.name);
+    entry.is_type = true;
+  }
+}
+
+std::string TypeInfo::get_summary() {
+  int total_symbols = 0;
+  int syms_with_type_info = 0;
   int total_types = 0;
   int types_with_info = 0;
   int types_with_method_count = 0;
-  for (const auto& kv : m_types) {
-    total_types++;
-    if (kv.second.has_info()) {
-      types_with_info++;
-    }
-    if (kv.second.has_method_count()) {
-      types_with_method_count++;
+  for (auto& shard : m_shards) {
+    std::lock_guard<std::mutex> lk(shard.mutex);
+    for (const auto& entry : shard.entries) {
+      total_symbols++;
+      if (entry.symbol.has_type_info()) {
+        syms_with_type_info++;
+      }
+
+      if (entry.is_type) {
+        total_types++;
+        if (entry.type.has_info()) {
+          types_with_info++;
+        }
+        if (entry.type.has_method_count()) {
+          types_with_method_count++;
+        }
+      }
     }
   }
 
@@ -60,29 +133,46 @@ std::string TypeInfo::get_summary() {
  * Provides no type info - if some is already known there is no change.
  */
 void TypeInfo::inform_symbol_with_no_type_info(const std::string& name) {
-  if (m_symbols.find(name) == m_symbols.end()) {
-    // only add it if we haven't seen this already.
-    GoalSymbol sym(name);
-    m_symbols[name] = sym;
-  }
+  // only add it if we haven't seen this already.
+  update(name, [](Entry&) {});
 }
 
-void TypeInfo::inform_symbol(const std::string &name, TypeSpec type) {
-  inform_symbol_with_no_type_info(name);
-  m_symbols.at(name).set_type(std::move(type));
+void TypeInfo::inform_symbol(const std::string& name, TypeSpec type) {
+  std::string conflict;
+  update(name, [&](Entry& entry) {
+    if (!entry.symbol.set_type(type)) {
+      conflict = entry.symbol.type().to_string();
+    }
+  });
+  if (!conflict.empty()) {
+    report_type_conflict(name, conflict, type);
+  }
 }
 
 void TypeInfo::inform_type(const std::string& name) {
-  if (m_types.find(name) == m_types.end()) {
-    GoalType typ(name);
-    m_types[name] = typ;
+  std::string conflict;
+  update(name, [&](Entry& entry) {
+    make_type(entry);
+    if (!entry.symbol.set_type(TypeSpec("type"))) {
+      conflict = entry.symbol.type().to_string();
+    }
+  });
+  if (!conflict.empty()) {
+    report_type_conflict(name, conflict, TypeSpec("type"));
   }
-  inform_symbol(name, TypeSpec("type"));
 }
 
 void TypeInfo::inform_type_method_count(const std::string& name, int methods) {
   // create type and symbol
-  inform_type(name);
-  m_types.at(name).set_methods(methods);
+  std::string conflict;
+  update(name, [&](Entry& entry) {
+    make_type(entry);
+    if (!entry.symbol.set_type(TypeSpec("type"))) {
+      conflict = entry.symbol.type().to_string();
+    }
+    entry.type.set_methods(methods);
+  });
+  if (!conflict.empty()) {
+    report_type_conflict(name, conflict, TypeSpec("type"));
+  }
 }
-
@@ -1,11 +1,20 @@
 #ifndef JAK_DISASSEMBLER_TYPEINFO_H
 #define JAK_DISASSEMBLER_TYPEINFO_H
 
-#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "GoalType.h"
-#include "GoalFunction.h"
 #include "GoalSymbol.h"
 
+/*!
+ * Everything we know about symbols and types, by name.
+ *
+ * Names are split between shards by their hash, and each shard has its own lock, so this can be
+ * informed from multiple threads without them waiting on each other much. Each name has a single
+ * entry for its symbol and its type (if it is one), so an update only has to find it once.
+ */
 class TypeInfo {
  public:
   TypeInfo();
@@ -18,9 +27,39 @@ class TypeInfo {
   std::string get_summary();
 
  private:
-  std::unordered_map<std::string, GoalType> m_types;
-  std::unordered_map<std::string, GoalFunction> m_global_functions;
-  std::unordered_map<std::string, GoalSymbol> m_symbols;
+  struct Entry {
+    explicit Entry(const std::string& _name) : name(_name), symbol(_name) {}
+    std::string name;
+    GoalSymbol symbol;
+    GoalType type;  // only valid if is_type
+    bool is_type = false;
+  };
+
+  /*!
+   * An open addressing hash table of entries, with linear probing.
+   */
+  struct Shard {
+    struct Slot {
+      size_t hash = 0;
+      Entry* entry = nullptr;
+    };
+
+    Entry& find_or_insert(const std::string& name, size_t hash);
+    void grow();
+
+    std::mutex mutex;
+    std::vector<Slot> slots;
+    std::deque<Entry> entries;
+  };
+
+  static constexpr int SHARD_BITS = 6;
+  static constexpr int SHARD_COUNT = 1 << SHARD_BITS;
+
+  template <typename Func>
+  void update(const std::string& name, Func f);
+  static void make_type(Entry& entry);
+
+  Shard m_shards[SHARD_COUNT];
 };
 
 TypeInfo& get_type_info();
@@ -15,11 +15,14 @@ std::string TypeSpec::to_string() const {
   }
 }
 
-std::shared_ptr<Form> TypeSpec::to_form() const {
+/*!
+ * Convert to a form, made in the current FormPool.
+ */
+Form* TypeSpec::to_form() const {
   if (m_args.empty()) {
     return toForm(m_base_type);
   } else {
-    std::vector<std::shared_ptr<Form>> all;
+    std::vector<Form*> all;
     all.push_back(toForm(m_base_type));
     for (const auto& x : m_args) {
       all.push_back(x.to_form());
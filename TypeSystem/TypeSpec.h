@@ -12,7 +12,7 @@ class TypeSpec {
   TypeSpec(std::string base_type, std::vector<TypeSpec> args) : m_base_type(std::move(base_type)), m_args(std::move(args)) { }
 
   std::string to_string() const;
-  std::shared_ptr<Form> to_form() const;
+  Form* to_form() const;
 
   bool operator==(const TypeSpec& other) const;
   bool operator!=(const TypeSpec& other) const;
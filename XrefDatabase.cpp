@@ -0,0 +1,331 @@
+/*!
+ * @file XrefDatabase.cpp
+ * A cross-reference database: for every symbol, type and label, where is it referenced?
+ *
+ * File format (all integers are little endian uint32s):
+ *  header: "XREF", version, object count, target count, reference count, string table size
+ *  objects: string table offset of the name of each object file
+ *  targets: (string table offset of name, index of first reference) for each target, sorted by name
+ *  references: XrefLocation for each reference, grouped by target
+ *  string table: null terminated strings
+ */
+
+#include "XrefDatabase.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include "LinkedObjectFile.h"
+#include "util/FileIO.h"
+#include "util/MappedFile.h"
+#include "util/Timer.h"
+
+namespace {
+constexpr uint32_t XREF_VERSION = 1;
+
+struct XrefFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t n_objects;
+  uint32_t n_targets;
+  uint32_t n_refs;
+  uint32_t string_table_size;
+};
+
+struct XrefFileTarget {
+  uint32_t name;
+  uint32_t first_ref;
+};
+
+const char* xref_kind_names[(int)XrefKind::MAX_KIND] = {
+    "symbol", "symbol-offset", "type", "label", "label-hi", "label-lo", "branch", "instr-label"};
+
+template <typename T>
+void append_pod(std::vector<uint8_t>& dest, const T& value) {
+  auto ptr = (const uint8_t*)&value;
+  dest.insert(dest.end(), ptr, ptr + sizeof(T));
+}
+}  // namespace
+
+const char* xref_kind_to_charp(XrefKind kind) {
+  assert(kind < XrefKind::MAX_KIND);
+  return xref_kind_names[(int)kind];
+}
+
+/*!
+ * Find all references in an object file. Doesn't modify anything, so this can run on many object
+ * files in parallel.
+ *
+ * Linked words give us pointers to symbols, types and labels. Instructions which load a symbol
+ * are SYM_OFFSET words, so the only extra references from instructions are labels for branches
+ * and fp-relative addressing.
+ */
+ObjectXrefs find_xrefs(const LinkedObjectFile& file,
+                       uint32_t object_id,
+                       const std::string& object_name) {
+  ObjectXrefs result;
+
+  auto add_ref = [&](const std::string& target, int seg, int offset, int function, XrefKind kind) {
+    XrefLocation loc;
+    loc.object = object_id;
+    loc.function = function;
+    loc.offset = offset;
+    loc.segment = seg;
+    loc.kind = kind;
+    result.targets.push_back(target);
+    result.refs.push_back(loc);
+  };
+
+  auto label_target = [&](int label_id) {
+    return object_name + "/" + file.get_label_name(label_id);
+  };
+
+  for (int seg = 0; seg < file.segments; seg++) {
+    const auto& words = file.words_by_seg.at(seg);
+    for (int word_idx = 0; word_idx < int(words.size()); word_idx++) {
+      const auto& word = words[word_idx];
+      if (word.kind == LinkedWord::PLAIN_DATA || word.kind == LinkedWord::EMPTY_PTR) {
+        continue;
+      }
+
+      int offset = word_idx * 4;
+      int function = file.locate_in_function(seg, offset).function;
+      switch (word.kind) {
+        case LinkedWord::PTR:
+          add_ref(label_target(word.label_id), seg, offset, function, XrefKind::LABEL);
+          break;
+        case LinkedWord::HI_PTR:
+          add_ref(label_target(word.label_id), seg, offset, function, XrefKind::LABEL_HI);
+          break;
+        case LinkedWord::LO_PTR:
+          add_ref(label_target(word.label_id), seg, offset, function, XrefKind::LABEL_LO);
+          break;
+        case LinkedWord::SYM_PTR:
+          add_ref(word.symbol_name, seg, offset, function, XrefKind::SYMBOL);
+          break;
+        case LinkedWord::SYM_OFFSET:
+          add_ref(word.symbol_name, seg, offset, function, XrefKind::SYMBOL_OFFSET);
+          break;
+        case LinkedWord::TYPE_PTR:
+          add_ref(word.symbol_name, seg, offset, function, XrefKind::TYPE);
+          break;
+        default:
+          assert(false);
+      }
+    }
+
+    const auto& functions = file.functions_by_seg.at(seg);
+    for (int function = 0; function < int(functions.size()); function++) {
+      const auto& func = functions[function];
+      for (int i = 0; i < int(func.instructions.size()); i++) {
+        const auto& instr = func.instructions[i];
+        int word_idx = func.start_word + i;
+        if (words.at(word_idx).kind != LinkedWord::PLAIN_DATA) {
+          continue;  // already added from the linked word
+        }
+
+        for (int j = 0; j < instr.n_src; j++) {
+          const auto& atom = instr.get_src(j);
+          if (atom.kind == InstructionAtom::LABEL) {
+            auto kind = instr.get_info().is_branch ? XrefKind::BRANCH : XrefKind::INSTRUCTION_LABEL;
+            add_ref(label_target(atom.get_label()), seg, word_idx * 4, function, kind);
+          }
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+/*!
+ * Combine the references from all object files into the database file format.
+ * References to each target are kept in the order of object_names.
+ */
+std::vector<uint8_t> build_xref_database(const std::vector<std::string>& object_names,
+                                         const std::vector<ObjectXrefs>& xrefs) {
+  // assign an id to each target, in order of first appearance.
+  std::unordered_map<std::string, uint32_t> target_ids;
+  std::vector<const std::string*> target_names;
+  std::vector<uint32_t> ref_counts;
+  std::vector<uint32_t> ref_target_ids;
+  for (auto& obj : xrefs) {
+    for (auto& target : obj.targets) {
+      auto it = target_ids.find(target);
+      if (it == target_ids.end()) {
+        it = target_ids.insert({target, uint32_t(target_names.size())}).first;
+        target_names.push_back(&it->first);
+        ref_counts.push_back(0);
+      }
+      ref_counts[it->second]++;
+      ref_target_ids.push_back(it->second);
+    }
+  }
+
+  // sort the targets by name, so the reader can binary search.
+  uint32_t n_targets = target_names.size();
+  std::vector<uint32_t> sorted(n_targets);
+  for (uint32_t i = 0; i < n_targets; i++) {
+    sorted[i] = i;
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [&](uint32_t a, uint32_t b) { return *target_names[a] < *target_names[b]; });
+
+  // string table
+  std::string strings;
+  std::vector<uint32_t> object_name_offsets;
+  for (auto& name : object_names) {
+    object_name_offsets.push_back(strings.size());
+    strings.append(name);
+    strings.push_back('\0');
+  }
+
+  // targets, and where each target's references start
+  std::vector<XrefFileTarget> targets(n_targets);
+  std::vector<uint32_t> fill(n_targets);
+  uint32_t n_refs = 0;
+  for (uint32_t i = 0; i < n_targets; i++) {
+    uint32_t id = sorted[i];
+    targets[i].name = strings.size();
+    targets[i].first_ref = n_refs;
+    fill[id] = n_refs;
+    n_refs += ref_counts[id];
+    strings.append(*target_names[id]);
+    strings.push_back('\0');
+  }
+
+  // references, grouped by target
+  std::vector<XrefLocation> refs(n_refs);
+  size_t ref_idx = 0;
+  for (auto& obj : xrefs) {
+    for (auto& ref : obj.refs) {
+      refs[fill[ref_target_ids[ref_idx++]]++] = ref;
+    }
+  }
+
+  XrefFileHeader header;
+  memcpy(header.magic, "XREF", 4);
+  header.version = XREF_VERSION;
+  header.n_objects = object_names.size();
+  header.n_targets = n_targets;
+  header.n_refs = n_refs;
+  header.string_table_size = strings.size();
+
+  std::vector<uint8_t> result;
+  result.reserve(sizeof(XrefFileHeader) + 4 * object_names.size() +
+                 sizeof(XrefFileTarget) * n_targets + sizeof(XrefLocation) * n_refs +
+                 strings.size());
+  append_pod(result, header);
+  for (auto offset : object_name_offsets) {
+    append_pod(result, offset);
+  }
+  for (auto& target : targets) {
+    append_pod(result, target);
+  }
+  for (auto& ref : refs) {
+    append_pod(result, ref);
+  }
+  result.insert(result.end(), strings.begin(), strings.end());
+  return result;
+}
+
+/*!
+ * Print all references to target from a database file. Returns the number of references.
+ * The file is mapped, so only the part of the reference table for the target is read.
+ */
+int query_xref_database(const std::string& file_name, const std::string& target) {
+  Timer timer;
+  MappedFile file(file_name);
+  const uint8_t* data = file.data();
+  auto bad = [&](const char* what) {
+    return std::runtime_error("Xref database " + file_name + " " + what);
+  };
+
+  XrefFileHeader header;
+  if (file.size() < sizeof(header)) {
+    throw bad("is too small");
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, "XREF", 4) != 0 || header.version != XREF_VERSION) {
+    throw bad("has the wrong format or version");
+  }
+
+  size_t objects_offset = sizeof(XrefFileHeader);
+  size_t targets_offset = objects_offset + 4 * size_t(header.n_objects);
+  size_t refs_offset = targets_offset + sizeof(XrefFileTarget) * header.n_targets;
+  size_t strings_offset = refs_offset + sizeof(XrefLocation) * header.n_refs;
+  if (strings_offset + header.string_table_size != file.size()) {
+    throw bad("has the wrong size");
+  }
+
+  auto get_target = [&](uint32_t idx) {
+    XrefFileTarget result;
+    memcpy(&result, data + targets_offset + idx * sizeof(XrefFileTarget), sizeof(result));
+    return result;
+  };
+  auto get_object_name = [&](uint32_t idx) {
+    uint32_t result;
+    memcpy(&result, data + objects_offset + 4 * idx, sizeof(result));
+    return result;
+  };
+  auto get_string = [&](uint32_t offset) { return (const char*)data + strings_offset + offset; };
+
+  // check all the offsets once, so the lookup below can't go outside the file. The string table
+  // ends in a null, so every string in it is terminated. It's only empty if there are no names.
+  // The references themselves aren't read unless they match.
+  if (header.string_table_size != 0 && data[file.size() - 1] != '\0') {
+    throw bad("has a bad string table");
+  }
+  for (uint32_t i = 0; i < header.n_objects; i++) {
+    if (get_object_name(i) >= header.string_table_size) {
+      throw bad("has a bad object");
+    }
+  }
+  uint32_t prev_first_ref = 0;
+  for (uint32_t i = 0; i < header.n_targets; i++) {
+    auto t = get_target(i);
+    if (t.name >= header.string_table_size || t.first_ref < prev_first_ref ||
+        t.first_ref > header.n_refs) {
+      throw bad("has a bad target");
+    }
+    prev_first_ref = t.first_ref;
+  }
+
+  // binary search for the target
+  uint32_t lo = 0, hi = header.n_targets;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (strcmp(get_string(get_target(mid).name), target.c_str()) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo == header.n_targets || target != get_string(get_target(lo).name)) {
+    printf("No references to %s (%.3f ms)\n", target.c_str(), timer.getMs());
+    return 0;
+  }
+
+  uint32_t first = get_target(lo).first_ref;
+  uint32_t last = lo + 1 < header.n_targets ? get_target(lo + 1).first_ref : header.n_refs;
+  for (uint32_t i = first; i < last; i++) {
+    XrefLocation ref;
+    memcpy(&ref, data + refs_offset + i * sizeof(XrefLocation), sizeof(ref));
+    if (ref.object >= header.n_objects || ref.kind >= XrefKind::MAX_KIND) {
+      throw bad("has a bad reference");
+    }
+    const char* object_name = get_string(get_object_name(ref.object));
+    if (ref.function == -1) {
+      printf("%s seg %d data +0x%x %s\n", object_name, ref.segment, ref.offset,
+             xref_kind_to_charp(ref.kind));
+    } else {
+      printf("%s seg %d fn %d +0x%x %s\n", object_name, ref.segment, ref.function, ref.offset,
+             xref_kind_to_charp(ref.kind));
+    }
+  }
+
+  printf("%d references to %s (%.3f ms)\n", int(last - first), target.c_str(), timer.getMs());
+  return int(last - first);
+}
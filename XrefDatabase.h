@@ -0,0 +1,60 @@
+/*!
+ * @file XrefDatabase.h
+ * A cross-reference database: for every symbol, type and label, where is it referenced?
+ * Built from all object files, then saved to a compact sorted file which can be queried quickly.
+ */
+
+#ifndef JAK_DISASSEMBLER_XREFDATABASE_H
+#define JAK_DISASSEMBLER_XREFDATABASE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class LinkedObjectFile;
+
+enum class XrefKind : uint8_t {
+  SYMBOL,             // pointer to a symbol (SYM_PTR word)
+  SYMBOL_OFFSET,      // offset of a symbol in the symbol table (SYM_OFFSET word or instruction)
+  TYPE,               // pointer to a type (TYPE_PTR word)
+  LABEL,              // pointer to a label (PTR word)
+  LABEL_HI,           // upper 16 bits of a pointer to a label (HI_PTR word)
+  LABEL_LO,           // lower 16 bits of a pointer to a label (LO_PTR word)
+  BRANCH,             // branch to a label
+  INSTRUCTION_LABEL,  // other instruction referring to a label (fp relative addressing)
+  MAX_KIND
+};
+
+const char* xref_kind_to_charp(XrefKind kind);
+
+/*!
+ * The location of a single reference. This is also the format used in the file.
+ */
+struct XrefLocation {
+  uint32_t object = 0;    // index of the object file, in the database's list of objects
+  int32_t function = -1;  // index of the function in the segment, or -1 if not in a function
+  uint32_t offset = 0;    // byte offset in the segment
+  uint8_t segment = 0;
+  XrefKind kind = XrefKind::SYMBOL;
+  uint16_t pad = 0;
+};
+
+static_assert(sizeof(XrefLocation) == 16, "XrefLocation should be 16 bytes");
+
+/*!
+ * The references in a single object file. The names of labels are prefixed with the name of the
+ * object file, so they are unique.
+ */
+struct ObjectXrefs {
+  std::vector<std::string> targets;
+  std::vector<XrefLocation> refs;  // refs[i] references targets[i]
+};
+
+ObjectXrefs find_xrefs(const LinkedObjectFile& file,
+                       uint32_t object_id,
+                       const std::string& object_name);
+std::vector<uint8_t> build_xref_database(const std::vector<std::string>& object_names,
+                                         const std::vector<ObjectXrefs>& xrefs);
+int query_xref_database(const std::string& file_name, const std::string& target);
+
+#endif  // JAK_DISASSEMBLER_XREFDATABASE_H
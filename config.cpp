@@ -23,4 +23,14 @@ void set_config(const std::string& path_to_config_file) {
       cfg.at("disassemble_objects_without_functions").get<bool>();
   gConfig.find_basic_blocks = cfg.at("find_basic_blocks").get<bool>();
   gConfig.write_hex_near_instructions = cfg.at("write_hex_near_instructions").get<bool>();
+  // optional, so old config files still work
+  gConfig.write_xrefs = cfg.value("write_xrefs", false);
+  gConfig.write_call_graph = cfg.value("write_call_graph", false);
+  gConfig.write_binary_export = cfg.value("write_binary_export", false);
+  gConfig.use_io_uring = cfg.value("use_io_uring", false);
+  gConfig.skip_unchanged_outputs = cfg.value("skip_unchanged_outputs", false);
+  gConfig.write_archive = cfg.value("write_archive", false);
+  gConfig.compress_archive = cfg.value("compress_archive", false);
+  gConfig.compress_outputs = cfg.value("compress_outputs", false);
+  gConfig.num_threads = cfg.value("num_threads", 0);
 }
\ No newline at end of file
@@ -14,6 +14,15 @@ struct Config {
   bool disassemble_objects_without_functions = false;
   bool find_basic_blocks = false;
   bool write_hex_near_instructions = false;
+  bool write_xrefs = false;
+  bool write_call_graph = false;
+  bool write_binary_export = false;
+  bool use_io_uring = false;
+  bool skip_unchanged_outputs = false;
+  bool write_archive = false;
+  bool compress_archive = false;
+  bool compress_outputs = false;
+  int num_threads = 0;  // 0 to use all hardware threads
   // ...
 };
 
@@ -1,18 +1,121 @@
 #include <cstdio>
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include "ObjectFileDB.h"
 #include "config.h"
+#include "util/Archive.h"
+#include "util/Compression.h"
 #include "util/FileIO.h"
+#include "util/OutputIndex.h"
+#include "util/PassManager.h"
 #include "TypeSystem/TypeInfo.h"
+#include "XrefDatabase.h"
+#include "CallGraph.h"
+#include "BinaryExport.h"
+
+/*!
+ * List the entries in an archive, print one entry, or extract it to a file.
+ */
+int read_archive(int argc, char** argv) {
+  ArchiveReader reader(argv[0]);
+  if (argc == 1) {
+    for (auto& entry : reader.entries()) {
+      printf("%s.%s %ld bytes (%ld stored)\n", entry.name.c_str(),
+             archive_entry_kind_extension(entry.kind), long(entry.size), long(entry.stored_size));
+    }
+    return 0;
+  }
+
+  int idx = reader.find_entry(argv[1]);
+  if (idx == -1) {
+    printf("%s isn't in the archive\n", argv[1]);
+    return 1;
+  }
+
+  auto text = reader.read_entry(idx);
+  if (argc == 3) {
+    write_binary_file(argv[2], text.data(), text.size());
+  } else {
+    fwrite(text.data(), text.size(), 1, stdout);
+  }
+  return 0;
+}
+
+/*!
+ * Run a command which reads an output file. A bad file or argument prints an error, instead of
+ * aborting. Returns the exit code.
+ */
+template <typename Func>
+int run_command(Func f) {
+  try {
+    return f();
+  } catch (const std::exception& e) {
+    fprintf(stderr, "Error: %s\n", e.what());
+    return 1;
+  }
+}
+
+/*!
+ * Print the DOT graph for a function, and the functions it calls up to depth deep.
+ */
+int print_call_graph(int argc, char** argv) {
+  int depth = 1;
+  if (argc == 3) {
+    char* end = nullptr;
+    long value = strtol(argv[2], &end, 10);
+    if (end == argv[2] || *end != '\0' || value < 0 || value > INT_MAX) {
+      throw std::runtime_error(std::string("Invalid depth ") + argv[2]);
+    }
+    depth = int(value);
+  }
+  auto graph = CallGraph::from_binary(read_binary_file(argv[0]));
+  printf("%s", graph.to_dot(argv[1], depth).c_str());
+  return 0;
+}
 
 int main(int argc, char** argv) {
-  printf("Jak Disassembler\n");
   init_crc();
-  init_opcode_info();
+
+  // like grep, returns 1 if nothing was found.
+  if (argc == 4 && std::string(argv[1]) == "--xref") {
+    return run_command([&] { return query_xref_database(argv[2], argv[3]) > 0 ? 0 : 1; });
+  }
+
+  // prints only the DOT graph, so it can be piped into graphviz.
+  if ((argc == 4 || argc == 5) && std::string(argv[1]) == "--callgraph") {
+    return run_command([&] { return print_call_graph(argc - 2, argv + 2); });
+  }
+
+  if (argc == 3 && std::string(argv[1]) == "--export-info") {
+    return run_command([&] { return print_binary_export_info(argv[2]); });
+  }
+
+  if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--decompress") {
+    auto text = decompress_file(read_binary_file(argv[2]));
+    if (argc == 4) {
+      write_binary_file(argv[3], text.data(), text.size());
+    } else {
+      fwrite(text.data(), text.size(), 1, stdout);
+    }
+    return 0;
+  }
+
+  if (argc >= 3 && argc <= 5 && std::string(argv[1]) == "--archive") {
+    return run_command([&] { return read_archive(argc - 2, argv + 2); });
+  }
+
+  printf("Jak Disassembler\n");
 
   if (argc != 4) {
     printf("usage: jak_disassembler <config_file> <in_folder> <out_folder>\n");
+    printf("       jak_disassembler --xref <xrefs.bin> <symbol, type, or object/label>\n");
+    printf("       jak_disassembler --callgraph <callgraph.bin> <function> [depth]\n");
+    printf("       jak_disassembler --export-info <export.jdx>\n");
+    printf("       jak_disassembler --archive <output.jda> [name.func or name.txt [out_file]]\n");
+    printf("       jak_disassembler --decompress <file.lzo> [out_file]\n");
     return 1;
   }
 
@@ -20,6 +123,10 @@ int main(int argc, char** argv) {
   std::string in_folder = argv[2];
   std::string out_folder = argv[3];
 
+  if (get_config().skip_unchanged_outputs) {
+    get_output_index().load(out_folder);
+  }
+
   std::vector<std::string> dgos;
   for (const auto& dgo_name : get_config().dgo_names) {
     dgos.push_back(combine_path(in_folder, dgo_name));
@@ -28,22 +135,60 @@ int main(int argc, char** argv) {
   ObjectFileDB db(dgos);
   write_text_file(combine_path(out_folder, "dgo.txt"), db.generate_dgo_listing());
 
-  db.process_link_data();
-  db.find_code();
-  db.process_labels();
+  // each pass lists the products it needs and makes. Only passes needed for the outputs enabled in
+  // the config will run.
+  PassManager passes;
+  passes.add_pass("link data", {}, {"link data"}, [&] { db.process_link_data(); });
+  passes.add_pass("find code", {"link data"}, {"code"}, [&] { db.find_code(); });
+  // labels for fp relative addressing are found in code, so all labels need code.
+  passes.add_pass("labels", {"code"}, {"labels"}, [&] { db.process_labels(); });
+  passes.add_pass("scripts", {"labels"}, {"scripts"},
+                  [&] { db.find_and_write_scripts(out_folder); });
+  passes.add_pass("hexdump", {"labels"}, {"hexdump"}, [&] {
+    db.write_object_file_words(out_folder, get_config().write_hexdump_on_v3_only);
+  });
+  passes.add_pass("analyze functions", {"labels"}, {"function names", "function analysis"},
+                  [&] { db.analyze_functions(); });
+  passes.add_pass("find xrefs", {"labels"}, {"cross references"}, [&] { db.find_all_xrefs(); });
+  passes.add_pass("xrefs", {"cross references"}, {"xrefs"}, [&] { db.write_xrefs(out_folder); });
+  passes.add_pass("call graph", {"function names"}, {"call graph"},
+                  [&] { db.write_call_graph(out_folder); });
+  passes.add_pass("binary export", {"function names", "function analysis", "cross references"},
+                  {"binary export"}, [&] { db.write_binary_export(out_folder); });
+  passes.add_pass("disassembly", {"function names", "function analysis"}, {"disassembly"}, [&] {
+    db.write_disassembly(out_folder, get_config().disassemble_objects_without_functions);
+  });
 
   if (get_config().write_scripts) {
-    db.find_and_write_scripts(out_folder);
+    passes.request("scripts");
   }
-
   if (get_config().write_hexdump) {
-    db.write_object_file_words(out_folder, get_config().write_hexdump_on_v3_only);
+    passes.request("hexdump");
+  }
+  if (get_config().write_xrefs) {
+    passes.request("xrefs");
+  }
+  if (get_config().write_call_graph) {
+    passes.request("call graph");
+  }
+  if (get_config().write_binary_export) {
+    passes.request("binary export");
   }
-
-  db.analyze_functions();
-
   if (get_config().write_disassembly) {
-    db.write_disassembly(out_folder, get_config().disassemble_objects_without_functions);
+    passes.request("disassembly");
+  }
+  if (get_config().write_archive) {
+    db.open_archive(combine_path(out_folder, "output.jda"), get_config().compress_archive);
+  }
+  passes.run();
+  db.finish_archive();
+  get_output_index().save();
+
+  if (get_output_index().enabled()) {
+    auto stats = get_output_index().stats();
+    printf("Output files: wrote %d (%.3f MB), skipped %d unchanged (%.3f MB)\n",
+           stats.written_files, stats.written_bytes / ((float)(1u << 20u)), stats.skipped_files,
+           stats.skipped_bytes / ((float)(1u << 20u)));
   }
 
   printf("%s\n", get_type_info().get_summary().c_str());
@@ -0,0 +1,201 @@
+/*!
+ * @file test_archive.cpp
+ * Writes archives and reads them back, then checks that truncated and corrupt archives are
+ * rejected with an exception instead of being trusted. Returns nonzero if a check fails.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "util/Archive.h"
+#include "util/Compression.h"
+#include "util/FileIO.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+const char* ARCHIVE_NAME = "test_archive.jda";
+const char* CORRUPT_NAME = "test_archive_corrupt.jda";
+
+// offsets of fields in the file, see Archive.cpp.
+constexpr size_t HEADER_N_ENTRIES = 8;
+constexpr size_t HEADER_STRING_TABLE_SIZE = 12;
+constexpr size_t HEADER_INDEX_OFFSET = 16;
+constexpr size_t ENTRY_SIZE = 32;
+constexpr size_t ENTRY_NAME = 0;
+constexpr size_t ENTRY_KIND = 4;
+constexpr size_t ENTRY_OFFSET = 8;
+constexpr size_t ENTRY_STORED_SIZE = 16;
+constexpr size_t ENTRY_UNCOMPRESSED_SIZE = 24;
+
+struct TestFile {
+  std::string name;
+  ArchiveEntryKind kind;
+  std::string data;
+};
+
+std::vector<TestFile> test_files() {
+  std::vector<TestFile> files;
+  files.push_back({"first", ArchiveEntryKind::DISASSEMBLY, "(defun first ()\n  (nop!)\n  )\n"});
+  files.push_back({"empty", ArchiveEntryKind::HEXDUMP, ""});
+
+  // bigger than a compressed chunk, and only partly compressible.
+  std::string big;
+  uint32_t x = 1;
+  while (big.size() < 2 * MAX_COMPRESSED_CHUNK_SIZE + 1000) {
+    x = x * 1103515245 + 12345;
+    big += "word " + std::to_string(x >> 20) + "\n";
+  }
+  files.push_back({"big", ArchiveEntryKind::HEXDUMP, big});
+  return files;
+}
+
+void write_archive(const std::string& file_name, bool compress) {
+  ArchiveWriter writer(file_name, compress);
+  for (auto& file : test_files()) {
+    writer.begin_entry(file.name, file.kind);
+    if (compress) {
+      std::string chunks;
+      compress_chunks(file.data.data(), file.data.size(), chunks);
+      writer.append(chunks.data(), chunks.size());
+    } else {
+      // in pieces, like the blocks from the OrderedFileWriter.
+      auto half = file.data.size() / 2;
+      writer.append(file.data.data(), half);
+      writer.append(file.data.data() + half, file.data.size() - half);
+    }
+    writer.end_entry();
+  }
+  writer.finish();
+}
+
+/*!
+ * Read every entry, so all of the archive is checked.
+ */
+void read_all(const std::string& file_name) {
+  ArchiveReader reader(file_name);
+  for (int i = 0; i < int(reader.entries().size()); i++) {
+    reader.read_entry(i);
+  }
+}
+
+bool rejected(const std::string& file_name) {
+  try {
+    read_all(file_name);
+  } catch (std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+template <typename T>
+void patch(std::vector<uint8_t>& data, size_t offset, T value) {
+  memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+T get(const std::vector<uint8_t>& data, size_t offset) {
+  T value;
+  memcpy(&value, data.data() + offset, sizeof(T));
+  return value;
+}
+
+void test_round_trip(bool compress) {
+  write_archive(ARCHIVE_NAME, compress);
+  ArchiveReader reader(ARCHIVE_NAME);
+  auto files = test_files();
+  check(reader.entries().size() == files.size(), "every entry is in the index");
+  for (auto& file : files) {
+    auto extension = archive_entry_kind_extension(file.kind);
+    int idx = reader.find_entry(file.name + "." + extension);
+    check(idx >= 0, "entries can be found by file name");
+    if (idx >= 0) {
+      check(reader.entries().at(idx).compressed == compress, "entries know if they're compressed");
+      check(reader.entries().at(idx).size == file.data.size(), "entries have their size");
+      check(reader.read_entry(idx) == file.data, "entries read back the same");
+    }
+  }
+  check(reader.find_entry("first.txt") == -1, "the kind is part of the name");
+}
+
+/*!
+ * Every way of cutting the archive short is caught by the size check.
+ */
+void test_truncated(bool compress) {
+  write_archive(ARCHIVE_NAME, compress);
+  auto data = read_binary_file(ARCHIVE_NAME);
+  bool all_rejected = true;
+  for (size_t size = 0; size < data.size(); size += size < 256 ? 1 : 997) {
+    write_binary_file(CORRUPT_NAME, data.data(), size);
+    all_rejected = all_rejected && rejected(CORRUPT_NAME);
+  }
+  check(all_rejected, "truncated archives are rejected");
+}
+
+void test_corrupt(bool compress) {
+  write_archive(ARCHIVE_NAME, compress);
+  const auto data = read_binary_file(ARCHIVE_NAME);
+  auto index_offset = get<uint64_t>(data, HEADER_INDEX_OFFSET);
+  auto n_entries = get<uint32_t>(data, HEADER_N_ENTRIES);
+  auto big_entry = index_offset + 2 * ENTRY_SIZE;
+  auto big_stored_size = get<uint64_t>(data, big_entry + ENTRY_STORED_SIZE);
+  check(n_entries == 3, "the header has the entry count");
+
+  auto corrupt = [&](const char* what, size_t offset, auto value) {
+    auto copy = data;
+    patch(copy, offset, value);
+    write_binary_file(CORRUPT_NAME, copy.data(), copy.size());
+    check(rejected(CORRUPT_NAME), what);
+  };
+
+  corrupt("a bad magic is rejected", 0, 'X');
+  corrupt("a huge entry count is rejected", HEADER_N_ENTRIES, uint32_t(0xffffffff));
+  corrupt("a huge string table is rejected", HEADER_STRING_TABLE_SIZE, uint32_t(0xfffffff0));
+  corrupt("an index past the end is rejected", HEADER_INDEX_OFFSET, uint64_t(-1));
+  corrupt("a name past the string table is rejected", index_offset + ENTRY_NAME, uint32_t(1000));
+  corrupt("an unknown kind is rejected", index_offset + ENTRY_KIND, uint8_t(200));
+  corrupt("an entry offset which wraps around is rejected", big_entry + ENTRY_OFFSET,
+          uint64_t(-16));
+  corrupt("an entry past the index is rejected", big_entry + ENTRY_STORED_SIZE,
+          uint64_t(index_offset));
+  corrupt("a huge stored size is rejected", big_entry + ENTRY_STORED_SIZE, uint64_t(-1));
+  corrupt("an entry cut short is rejected", big_entry + ENTRY_STORED_SIZE, big_stored_size - 1);
+  corrupt("a wrong uncompressed size is rejected", big_entry + ENTRY_UNCOMPRESSED_SIZE,
+          uint64_t(1) << 40);
+  corrupt("a string table without a terminator is rejected", data.size() - 1, 'x');
+
+  if (compress) {
+    // the chunk header at the start of the big entry.
+    auto big_offset = get<uint64_t>(data, big_entry + ENTRY_OFFSET);
+    corrupt("a chunk bigger than the limit is rejected", big_offset, uint32_t(0x7fffffff));
+    corrupt("a chunk stored bigger than its size is rejected", big_offset + 4,
+            uint32_t(0xffffffff));
+  }
+}
+}  // namespace
+
+int main() {
+  for (bool compress : {false, true}) {
+    test_round_trip(compress);
+    test_truncated(compress);
+    test_corrupt(compress);
+  }
+  remove(ARCHIVE_NAME);
+  remove(CORRUPT_NAME);
+
+  if (failures) {
+    printf("%d archive checks failed\n", failures);
+    return 1;
+  }
+  printf("archive checks passed\n");
+  return 0;
+}
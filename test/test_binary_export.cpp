@@ -0,0 +1,245 @@
+/*!
+ * @file test_binary_export.cpp
+ * Exports a small hand-made object file and checks the tables read back through a
+ * BinaryExportView, then checks that truncated and corrupt exports are rejected. Returns nonzero
+ * if a check fails.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BinaryExport.h"
+#include "LinkedObjectFile.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// offsets of fields in the file, see BinaryExport.h.
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t HEADER_N_TABLES = 8;
+constexpr size_t DIRECTORY_ENTRY_SIZE = 24;
+constexpr size_t DIRECTORY_TABLE = 0;
+constexpr size_t DIRECTORY_RECORD_SIZE = 4;
+constexpr size_t DIRECTORY_OFFSET = 8;
+constexpr size_t DIRECTORY_COUNT = 16;
+
+size_t directory_entry(ExportTable table) {
+  return HEADER_SIZE + DIRECTORY_ENTRY_SIZE * size_t(table);
+}
+
+InstructionAtom reg_atom(Reg::Gpr r) {
+  InstructionAtom atom;
+  atom.set_reg(Register(Reg::GPR, r));
+  return atom;
+}
+
+InstructionAtom sym_atom(const std::string& name) {
+  InstructionAtom atom;
+  atom.set_sym(name);
+  return atom;
+}
+
+InstructionAtom label_atom(int label) {
+  InstructionAtom atom;
+  atom.set_label(label);
+  return atom;
+}
+
+Instruction make_instr(InstructionKind kind,
+                       std::initializer_list<InstructionAtom> dst,
+                       std::initializer_list<InstructionAtom> src) {
+  Instruction result;
+  result.kind = kind;
+  for (auto atom : dst) {
+    result.add_dst(atom);
+  }
+  for (auto atom : src) {
+    result.add_src(atom);
+  }
+  return result;
+}
+
+/*!
+ * An object with one segment, with a function of three words (a type tag, a load of a symbol and
+ * a branch to a label) in two blocks, then two words of data.
+ */
+LinkedObjectFile make_object(ObjectXrefs& xrefs) {
+  LinkedObjectFile file;
+  file.set_segment_count(1);
+  for (int i = 0; i < 6; i++) {
+    file.push_back_word_to_segment(0, 0);
+  }
+  file.offset_of_data_zone_by_seg.at(0) = 4;
+  int label = file.get_label_id_for(0, 16);
+
+  Function func(0, 4);
+  func.guessed_name = "test-function";
+  func.instructions.emplace_back();  // type tag
+
+  func.instructions.push_back(make_instr(InstructionKind::LW, {reg_atom(Reg::V1)},
+                                         {sym_atom("*active-pool*"), reg_atom(Reg::S7)}));
+  func.instructions.push_back(make_instr(
+      InstructionKind::BEQ, {}, {reg_atom(Reg::V1), reg_atom(Reg::R0), label_atom(label)}));
+
+  auto& cfg = func.cfg;
+  cfg.blocks.emplace_back(1, 3);
+  cfg.blocks.emplace_back(3, 4);
+  cfg.entry = 0;
+  cfg.exits.push_back(1);
+  cfg.succ_offsets = {0, 2, 2};
+  cfg.succ_edges = {{1, EdgeKind::FALLTHROUGH}, {1, EdgeKind::TAKEN}};
+  cfg.pred_offsets = {0, 0, 2};
+  cfg.pred_edges = {{0, EdgeKind::FALLTHROUGH}, {0, EdgeKind::TAKEN}};
+  file.functions_by_seg.at(0).push_back(func);
+
+  XrefLocation ref;
+  ref.function = 0;
+  ref.offset = 4;
+  ref.kind = XrefKind::SYMBOL_OFFSET;
+  xrefs.targets.push_back("*active-pool*");
+  xrefs.refs.push_back(ref);
+  // labels aren't exported as symbol references.
+  ref.offset = 8;
+  ref.kind = XrefKind::BRANCH;
+  xrefs.targets.push_back("test-object-L0");
+  xrefs.refs.push_back(ref);
+  return file;
+}
+
+std::vector<uint8_t> make_export() {
+  BinaryExportBuilder builder;
+  ObjectXrefs xrefs;
+  auto file = make_object(xrefs);
+  builder.add_object("empty-object", LinkedObjectFile(), ObjectXrefs());
+  builder.add_object("test-object", file, xrefs);
+  check(builder.instruction_count() == 3, "the builder counts instructions");
+  return builder.to_binary();
+}
+
+bool rejected(const std::vector<uint8_t>& data, size_t size) {
+  try {
+    BinaryExportView view(data.data(), size);
+  } catch (std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+void test_round_trip() {
+  auto data = make_export();
+  BinaryExportView view(data.data(), data.size());
+  check(view.count(ExportTable::OBJECTS) == 2, "every object is exported");
+  check(view.count(ExportTable::SEGMENTS) == 1, "every segment is exported");
+  check(view.count(ExportTable::FUNCTIONS) == 1, "every function is exported");
+  check(view.count(ExportTable::INSTRUCTIONS) == 3, "every instruction is exported");
+  check(view.count(ExportTable::BLOCKS) == 2, "every block is exported");
+  check(view.count(ExportTable::EDGES) == 2, "every edge is exported");
+  check(view.count(ExportTable::LABELS) == 1, "every label is exported");
+  check(view.count(ExportTable::SYMBOL_REFS) == 1, "only symbols are exported as symbol refs");
+  check(view.count(ExportTable::OPCODES) == (int)InstructionKind::EE_OP_MAX,
+        "every opcode is exported");
+  if (failures) {
+    return;
+  }
+
+  auto objects = view.table<ExportObject>(ExportTable::OBJECTS);
+  check(!strcmp(view.string(objects[0].name), "empty-object"), "objects have names");
+  check(objects[0].n_segments == 0 && objects[1].first_segment == 0 && objects[1].n_segments == 1,
+        "objects have their segments");
+  check(objects[1].first_label == 0 && objects[1].n_labels == 1, "objects have their labels");
+
+  auto segment = view.table<ExportSegment>(ExportTable::SEGMENTS)[0];
+  check(segment.object == 1 && segment.n_words == 6 && segment.data_start_word == 4,
+        "segments have their words");
+  check(segment.first_function == 0 && segment.n_functions == 1, "segments have their functions");
+
+  auto function = view.table<ExportFunction>(ExportTable::FUNCTIONS)[0];
+  check(!strcmp(view.string(function.name), "test-function"), "functions have names");
+  check(function.segment == 0 && function.start_word == 0 && function.end_word == 4,
+        "functions have their location");
+  check(function.first_block == 0 && function.n_blocks == 2, "functions have their blocks");
+
+  auto instructions = view.table<ExportInstruction>(ExportTable::INSTRUCTIONS);
+  auto& load = instructions[1];
+  check(load.kind == (int)InstructionKind::LW && load.n_dst == 1 && load.n_src == 2,
+        "instructions have their kind and operands");
+  check(load.operands[1].kind == InstructionAtom::IMM_SYM &&
+            !strcmp(view.string(load.operands[1].value), "*active-pool*"),
+        "symbol operands are strings");
+  check(load.operands[2].kind == InstructionAtom::REGISTER &&
+            load.operands[2].reg == Register(Reg::GPR, Reg::S7).get_id(),
+        "register operands have the register");
+  auto& branch = instructions[2];
+  check(branch.operands[2].kind == InstructionAtom::LABEL && branch.operands[2].value == 0,
+        "label operands index the label table");
+  auto opcodes = view.table<ExportOpcode>(ExportTable::OPCODES);
+  check(!strcmp(view.string(opcodes[load.kind].name), "lw"), "opcodes have names");
+
+  auto blocks = view.table<ExportBlock>(ExportTable::BLOCKS);
+  auto edges = view.table<ExportEdge>(ExportTable::EDGES);
+  check(blocks[0].n_edges == 2 && blocks[1].n_edges == 0, "blocks have their successors");
+  check(edges[1].block == 1 && edges[1].kind == uint8_t(EdgeKind::TAKEN), "edges have a kind");
+
+  auto label = view.table<ExportLabel>(ExportTable::LABELS)[0];
+  check(label.object == 1 && label.segment == 0 && label.offset == 16, "labels have a target");
+
+  auto ref = view.table<ExportSymbolRef>(ExportTable::SYMBOL_REFS)[0];
+  check(!strcmp(view.string(ref.symbol), "*active-pool*") && ref.segment == 0 &&
+            ref.function == 0 && ref.offset == 4,
+        "symbol refs have a location");
+}
+
+void test_truncated() {
+  auto data = make_export();
+  bool all_rejected = true;
+  for (size_t size = 0; size < data.size(); size++) {
+    all_rejected = all_rejected && rejected(data, size);
+  }
+  check(all_rejected, "truncated exports are rejected");
+}
+
+void test_corrupt() {
+  const auto data = make_export();
+  auto corrupt = [&](const char* what, size_t offset, auto value) {
+    auto copy = data;
+    memcpy(copy.data() + offset, &value, sizeof(value));
+    check(rejected(copy, copy.size()), what);
+  };
+
+  auto functions = directory_entry(ExportTable::FUNCTIONS);
+  auto strings = directory_entry(ExportTable::STRINGS);
+  corrupt("a bad magic is rejected", 0, 'X');
+  corrupt("a wrong table count is rejected", HEADER_N_TABLES, uint32_t(3));
+  corrupt("tables out of order are rejected", functions + DIRECTORY_TABLE, uint32_t(0));
+  corrupt("a wrong record size is rejected", functions + DIRECTORY_RECORD_SIZE, uint32_t(1));
+  corrupt("an unaligned table is rejected", functions + DIRECTORY_OFFSET, uint64_t(72));
+  corrupt("a table past the end is rejected", functions + DIRECTORY_OFFSET,
+          uint64_t((data.size() + 31) & ~15));
+  corrupt("a table which wraps around is rejected", functions + DIRECTORY_OFFSET, uint64_t(-16));
+  corrupt("too many records are rejected", functions + DIRECTORY_COUNT, uint64_t(1) << 60);
+  corrupt("an empty string table is rejected", strings + DIRECTORY_COUNT, uint64_t(0));
+  corrupt("a string table without a terminator is rejected", data.size() - 1, 'x');
+}
+}  // namespace
+
+int main() {
+  test_round_trip();
+  test_truncated();
+  test_corrupt();
+  if (failures) {
+    printf("%d binary export checks failed\n", failures);
+    return 1;
+  }
+  printf("binary export checks passed\n");
+  return 0;
+}
@@ -0,0 +1,154 @@
+/*!
+ * @file test_call_graph.cpp
+ * Builds a small call graph, round trips it through the binary format, and checks that truncated
+ * and corrupt call graph files are rejected with an exception instead of being trusted. Returns
+ * nonzero if a check fails.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "CallGraph.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// offsets of fields in the file, see CallGraph.cpp.
+constexpr size_t HEADER_SIZE = 24;
+constexpr size_t HEADER_N_NODES = 8;
+constexpr size_t HEADER_N_FUNCTIONS = 12;
+constexpr size_t HEADER_N_EDGES = 16;
+constexpr size_t HEADER_STRING_TABLE_SIZE = 20;
+constexpr size_t NODE_SIZE = 16;
+constexpr size_t NODE_NAME = 0;
+constexpr size_t NODE_OBJECT = 4;
+
+constexpr int N_NODES = 5;
+
+/*!
+ * Nodes are foo, an unnamed function and the top level in obj-a, bar in obj-b, then print, which
+ * isn't defined. foo calls bar (twice) and print, the unnamed function calls foo, and bar calls
+ * foo and print.
+ */
+CallGraph make_graph() {
+  std::vector<CallGraph::FunctionInfo> functions = {{"foo", "obj-a", 0, 0},
+                                                    {"", "obj-a", 0, 1},
+                                                    {"(top-level-init)", "obj-a", 1, 0},
+                                                    {"bar", "obj-b", 1, 0}};
+  std::vector<ObjectCalls> calls(2);
+  calls[0].callers = {0, 0, 0, 1};
+  calls[0].callee_symbols = {"bar", "print", "bar", "foo"};
+  calls[1].callers = {0, 0};
+  calls[1].callee_symbols = {"foo", "print"};
+  return CallGraph::build(functions, {0, 3}, calls);
+}
+
+bool rejected(const std::vector<uint8_t>& data) {
+  try {
+    CallGraph::from_binary(data);
+  } catch (std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+bool contains(const std::string& str, const char* part) {
+  return str.find(part) != std::string::npos;
+}
+
+void test_round_trip() {
+  auto graph = make_graph();
+  check(graph.node_count() == N_NODES, "undefined callees get a node");
+  check(graph.function_count() == 4, "every function has a node");
+  check(graph.edge_count() == 5, "duplicate calls are one edge");
+  check(!strcmp(graph.node_name(4), "print") && !strcmp(graph.node_object(4), ""),
+        "undefined callees have no object");
+
+  auto data = graph.to_binary();
+  auto loaded = CallGraph::from_binary(data);
+  check(loaded.to_binary() == data, "the graph reads back the same");
+  check(loaded.node_count() == N_NODES && loaded.edge_count() == 5 &&
+            loaded.function_count() == 4,
+        "the graph reads back the same size");
+  check(!strcmp(loaded.node_name(3), "bar") && !strcmp(loaded.node_object(3), "obj-b"),
+        "nodes read back with their names");
+
+  auto dot = loaded.to_dot("foo", 1);
+  check(dot == graph.to_dot("obj-a/foo", 1), "roots can be named with their object");
+  check(contains(dot, "n0 [label=\"foo\\nobj-a\", style=bold];"), "the root is bold");
+  check(contains(dot, "n1 [label=\"obj-a seg 0 fn 1\"];"), "unnamed functions have a location");
+  check(contains(dot, "n4 [label=\"print\", style=dashed];"), "undefined callees are dashed");
+  check(contains(dot, "n0 -> n3;") && contains(dot, "n0 -> n4;"), "callees are included");
+  check(contains(dot, "n1 -> n0;") && contains(dot, "n3 -> n0;"), "callers are included");
+  check(!contains(dot, "n3 -> n4;"), "calls past the depth aren't included");
+  check(!contains(dot, "n2 "), "unrelated functions aren't included");
+  check(contains(loaded.to_dot("foo", 2), "n3 -> n4;"), "a bigger depth goes further");
+
+  bool threw = false;
+  try {
+    loaded.to_dot("(top-level-init)-x", 1);
+  } catch (std::runtime_error&) {
+    threw = true;
+  }
+  check(threw, "an unknown root is an error");
+}
+
+/*!
+ * Every way of cutting the file short is caught by the size check.
+ */
+void test_truncated() {
+  auto data = make_graph().to_binary();
+  bool all_rejected = true;
+  for (size_t size = 0; size < data.size(); size++) {
+    all_rejected = all_rejected && rejected({data.begin(), data.begin() + size});
+  }
+  check(all_rejected, "truncated call graphs are rejected");
+}
+
+void test_corrupt() {
+  const auto data = make_graph().to_binary();
+  auto offsets_offset = HEADER_SIZE + NODE_SIZE * N_NODES;
+  auto edges_offset = offsets_offset + 4 * (N_NODES + 1);
+  auto corrupt = [&](const char* what, size_t offset, auto value) {
+    auto copy = data;
+    memcpy(copy.data() + offset, &value, sizeof(value));
+    check(rejected(copy), what);
+  };
+
+  corrupt("a bad magic is rejected", 0, 'X');
+  corrupt("a huge node count is rejected", HEADER_N_NODES, uint32_t(0xffffffff));
+  corrupt("more functions than nodes are rejected", HEADER_N_FUNCTIONS, uint32_t(N_NODES + 1));
+  corrupt("a huge edge count is rejected", HEADER_N_EDGES, uint32_t(0x40000000));
+  corrupt("a wrong string table size is rejected", HEADER_STRING_TABLE_SIZE, uint32_t(-4));
+  corrupt("a name past the string table is rejected", HEADER_SIZE + NODE_NAME, uint32_t(1000));
+  corrupt("an object past the string table is rejected", HEADER_SIZE + NODE_OBJECT,
+          uint32_t(1000));
+  corrupt("edge offsets which go backwards are rejected", offsets_offset + 4, uint32_t(4));
+  corrupt("edge offsets which don't start at 0 are rejected", offsets_offset, uint32_t(1));
+  corrupt("edge offsets which don't end at the edge count are rejected",
+          offsets_offset + 4 * N_NODES, uint32_t(4));
+  corrupt("an edge to a node which doesn't exist is rejected", edges_offset, uint32_t(N_NODES));
+  corrupt("a string table without a terminator is rejected", data.size() - 1, 'x');
+}
+}  // namespace
+
+int main() {
+  test_round_trip();
+  test_truncated();
+  test_corrupt();
+  if (failures) {
+    printf("%d call graph checks failed\n", failures);
+    return 1;
+  }
+  printf("call graph checks passed\n");
+  return 0;
+}
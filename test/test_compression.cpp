@@ -0,0 +1,192 @@
+/*!
+ * @file test_compression.cpp
+ * Compresses data of different sizes into LZO chunks and back, then checks that truncated and
+ * corrupt compressed files are rejected with an exception instead of being trusted. Returns
+ * nonzero if a check fails.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "util/Compression.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// offsets of fields in a chunk header, see Compression.cpp.
+constexpr size_t CHUNK_HEADER_SIZE = 8;
+constexpr size_t CHUNK_SIZE = 0;
+constexpr size_t CHUNK_STORED_SIZE = 4;
+
+/*!
+ * Text like the disassembly, which compresses well.
+ */
+std::string make_text(size_t size) {
+  std::string result;
+  uint32_t x = 1;
+  while (result.size() < size) {
+    x = x * 1103515245 + 12345;
+    result += "    daddiu sp, sp, " + std::to_string(x >> 26) + "\n";
+  }
+  result.resize(size);
+  return result;
+}
+
+/*!
+ * Bytes which don't compress, so are stored as is.
+ */
+std::string make_noise(size_t size) {
+  std::string result;
+  uint64_t x = 88172645463325252ull;
+  while (result.size() < size) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    result.push_back(char(x >> 32));
+  }
+  return result;
+}
+
+std::vector<uint8_t> make_file(const std::string& data) {
+  auto file = compressed_file_header();
+  compress_chunks(data.data(), data.size(), file);
+  return {file.begin(), file.end()};
+}
+
+bool rejected(const std::vector<uint8_t>& file) {
+  try {
+    decompress_file(file);
+  } catch (std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+uint32_t get_u32(const std::vector<uint8_t>& data, size_t offset) {
+  uint32_t value;
+  memcpy(&value, data.data() + offset, sizeof(value));
+  return value;
+}
+
+void test_round_trip() {
+  const size_t sizes[] = {0,
+                          1,
+                          100,
+                          MAX_COMPRESSED_CHUNK_SIZE - 1,
+                          MAX_COMPRESSED_CHUNK_SIZE,
+                          MAX_COMPRESSED_CHUNK_SIZE + 1,
+                          3 * MAX_COMPRESSED_CHUNK_SIZE + 12345};
+  bool text_ok = true, noise_ok = true, sizes_ok = true;
+  for (auto size : sizes) {
+    auto text = make_text(size);
+    auto noise = make_noise(size);
+    text_ok = text_ok && decompress_file(make_file(text)) == text;
+    noise_ok = noise_ok && decompress_file(make_file(noise)) == noise;
+
+    std::string chunks;
+    compress_chunks(text.data(), text.size(), chunks);
+    sizes_ok = sizes_ok && chunks_uncompressed_size(chunks.data(), chunks.size()) == size;
+  }
+  check(text_ok, "text reads back the same");
+  check(noise_ok, "incompressible data reads back the same");
+  check(sizes_ok, "the uncompressed size is found from the chunk headers");
+
+  // noise is stored as is, and text is compressed.
+  auto noise = make_file(make_noise(1000));
+  check(get_u32(noise, COMPRESSED_FILE_HEADER_SIZE + CHUNK_STORED_SIZE) == 1000,
+        "incompressible chunks are stored as is");
+  auto text = make_file(make_text(1000));
+  check(get_u32(text, COMPRESSED_FILE_HEADER_SIZE + CHUNK_STORED_SIZE) < 500,
+        "text is compressed");
+
+  // parts compressed separately, like the blocks of a file compressed on different threads.
+  auto first = make_text(MAX_COMPRESSED_CHUNK_SIZE + 10);
+  auto second = make_noise(5000);
+  std::string chunks;
+  compress_chunks(first.data(), first.size(), chunks);
+  compress_chunks(second.data(), second.size(), chunks);
+  std::string result = "prefix";
+  check(decompress_chunks(chunks.data(), chunks.size(), result) == first.size() + second.size(),
+        "decompress_chunks returns the size added");
+  check(result == "prefix" + first + second, "separately compressed parts can be concatenated");
+}
+
+/*!
+ * The file is only valid if it's cut at the end of a chunk, otherwise it's rejected.
+ */
+void test_truncated() {
+  auto file = make_file(make_text(2 * MAX_COMPRESSED_CHUNK_SIZE + 100));
+  std::vector<size_t> chunk_ends = {COMPRESSED_FILE_HEADER_SIZE};
+  while (chunk_ends.back() < file.size()) {
+    auto stored_size = get_u32(file, chunk_ends.back() + CHUNK_STORED_SIZE);
+    chunk_ends.push_back(chunk_ends.back() + CHUNK_HEADER_SIZE + stored_size);
+  }
+  check(chunk_ends.size() == 4 && chunk_ends.back() == file.size(), "the file has three chunks");
+
+  bool all_rejected = true;
+  for (size_t size = 0; size < file.size(); size += size < chunk_ends[1] + 64 ? 1 : 61) {
+    bool whole_chunks = false;
+    for (auto end : chunk_ends) {
+      whole_chunks = whole_chunks || end == size;
+    }
+    if (!whole_chunks) {
+      all_rejected = all_rejected && rejected({file.begin(), file.begin() + size});
+    }
+  }
+  check(all_rejected, "truncated files are rejected");
+}
+
+void test_corrupt() {
+  const auto file = make_file(make_text(MAX_COMPRESSED_CHUNK_SIZE + 100));
+  const auto chunk = COMPRESSED_FILE_HEADER_SIZE;
+  const auto size = get_u32(file, chunk + CHUNK_SIZE);
+  const auto stored_size = get_u32(file, chunk + CHUNK_STORED_SIZE);
+  auto corrupt = [&](const char* what, size_t offset, uint32_t value) {
+    auto copy = file;
+    memcpy(copy.data() + offset, &value, sizeof(value));
+    check(rejected(copy), what);
+  };
+
+  corrupt("a bad magic is rejected", 0, 0);
+  corrupt("a wrong version is rejected", 4, COMPRESSED_FILE_VERSION + 1);
+  corrupt("a chunk bigger than the limit is rejected", chunk + CHUNK_SIZE,
+          MAX_COMPRESSED_CHUNK_SIZE + 1);
+  corrupt("a chunk stored bigger than its size is rejected", chunk + CHUNK_STORED_SIZE, size + 1);
+  corrupt("a chunk past the end of the file is rejected", chunk + CHUNK_STORED_SIZE,
+          uint32_t(file.size()));
+  corrupt("a chunk which decompresses to more than its size is rejected", chunk + CHUNK_SIZE,
+          size - 1);
+  corrupt("a chunk which decompresses to less than its size is rejected", chunk + CHUNK_STORED_SIZE,
+          stored_size - 1);
+
+  auto chunks = (const char*)file.data() + chunk;
+  bool threw = false;
+  try {
+    chunks_uncompressed_size(chunks, stored_size + CHUNK_HEADER_SIZE - 1);
+  } catch (std::runtime_error&) {
+    threw = true;
+  }
+  check(threw, "the uncompressed size of a truncated chunk is an error");
+}
+}  // namespace
+
+int main() {
+  test_round_trip();
+  test_truncated();
+  test_corrupt();
+  if (failures) {
+    printf("%d compression checks failed\n", failures);
+    return 1;
+  }
+  printf("compression checks passed\n");
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*!
+ * @file test_liveness.cpp
+ * Checks register liveness on small hand-made functions. Returns nonzero if a check fails.
+ */
+
+#include <cstdio>
+#include <initializer_list>
+#include <vector>
+#include "Function/Function.h"
+#include "Function/Liveness.h"
+#include "LinkedObjectFile.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+Register gpr(Reg::Gpr r) {
+  return Register(Reg::GPR, r);
+}
+
+InstructionAtom reg_atom(Reg::Gpr r) {
+  InstructionAtom atom;
+  atom.set_reg(gpr(r));
+  return atom;
+}
+
+InstructionAtom imm_atom(int32_t value) {
+  InstructionAtom atom;
+  atom.set_imm(value);
+  return atom;
+}
+
+Instruction make_instr(InstructionKind kind,
+                       std::initializer_list<InstructionAtom> dst,
+                       std::initializer_list<InstructionAtom> src) {
+  Instruction result;
+  result.kind = kind;
+  for (auto atom : dst) {
+    result.add_dst(atom);
+  }
+  for (auto atom : src) {
+    result.add_src(atom);
+  }
+  return result;
+}
+
+/*!
+ * Make a function from instructions, with blocks which fall through to the next, and a type tag
+ * as the first word.
+ */
+Function make_function(const std::vector<Instruction>& instructions,
+                       const std::vector<int>& block_starts) {
+  Function func(0, int(instructions.size()) + 1);
+  func.instructions.emplace_back();  // type tag
+  func.instructions.insert(func.instructions.end(), instructions.begin(), instructions.end());
+
+  auto& cfg = func.cfg;
+  for (size_t b = 0; b < block_starts.size(); b++) {
+    int end = b + 1 < block_starts.size() ? block_starts[b + 1] : int(func.instructions.size());
+    cfg.blocks.emplace_back(block_starts[b], end);
+  }
+  int n_blocks = cfg.block_count();
+  cfg.entry = 0;
+  cfg.exits.push_back(n_blocks - 1);
+  for (int b = 0; b < n_blocks; b++) {
+    cfg.succ_offsets.push_back(int(cfg.succ_edges.size()));
+    if (b + 1 < n_blocks) {
+      cfg.succ_edges.push_back({b + 1, EdgeKind::FALLTHROUGH});
+    }
+    cfg.pred_offsets.push_back(int(cfg.pred_edges.size()));
+    if (b > 0) {
+      cfg.pred_edges.push_back({b - 1, EdgeKind::FALLTHROUGH});
+    }
+  }
+  cfg.succ_offsets.push_back(int(cfg.succ_edges.size()));
+  cfg.pred_offsets.push_back(int(cfg.pred_edges.size()));
+  return func;
+}
+
+/*!
+ * A function which saves s0, uses it as a temporary, and restores it. s0 isn't live after its last
+ * use, even though analyze_prologue has removed the prologue and epilogue from the blocks.
+ */
+void test_saved_register_as_temp() {
+  typedef InstructionKind IK;
+  auto func = make_function(
+      {
+          make_instr(IK::DADDIU, {reg_atom(Reg::SP)}, {reg_atom(Reg::SP), imm_atom(-16)}),  // 1
+          make_instr(IK::SQ, {}, {reg_atom(Reg::S0), imm_atom(0), reg_atom(Reg::SP)}),      // 2
+          make_instr(IK::DADDIU, {reg_atom(Reg::S0)}, {reg_atom(Reg::A0), imm_atom(1)}),    // 3
+          make_instr(IK::DADDU, {reg_atom(Reg::V0)}, {reg_atom(Reg::S0), reg_atom(Reg::R0)}),
+          make_instr(IK::LQ, {reg_atom(Reg::S0)}, {imm_atom(0), reg_atom(Reg::SP)}),  // 5
+          make_instr(IK::JR, {}, {reg_atom(Reg::RA)}),
+          make_instr(IK::DADDIU, {reg_atom(Reg::SP)}, {reg_atom(Reg::SP), imm_atom(16)}),
+      },
+      {0, 5});
+
+  // like analyze_prologue.
+  func.prologue_end = 3;
+  func.epilogue_start = 5;
+  func.cfg.blocks.front().start_word = func.prologue_end;
+  func.cfg.blocks.back().end_word = func.epilogue_start;
+
+  auto liveness = find_liveness(func);
+  check(!liveness.live_out[0].contains(gpr(Reg::S0)), "s0 is dead after its last use");
+  check(liveness.live_out[0].contains(gpr(Reg::V0)), "v0 is live until the return");
+  check(liveness.live_in[0].contains(gpr(Reg::S0)), "s0 is live at entry, to be saved");
+  check(!liveness.live_in[1].contains(gpr(Reg::S0)), "s0 is restored by the epilogue");
+}
+
+/*!
+ * A call uses the arguments, even the one set up in the delay slot, and defines v0.
+ */
+void test_call() {
+  typedef InstructionKind IK;
+  auto func = make_function(
+      {
+          make_instr(IK::DADDU, {reg_atom(Reg::A0)}, {reg_atom(Reg::S1), reg_atom(Reg::R0)}),  // 1
+          make_instr(IK::JALR, {reg_atom(Reg::RA)}, {reg_atom(Reg::T9)}),
+          make_instr(IK::DADDU, {reg_atom(Reg::A1)}, {reg_atom(Reg::S2), reg_atom(Reg::R0)}),
+          make_instr(IK::DADDU, {reg_atom(Reg::V1)}, {reg_atom(Reg::V0), reg_atom(Reg::S3)}),  // 4
+          make_instr(IK::DADDU, {reg_atom(Reg::V0)}, {reg_atom(Reg::V1), reg_atom(Reg::T4)}),
+      },
+      {0, 4});
+
+  auto liveness = find_liveness(func);
+  check(liveness.use[0].contains(gpr(Reg::S1)), "the first argument is set up from s1");
+  check(liveness.use[0].contains(gpr(Reg::S2)), "the delay slot sets up the second argument");
+  check(!liveness.live_in[0].contains(gpr(Reg::A0)), "a0 is defined before the call");
+  check(!liveness.live_in[0].contains(gpr(Reg::A1)), "a1 is defined in the delay slot");
+  check(liveness.live_in[0].contains(gpr(Reg::T9)), "the function called is used");
+  check(liveness.live_in[0].contains(gpr(Reg::A2)), "later arguments are used by the call");
+  check(!liveness.live_in[0].contains(gpr(Reg::V0)), "v0 is defined by the call");
+  check(liveness.live_in[1].contains(gpr(Reg::V0)), "the return value is used after the call");
+  check(liveness.def[0].contains(gpr(Reg::T4)), "temporaries are clobbered by the call");
+  check(!liveness.live_in[0].contains(gpr(Reg::T4)), "t4 is clobbered before it's used");
+  check(liveness.live_in[0].contains(gpr(Reg::S3)), "saved registers survive the call");
+}
+
+/*!
+ * Functions with no instructions, or only a type tag, get through every pass.
+ */
+void test_empty_functions() {
+  LinkedObjectFile file;
+  file.set_segment_count(1);
+
+  Function empty(0, 0);
+  empty.cfg = find_blocks_in_function(file, 0, empty);
+  check(empty.cfg.block_count() == 0 && empty.cfg.entry == -1, "no instructions means no blocks");
+  empty.dominators = find_dominators(empty.cfg);
+  empty.loops = find_loops(empty.cfg, empty.dominators);
+  empty.analyze_prologue(file);
+  empty.liveness = find_liveness(empty);
+  check(empty.loops.loops.empty() && empty.liveness.live_in.empty(),
+        "a function with no blocks has no loops or liveness");
+
+  Function tag_only(0, 1);
+  tag_only.instructions.emplace_back();
+  tag_only.cfg = find_blocks_in_function(file, 0, tag_only);
+  check(tag_only.cfg.block_count() == 1 && tag_only.cfg.entry == 0, "the type tag is a block");
+  tag_only.dominators = find_dominators(tag_only.cfg);
+  tag_only.loops = find_loops(tag_only.cfg, tag_only.dominators);
+  tag_only.analyze_prologue(file);
+  tag_only.liveness = find_liveness(tag_only);
+  check(tag_only.dominators.reachable(0) && tag_only.liveness.live_in.size() == 1,
+        "a function with only a type tag has one block");
+  check(!tag_only.prologue.decoded, "a function with only a type tag has no prologue");
+}
+}  // namespace
+
+int main() {
+  test_saved_register_as_temp();
+  test_call();
+  test_empty_functions();
+  if (failures) {
+    printf("%d liveness checks failed\n", failures);
+    return 1;
+  }
+  printf("liveness checks passed\n");
+  return 0;
+}
@@ -0,0 +1,220 @@
+/*!
+ * @file test_ordered_file_writer.cpp
+ * Writes files from several threads through an OrderedFileWriter with a small queue, and checks
+ * that they're created in order with their blocks in order, that blocks held by the output stay
+ * bounded, and that errors reach the producers. Returns nonzero if a check fails.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "util/OrderedFileWriter.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+constexpr int N_FILES = 40;
+constexpr int N_THREADS = 4;
+constexpr int MAX_QUEUED = 4;
+
+/*!
+ * Keeps files in memory. Like the archive output, only one file is written at a time, and blocks
+ * for later files are held until the files before them are closed. Used only by the writer thread,
+ * and checked after it's done.
+ */
+class RecordingFileOutput : public FileOutput {
+ public:
+  const char* name() const override { return "recording"; }
+
+  void open(int file, const std::string& file_name) override {
+    opened.push_back(file_name);
+    m_pending[file];
+    if (m_current == -1) {
+      next_file();
+    }
+  }
+
+  void write(int file, std::string&& block) override {
+    if (file == m_current) {
+      contents[file] += block;
+    } else {
+      m_pending.at(file).blocks.push_back(std::move(block));
+      m_held++;
+      max_held = std::max(max_held, m_held);
+    }
+  }
+
+  void close(int file) override {
+    if (file == m_current) {
+      closed.push_back(file);
+      m_current = -1;
+      next_file();
+    } else {
+      m_pending.at(file).closed = true;
+    }
+  }
+
+  size_t blocks_held() const override { return m_held; }
+
+  std::vector<std::string> opened;
+  std::vector<int> closed;
+  std::map<int, std::string> contents;
+  size_t max_held = 0;
+
+ private:
+  struct Pending {
+    std::vector<std::string> blocks;
+    bool closed = false;
+  };
+
+  void next_file() {
+    while (m_current == -1 && !m_pending.empty()) {
+      auto it = m_pending.begin();
+      m_current = it->first;
+      for (auto& block : it->second.blocks) {
+        contents[m_current] += block;
+      }
+      m_held -= it->second.blocks.size();
+      if (it->second.closed) {
+        closed.push_back(m_current);
+        m_current = -1;
+      }
+      m_pending.erase(it);
+    }
+  }
+
+  std::map<int, Pending> m_pending;
+  int m_current = -1;
+  size_t m_held = 0;
+};
+
+/*!
+ * Fails to create one of the files.
+ */
+class FailingFileOutput : public FileOutput {
+ public:
+  const char* name() const override { return "failing"; }
+  void open(int file, const std::string&) override {
+    if (file == 3) {
+      throw std::runtime_error("Failed to open file");
+    }
+  }
+  void write(int, std::string&&) override {}
+  void close(int) override {}
+};
+
+std::vector<std::string> file_names() {
+  std::vector<std::string> result;
+  for (int i = 0; i < N_FILES; i++) {
+    result.push_back("file-" + std::to_string(i));
+  }
+  return result;
+}
+
+/*!
+ * Later files have more blocks, so the threads get out of step.
+ */
+int block_count(int file) {
+  return 1 + file % 7;
+}
+
+std::string block_text(int file, int block) {
+  return std::to_string(file) + ":" + std::to_string(block) + "\n";
+}
+
+/*!
+ * Each thread takes every N_THREADS-th file, in increasing order, like the object file printers.
+ */
+void produce(OrderedFileWriter& writer, int thread, bool* ok) {
+  *ok = true;
+  for (int file = thread; file < N_FILES; file += N_THREADS) {
+    for (int block = 0; block < block_count(file); block++) {
+      *ok = *ok && writer.write_block(file, block_text(file, block));
+    }
+    *ok = *ok && writer.close_file(file);
+  }
+}
+
+void test_ordering() {
+  auto output = std::make_unique<RecordingFileOutput>();
+  auto& recording = *output;
+  OrderedFileWriter writer(file_names(), MAX_QUEUED, std::move(output));
+  std::vector<std::thread> threads;
+  bool ok[N_THREADS];
+  for (int i = 0; i < N_THREADS; i++) {
+    threads.emplace_back(produce, std::ref(writer), i, &ok[i]);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  writer.finish();
+
+  bool all_ok = true;
+  for (bool thread_ok : ok) {
+    all_ok = all_ok && thread_ok;
+  }
+  check(all_ok, "blocks are accepted");
+  check(recording.opened == file_names(), "files are created in order");
+
+  std::vector<int> expected_closed;
+  bool contents_ok = true;
+  size_t bytes = 0;
+  for (int file = 0; file < N_FILES; file++) {
+    expected_closed.push_back(file);
+    std::string expected;
+    for (int block = 0; block < block_count(file); block++) {
+      expected += block_text(file, block);
+    }
+    contents_ok = contents_ok && recording.contents[file] == expected;
+    bytes += expected.size();
+  }
+  check(recording.closed == expected_closed, "files are closed in order");
+  check(contents_ok, "blocks are written in order");
+  // the writer finds out what the output holds after each write, so the block being written can
+  // be one more.
+  check(recording.max_held <= MAX_QUEUED + 1, "blocks held by the output are bounded");
+  check(writer.files_written() == N_FILES && writer.bytes_written() == bytes,
+        "the writer counts what it wrote");
+}
+
+void test_failure() {
+  OrderedFileWriter writer(file_names(), MAX_QUEUED, std::make_unique<FailingFileOutput>());
+  bool ok = true;
+  produce(writer, 0, &ok);
+  check(!ok, "producers are told to stop when writing fails");
+
+  bool threw = false;
+  try {
+    writer.finish();
+  } catch (std::runtime_error&) {
+    threw = true;
+  }
+  check(threw, "the error is thrown from finish");
+}
+}  // namespace
+
+int main() {
+  for (int i = 0; i < 20; i++) {
+    test_ordering();
+  }
+  test_failure();
+  if (failures) {
+    printf("%d ordered file writer checks failed\n", failures);
+    return 1;
+  }
+  printf("ordered file writer checks passed\n");
+  return 0;
+}
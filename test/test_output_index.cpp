@@ -0,0 +1,162 @@
+/*!
+ * @file test_output_index.cpp
+ * Writes files through a SkipUnchangedFileOutput over several runs, and checks which are skipped,
+ * that the rest are still created in order, and what the index keeps. Returns nonzero if a check
+ * fails.
+ */
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "util/FileIO.h"
+#include "util/OutputIndex.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+const char* OUTPUT_DIR = ".";
+const char* INDEX_NAME = "./.jak_disassembler_index";
+const char* FILE_NAMES[] = {"a", "b", "c", "d", "e", "gone"};
+
+std::string path(const char* name) {
+  return combine_path(OUTPUT_DIR, std::string("test_output_index_") + name + ".txt");
+}
+
+/*!
+ * Writes files with stdio, and records the files it was asked to create, in order.
+ */
+class RecordingFileOutput : public StdioFileOutput {
+ public:
+  explicit RecordingFileOutput(std::vector<std::string>* opened) : m_opened(opened) {}
+  void open(int file, const std::string& file_name) override {
+    m_opened->push_back(file_name);
+    StdioFileOutput::open(file, file_name);
+  }
+
+ private:
+  std::vector<std::string>* m_opened;
+};
+
+struct Run {
+  Run() {
+    index.load(OUTPUT_DIR);
+    output = std::make_unique<SkipUnchangedFileOutput>(
+        index, std::make_unique<RecordingFileOutput>(&opened));
+  }
+
+  /*!
+   * Open, write and close a file in one go.
+   */
+  void write_file(int file, const char* name, const std::string& text) {
+    output->open(file, path(name));
+    output->write(file, std::string(text));
+    output->close(file);
+  }
+
+  void finish() {
+    output->finish();
+    index.save();
+  }
+
+  OutputIndex index;
+  std::vector<std::string> opened;
+  std::unique_ptr<SkipUnchangedFileOutput> output;
+};
+
+bool opened_in_order(const Run& run, const std::vector<const char*>& names) {
+  std::vector<std::string> expected;
+  for (auto name : names) {
+    expected.push_back(path(name));
+  }
+  return run.opened == expected;
+}
+
+void test_skip_unchanged() {
+  remove(INDEX_NAME);
+  {
+    Run run;
+    int file = 0;
+    for (auto name : FILE_NAMES) {
+      run.write_file(file++, name, std::string("first ") + name + "\n");
+    }
+    run.finish();
+    check(run.opened.size() == 6, "every file is written the first time");
+    check(run.index.stats().written_files == 6, "every file written is in the index");
+  }
+
+  // a and d are the same. b is changed but the same size, c grows, e is the same but was changed
+  // on disk by something else, and gone isn't output any more.
+  write_text_file(path("e"), "first e, changed\n");
+  {
+    Run run;
+    auto& out = *run.output;
+    out.open(0, path("a"));  // held, it might be unchanged.
+    out.open(1, path("b"));  // can't be created before we know about a.
+    out.write(1, "second");
+    out.write(1, " b\n");
+    out.close(1);
+    out.open(2, path("c"));
+    out.write(2, "first");
+    out.write(0, "first a\n");
+    out.close(0);  // a is skipped, so b and then c can go.
+    check(opened_in_order(run, {"b"}), "a file after a skipped one is created");
+
+    out.open(3, path("d"));  // waits for c.
+    out.write(3, "first d\n");
+    out.close(3);
+    out.write(2, " c, but longer\n");  // c has changed, so is created. d can go, and is skipped.
+    check(opened_in_order(run, {"b", "c"}), "a file which grows is created");
+
+    out.open(4, path("e"));
+    out.close(2);
+    out.write(4, "first e\n");
+    out.close(4);
+    run.finish();
+
+    check(opened_in_order(run, {"b", "c", "e"}), "changed files are created in order");
+    auto stats = run.index.stats();
+    check(stats.skipped_files == 2 && stats.written_files == 3, "unchanged files are skipped");
+    check(read_text_file(path("b")) == "second b\n", "changed files are written");
+    check(read_text_file(path("c")) == "first c, but longer\n", "files which grow are written");
+    check(read_text_file(path("d")) == "first d\n", "skipped files are still there");
+    check(read_text_file(path("e")) == "first e\n", "files changed on disk are written again");
+  }
+
+  auto index = read_text_file(INDEX_NAME);
+  check(index.find(path("gone").substr(2)) == std::string::npos,
+        "files which weren't output are dropped from the index");
+  check(index.find(path("a").substr(2)) != std::string::npos,
+        "skipped files stay in the index");
+
+  {
+    Run run;
+    run.write_file(0, "a", "first a\n");
+    run.write_file(1, "b", "second b\n");
+    run.finish();
+    check(run.opened.empty(), "files written last time are skipped");
+  }
+
+  remove(INDEX_NAME);
+  for (auto name : FILE_NAMES) {
+    remove(path(name).c_str());
+  }
+}
+}  // namespace
+
+int main() {
+  test_skip_unchanged();
+  if (failures) {
+    printf("%d output index checks failed\n", failures);
+    return 1;
+  }
+  printf("output index checks passed\n");
+  return 0;
+}
@@ -0,0 +1,98 @@
+/*!
+ * @file test_type_info.cpp
+ * Informs TypeInfo from several threads at once, and checks that nothing was lost. Run it under
+ * TSAN to check the shard locking. Returns nonzero if a check fails.
+ */
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TypeSystem/TypeInfo.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+constexpr int THREAD_COUNT = 8;
+constexpr int SHARED_NAMES = 2000;
+constexpr int OWN_NAMES = 500;
+constexpr int TYPE_NAMES = 300;
+
+/*!
+ * Every thread informs the shared names and types, in a different order, so the same entries are
+ * added and updated from all of them. Each thread also has names of its own.
+ */
+void inform_from_thread(TypeInfo& info, int thread) {
+  for (int i = 0; i < SHARED_NAMES; i++) {
+    int n = (i + thread * SHARED_NAMES / THREAD_COUNT) % SHARED_NAMES;
+    auto name = "shared-" + std::to_string(n);
+    if (n % 2) {
+      info.inform_symbol(name, TypeSpec("int32"));
+    } else {
+      info.inform_symbol_with_no_type_info(name);
+    }
+  }
+
+  for (int i = 0; i < TYPE_NAMES; i++) {
+    int n = (i + thread * TYPE_NAMES / THREAD_COUNT) % TYPE_NAMES;
+    auto name = "type-" + std::to_string(n);
+    if (n % 3) {
+      info.inform_type_method_count(name, n % 20 + 9);
+    } else {
+      info.inform_type(name);
+    }
+  }
+
+  for (int i = 0; i < OWN_NAMES; i++) {
+    info.inform_symbol("thread-" + std::to_string(thread) + "-" + std::to_string(i),
+                       TypeSpec("pointer", {TypeSpec("uint8")}));
+  }
+}
+
+bool summary_has(const std::string& summary, const std::string& line) {
+  return summary.find(line) != std::string::npos;
+}
+}  // namespace
+
+int main() {
+  TypeInfo info;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    threads.emplace_back(inform_from_thread, std::ref(info), i);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // the type "type" is there from the start, but its symbol has no type info.
+  int total_symbols = 1 + SHARED_NAMES + TYPE_NAMES + THREAD_COUNT * OWN_NAMES;
+  int with_type_info = SHARED_NAMES / 2 + TYPE_NAMES + THREAD_COUNT * OWN_NAMES;
+  int total_types = 1 + TYPE_NAMES;
+  int with_method_count = TYPE_NAMES - TYPE_NAMES / 3;
+
+  auto summary = info.get_summary();
+  check(summary_has(summary, " Total Symbols: " + std::to_string(total_symbols) + "\n"),
+        "every symbol is there once");
+  check(summary_has(summary, "   with type info: " + std::to_string(with_type_info) + " "),
+        "every symbol informed of a type has it");
+  check(summary_has(summary, " Total Types: " + std::to_string(total_types) + "\n"),
+        "every type is there once");
+  check(summary_has(summary, "   with method count: " + std::to_string(with_method_count) + " "),
+        "every method count is there");
+
+  if (failures) {
+    printf("%s", summary.c_str());
+    printf("%d type info checks failed\n", failures);
+    return 1;
+  }
+  printf("type info checks passed\n");
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*!
+ * @file test_xref_database.cpp
+ * Builds a small cross-reference database and queries it, then checks that truncated and corrupt
+ * databases are rejected with an exception instead of being trusted. Returns nonzero if a check
+ * fails.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "XrefDatabase.h"
+#include "util/FileIO.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+const char* DATABASE_NAME = "test_xrefs.bin";
+
+// offsets of fields in the file, see XrefDatabase.cpp.
+constexpr size_t HEADER_SIZE = 24;
+constexpr size_t HEADER_N_OBJECTS = 8;
+constexpr size_t HEADER_N_TARGETS = 12;
+constexpr size_t HEADER_N_REFS = 16;
+constexpr size_t HEADER_STRING_TABLE_SIZE = 20;
+constexpr size_t TARGET_SIZE = 8;
+constexpr size_t TARGET_NAME = 0;
+constexpr size_t TARGET_FIRST_REF = 4;
+constexpr size_t REF_SIZE = 16;
+constexpr size_t REF_OBJECT = 0;
+constexpr size_t REF_KIND = 13;
+
+constexpr int N_OBJECTS = 2;
+constexpr int N_TARGETS = 3;
+
+ObjectXrefs make_xrefs(uint32_t object, const std::vector<std::string>& targets) {
+  ObjectXrefs result;
+  for (auto& target : targets) {
+    XrefLocation loc;
+    loc.object = object;
+    loc.offset = 4 * result.refs.size();
+    loc.kind = XrefKind::SYMBOL;
+    result.targets.push_back(target);
+    result.refs.push_back(loc);
+  }
+  return result;
+}
+
+std::vector<uint8_t> make_database() {
+  std::vector<ObjectXrefs> xrefs;
+  xrefs.push_back(make_xrefs(0, {"foo", "bar", "foo"}));
+  xrefs.push_back(make_xrefs(1, {"foo", "baz"}));
+  return build_xref_database({"obj-a", "obj-b"}, xrefs);
+}
+
+int query(const std::vector<uint8_t>& data, const std::string& target) {
+  write_binary_file(DATABASE_NAME, data.data(), data.size());
+  return query_xref_database(DATABASE_NAME, target);
+}
+
+bool rejected(const std::vector<uint8_t>& data, const std::string& target) {
+  try {
+    query(data, target);
+  } catch (std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+void test_round_trip() {
+  auto data = make_database();
+  check(query(data, "foo") == 3, "every reference to a target is found");
+  check(query(data, "bar") == 1, "the first target is found");
+  check(query(data, "baz") == 1, "a target in one object is found");
+  check(query(data, "ba") == 0, "a prefix of a target isn't a match");
+  check(query(data, "zzz") == 0, "a name after every target isn't found");
+  check(query(data, "") == 0, "the empty name isn't found");
+
+  auto empty = build_xref_database({}, {});
+  check(!rejected(empty, "foo") && query(empty, "foo") == 0, "an empty database can be queried");
+}
+
+/*!
+ * Every way of cutting the database short is caught by the size check.
+ */
+void test_truncated() {
+  auto data = make_database();
+  bool all_rejected = true;
+  for (size_t size = 0; size < data.size(); size++) {
+    all_rejected = all_rejected && rejected({data.begin(), data.begin() + size}, "foo");
+  }
+  check(all_rejected, "truncated databases are rejected");
+}
+
+void test_corrupt() {
+  const auto data = make_database();
+  auto targets_offset = HEADER_SIZE + 4 * N_OBJECTS;
+  auto refs_offset = targets_offset + TARGET_SIZE * N_TARGETS;
+  auto foo = targets_offset + 2 * TARGET_SIZE;
+  auto corrupt = [&](const char* what, size_t offset, auto value, const char* target) {
+    auto copy = data;
+    memcpy(copy.data() + offset, &value, sizeof(value));
+    check(rejected(copy, target), what);
+  };
+
+  corrupt("a bad magic is rejected", 0, 'Q', "foo");
+  corrupt("a huge object count is rejected", HEADER_N_OBJECTS, uint32_t(0x40000000), "foo");
+  corrupt("a huge target count is rejected", HEADER_N_TARGETS, uint32_t(0x20000000), "foo");
+  corrupt("a huge reference count is rejected", HEADER_N_REFS, uint32_t(0x10000000), "foo");
+  corrupt("a wrong string table size is rejected", HEADER_STRING_TABLE_SIZE, uint32_t(-8), "foo");
+  corrupt("an object name past the string table is rejected", HEADER_SIZE, uint32_t(1000),
+          "foo");
+  corrupt("a target name past the string table is rejected", foo + TARGET_NAME, uint32_t(1000),
+          "foo");
+  corrupt("unsorted references are rejected", foo + TARGET_FIRST_REF, uint32_t(0), "bar");
+  corrupt("references past the end are rejected", foo + TARGET_FIRST_REF, uint32_t(6), "bar");
+  corrupt("a string table without a terminator is rejected", data.size() - 1, 'x', "foo");
+
+  // references are only checked when they're printed.
+  auto last_ref = refs_offset + 4 * REF_SIZE;
+  corrupt("a reference to a bad object is rejected", last_ref + REF_OBJECT, uint32_t(N_OBJECTS),
+          "foo");
+  corrupt("a reference of a bad kind is rejected", last_ref + REF_KIND, uint8_t(XrefKind::MAX_KIND),
+          "foo");
+}
+}  // namespace
+
+int main() {
+  test_round_trip();
+  test_truncated();
+  test_corrupt();
+  remove(DATABASE_NAME);
+
+  if (failures) {
+    printf("%d xref database checks failed\n", failures);
+    return 1;
+  }
+  printf("xref database checks passed\n");
+  return 0;
+}
@@ -0,0 +1,330 @@
+/*!
+ * @file Archive.cpp
+ * A single file containing many output files, with an index to find them.
+ *
+ * File format (all integers are little endian):
+ *  header: "JDAR", u32 version, u32 entry count, u32 string table size, u64 index offset
+ *  entry data: the contents of each entry, one after another
+ *  index (at index offset): ArchiveFileEntry for each entry, then the string table
+ *
+ * The index is at the end, so entries can be written as they are generated. A compressed entry is
+ * a sequence of LZO chunks, as described in Compression.h.
+ */
+
+#include "Archive.h"
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include "Compression.h"
+#include "FileIO.h"
+
+namespace {
+constexpr uint32_t ARCHIVE_VERSION = 1;
+
+struct ArchiveFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t n_entries;
+  uint32_t string_table_size;
+  uint64_t index_offset;
+};
+
+struct ArchiveFileEntry {
+  uint32_t name;  // offset in string table
+  uint8_t kind;
+  uint8_t compressed;
+  uint16_t pad;
+  uint64_t offset;
+  uint64_t stored_size;
+  uint64_t size;
+};
+
+static_assert(sizeof(ArchiveFileHeader) == 24, "ArchiveFileHeader should be 24 bytes");
+static_assert(sizeof(ArchiveFileEntry) == 32, "ArchiveFileEntry should be 32 bytes");
+
+const char* archive_entry_kind_extensions[(int)ArchiveEntryKind::MAX_KIND] = {"func", "txt"};
+
+/*!
+ * fseek, but with offsets past 2 GB on platforms where long is 32 bits.
+ */
+int seek(FILE* fp, uint64_t offset) {
+#ifdef _WIN32
+  return _fseeki64(fp, int64_t(offset), SEEK_SET);
+#else
+  return fseeko(fp, off_t(offset), SEEK_SET);
+#endif
+}
+
+/*!
+ * Get the size of an open file, or -1 on error.
+ */
+int64_t file_size(FILE* fp) {
+#ifdef _WIN32
+  if (_fseeki64(fp, 0, SEEK_END) != 0) {
+    return -1;
+  }
+  return _ftelli64(fp);
+#else
+  if (fseeko(fp, 0, SEEK_END) != 0) {
+    return -1;
+  }
+  return int64_t(ftello(fp));
+#endif
+}
+}  // namespace
+
+const char* archive_entry_kind_extension(ArchiveEntryKind kind) {
+  assert(kind < ArchiveEntryKind::MAX_KIND);
+  return archive_entry_kind_extensions[(int)kind];
+}
+
+ArchiveWriter::ArchiveWriter(const std::string& file_name, bool compress)
+    : m_file_name(file_name), m_compress(compress) {
+  m_fp = fopen(file_name.c_str(), "wb");
+  if (!m_fp) {
+    printf("Failed to fopen %s\n", file_name.c_str());
+    throw std::runtime_error("Failed to open file");
+  }
+
+  // the header is filled in by finish.
+  ArchiveFileHeader header;
+  memset(&header, 0, sizeof(header));
+  write(&header, sizeof(header));
+}
+
+ArchiveWriter::~ArchiveWriter() {
+  if (m_fp) {
+    fclose(m_fp);
+  }
+}
+
+void ArchiveWriter::write(const void* data, size_t size) {
+  if (size && fwrite(data, size, 1, m_fp) != 1) {
+    throw std::runtime_error("Failed to write file " + m_file_name);
+  }
+  m_offset += size;
+}
+
+void ArchiveWriter::begin_entry(const std::string& name, ArchiveEntryKind kind) {
+  assert(!m_in_entry);
+  m_in_entry = true;
+  m_entries.push_back({name, kind, m_offset, 0, 0});
+}
+
+/*!
+ * Add data to the current entry. If the archive is compressed, the data must be chunks from
+ * compress_chunks, so entries can be compressed by the threads that generate them.
+ */
+void ArchiveWriter::append(const char* data, size_t size) {
+  assert(m_in_entry);
+  auto& entry = m_entries.back();
+  entry.size += m_compress ? chunks_uncompressed_size(data, size) : size;
+  write(data, size);
+}
+
+void ArchiveWriter::end_entry() {
+  assert(m_in_entry);
+  m_in_entry = false;
+  auto& entry = m_entries.back();
+  entry.stored_size = m_offset - entry.offset;
+}
+
+/*!
+ * Write the index and header. No more entries may be added.
+ */
+void ArchiveWriter::finish() {
+  assert(!m_in_entry);
+  std::string strings;
+  std::vector<ArchiveFileEntry> index;
+  for (auto& entry : m_entries) {
+    ArchiveFileEntry e;
+    memset(&e, 0, sizeof(e));
+    e.name = uint32_t(strings.size());
+    e.kind = uint8_t(entry.kind);
+    e.compressed = m_compress;
+    e.offset = entry.offset;
+    e.stored_size = entry.stored_size;
+    e.size = entry.size;
+    index.push_back(e);
+    strings.append(entry.name);
+    strings.push_back('\0');
+  }
+
+  ArchiveFileHeader header;
+  memcpy(header.magic, "JDAR", 4);
+  header.version = ARCHIVE_VERSION;
+  header.n_entries = uint32_t(m_entries.size());
+  header.string_table_size = uint32_t(strings.size());
+  header.index_offset = m_offset;
+
+  write(index.data(), index.size() * sizeof(ArchiveFileEntry));
+  write(strings.data(), strings.size());
+  if (fseek(m_fp, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, m_fp) != 1) {
+    throw std::runtime_error("Failed to write file " + m_file_name);
+  }
+  fclose(m_fp);
+  m_fp = nullptr;
+}
+
+void ArchiveFileOutput::open(int file, const std::string& file_name) {
+  // split path/name.extension into the entry name and kind
+  auto name = base_name(file_name);
+  auto dot = name.rfind('.');
+  assert(dot != std::string::npos);
+  auto extension = name.substr(dot + 1);
+  name.resize(dot);
+
+  ArchiveEntryKind kind = ArchiveEntryKind::MAX_KIND;
+  for (int i = 0; i < (int)ArchiveEntryKind::MAX_KIND; i++) {
+    if (extension == archive_entry_kind_extension(ArchiveEntryKind(i))) {
+      kind = ArchiveEntryKind(i);
+    }
+  }
+  if (kind == ArchiveEntryKind::MAX_KIND) {
+    throw std::runtime_error("Can't put " + file_name + " in an archive");
+  }
+
+  auto& pending = m_pending[file];
+  pending.name = name;
+  pending.kind = kind;
+  if (m_current == -1) {
+    start_next_entry();
+  }
+}
+
+void ArchiveFileOutput::write(int file, std::string&& block) {
+  if (file == m_current) {
+    m_archive.append(block.data(), block.size());
+  } else {
+    m_pending.at(file).blocks.push_back(std::move(block));
+    m_blocks_held++;
+  }
+}
+
+void ArchiveFileOutput::close(int file) {
+  if (file == m_current) {
+    m_archive.end_entry();
+    m_current = -1;
+    start_next_entry();
+  } else {
+    m_pending.at(file).closed = true;
+  }
+}
+
+void ArchiveFileOutput::finish() {
+  if (m_current != -1 || !m_pending.empty()) {
+    throw std::runtime_error("Archive entries were not closed");
+  }
+}
+
+/*!
+ * Start the next entry in the archive, and write everything we have for it. Files are opened in
+ * order, so the next file is the first pending one.
+ */
+void ArchiveFileOutput::start_next_entry() {
+  while (m_current == -1 && !m_pending.empty()) {
+    auto it = m_pending.begin();
+    m_current = it->first;
+    m_archive.begin_entry(it->second.name, it->second.kind);
+    for (auto& block : it->second.blocks) {
+      m_archive.append(block.data(), block.size());
+    }
+    m_blocks_held -= it->second.blocks.size();
+    if (it->second.closed) {
+      m_archive.end_entry();
+      m_current = -1;
+    }
+    m_pending.erase(it);
+  }
+}
+
+ArchiveReader::ArchiveReader(const std::string& file_name) : m_file_name(file_name) {
+  m_fp = fopen(file_name.c_str(), "rb");
+  if (!m_fp) {
+    throw std::runtime_error("File " + file_name + " cannot be opened");
+  }
+
+  ArchiveFileHeader header;
+  read(&header, 0, sizeof(header));
+  if (memcmp(header.magic, "JDAR", 4) != 0 || header.version != ARCHIVE_VERSION) {
+    throw std::runtime_error("Archive " + file_name + " has the wrong format or version");
+  }
+
+  // the index is at the end of the file. Check its size before allocating anything for it.
+  int64_t size = file_size(m_fp);
+  uint64_t index_size =
+      uint64_t(header.n_entries) * sizeof(ArchiveFileEntry) + header.string_table_size;
+  if (size < 0 || header.index_offset > uint64_t(size) ||
+      uint64_t(size) - header.index_offset != index_size) {
+    throw std::runtime_error("Archive " + file_name + " has the wrong size");
+  }
+
+  std::vector<ArchiveFileEntry> index(header.n_entries);
+  std::string strings(header.string_table_size, '\0');
+  read(index.data(), header.index_offset, index.size() * sizeof(ArchiveFileEntry));
+  read(&strings[0], header.index_offset + index.size() * sizeof(ArchiveFileEntry), strings.size());
+  if (strings.empty() ? !index.empty() : strings.back() != '\0') {
+    throw std::runtime_error("Archive " + file_name + " has a bad string table");
+  }
+
+  for (auto& e : index) {
+    if (e.name >= strings.size() || e.kind >= uint8_t(ArchiveEntryKind::MAX_KIND) ||
+        e.stored_size > header.index_offset || e.offset > header.index_offset - e.stored_size) {
+      throw std::runtime_error("Archive " + file_name + " has a bad entry");
+    }
+    m_entries.push_back({strings.c_str() + e.name, ArchiveEntryKind(e.kind), e.compressed != 0,
+                         e.offset, e.stored_size, e.size});
+  }
+}
+
+ArchiveReader::~ArchiveReader() {
+  if (m_fp) {
+    fclose(m_fp);
+  }
+}
+
+void ArchiveReader::read(void* dest, uint64_t offset, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (seek(m_fp, offset) != 0 || fread(dest, size, 1, m_fp) != 1) {
+    throw std::runtime_error("Archive " + m_file_name + " cannot be read");
+  }
+}
+
+/*!
+ * Find an entry by its file name, like name.func. Returns -1 if it isn't found.
+ */
+int ArchiveReader::find_entry(const std::string& file_name) const {
+  for (int i = 0; i < int(m_entries.size()); i++) {
+    auto& e = m_entries[i];
+    if (file_name == e.name + "." + archive_entry_kind_extension(e.kind)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+std::string ArchiveReader::read_entry(int idx) {
+  auto& e = m_entries.at(idx);
+  std::string stored(e.stored_size, '\0');
+  read(&stored[0], e.offset, stored.size());
+  if (!e.compressed) {
+    if (e.stored_size != e.size) {
+      throw std::runtime_error("Archive " + m_file_name + " has a bad entry");
+    }
+    return stored;
+  }
+
+  // the size in the index isn't trusted for the allocation, the chunk headers are checked first.
+  uint64_t size = chunks_uncompressed_size(stored.data(), stored.size());
+  if (size != e.size) {
+    throw std::runtime_error("Archive " + m_file_name + " has a bad entry");
+  }
+  std::string result;
+  result.reserve(size);
+  if (decompress_chunks(stored.data(), stored.size(), result) != e.size) {
+    throw std::runtime_error("Archive " + m_file_name + " has a bad entry");
+  }
+  return result;
+}
@@ -0,0 +1,123 @@
+/*!
+ * @file Archive.h
+ * A single file containing many output files, with an index to find them.
+ */
+
+#ifndef JAK_DISASSEMBLER_ARCHIVE_H
+#define JAK_DISASSEMBLER_ARCHIVE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "FileOutput.h"
+
+enum class ArchiveEntryKind : uint8_t {
+  DISASSEMBLY,  // .func
+  HEXDUMP,      // .txt
+  MAX_KIND
+};
+
+const char* archive_entry_kind_extension(ArchiveEntryKind kind);
+
+/*!
+ * Writes an archive. Entries are written one at a time, in full, so each entry is contiguous. If
+ * compressed, each entry is stored as a sequence of LZO compressed chunks, which are passed in
+ * already compressed.
+ */
+class ArchiveWriter {
+ public:
+  ArchiveWriter(const std::string& file_name, bool compress);
+  ~ArchiveWriter();
+  ArchiveWriter(const ArchiveWriter&) = delete;
+  ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+  void begin_entry(const std::string& name, ArchiveEntryKind kind);
+  void append(const char* data, size_t size);
+  void end_entry();
+  void finish();
+  bool compressed() const { return m_compress; }
+
+ private:
+  struct Entry {
+    std::string name;
+    ArchiveEntryKind kind;
+    uint64_t offset;
+    uint64_t stored_size;
+    uint64_t size;
+  };
+
+  void write(const void* data, size_t size);
+
+  std::string m_file_name;
+  FILE* m_fp = nullptr;
+  bool m_compress;
+  uint64_t m_offset = 0;
+  bool m_in_entry = false;
+  std::vector<Entry> m_entries;
+};
+
+/*!
+ * A FileOutput which puts files into an archive instead. The archive needs whole entries, so
+ * blocks for a file are held in memory until all earlier files are done. These count towards the
+ * OrderedFileWriter's queue limit, so the held blocks don't grow without bound.
+ */
+class ArchiveFileOutput : public FileOutput {
+ public:
+  explicit ArchiveFileOutput(ArchiveWriter& archive) : m_archive(archive) {}
+  const char* name() const override { return "archive"; }
+  void open(int file, const std::string& file_name) override;
+  void write(int file, std::string&& block) override;
+  void close(int file) override;
+  void finish() override;
+  size_t blocks_held() const override { return m_blocks_held; }
+
+ private:
+  struct PendingFile {
+    std::string name;
+    ArchiveEntryKind kind;
+    std::vector<std::string> blocks;
+    bool closed = false;
+  };
+
+  void start_next_entry();
+
+  ArchiveWriter& m_archive;
+  std::map<int, PendingFile> m_pending;  // files which have been opened, but not written
+  int m_current = -1;                    // file currently being written to the archive
+  size_t m_blocks_held = 0;              // blocks in m_pending
+};
+
+/*!
+ * Reads entries from an archive.
+ */
+class ArchiveReader {
+ public:
+  struct Entry {
+    std::string name;
+    ArchiveEntryKind kind;
+    bool compressed;
+    uint64_t offset;
+    uint64_t stored_size;
+    uint64_t size;
+  };
+
+  explicit ArchiveReader(const std::string& file_name);
+  ~ArchiveReader();
+  ArchiveReader(const ArchiveReader&) = delete;
+  ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+  const std::vector<Entry>& entries() const { return m_entries; }
+  int find_entry(const std::string& file_name) const;
+  std::string read_entry(int idx);
+
+ private:
+  void read(void* dest, uint64_t offset, size_t size);
+
+  std::string m_file_name;
+  FILE* m_fp = nullptr;
+  std::vector<Entry> m_entries;
+};
+
+#endif  // JAK_DISASSEMBLER_ARCHIVE_H
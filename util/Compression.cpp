@@ -0,0 +1,142 @@
+/*!
+ * @file Compression.cpp
+ * LZO compression of output files, split into chunks which are compressed independently.
+ */
+
+#include "Compression.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include "third-party/minilzo/minilzo.h"
+
+namespace {
+void init_lzo() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    if (lzo_init() != LZO_E_OK) {
+      throw std::runtime_error("lzo_init() failed");
+    }
+  });
+}
+
+struct ChunkHeader {
+  uint32_t size;
+  uint32_t stored_size;
+};
+
+/*!
+ * Read the header of the chunk at offset, and check that its data is there.
+ */
+ChunkHeader read_chunk_header(const char* data, size_t size, size_t offset) {
+  ChunkHeader header;
+  if (offset + sizeof(header) > size) {
+    throw std::runtime_error("Compressed data has a bad chunk");
+  }
+  memcpy(&header, data + offset, sizeof(header));
+  if (header.stored_size > header.size || header.size > MAX_COMPRESSED_CHUNK_SIZE ||
+      offset + sizeof(header) + header.stored_size > size) {
+    throw std::runtime_error("Compressed data has a bad chunk");
+  }
+  return header;
+}
+}  // namespace
+
+/*!
+ * Compress data and append the chunks to dest. Can be used from multiple threads at once.
+ */
+void compress_chunks(const char* data, size_t size, std::string& dest) {
+  init_lzo();
+  thread_local std::vector<uint8_t> work_memory(LZO1X_1_MEM_COMPRESS);
+
+  while (size > 0) {
+    auto chunk_size = uint32_t(std::min(size, MAX_COMPRESSED_CHUNK_SIZE));
+    // reserve enough for the worst case, then shrink to what was used.
+    size_t header_offset = dest.size();
+    dest.resize(header_offset + sizeof(ChunkHeader) + chunk_size + chunk_size / 16 + 64 + 3);
+    auto out = (lzo_bytep)&dest[header_offset + sizeof(ChunkHeader)];
+    lzo_uint compressed_size = 0;
+    auto rv = lzo1x_1_compress((const lzo_bytep)data, chunk_size, out, &compressed_size,
+                               work_memory.data());
+    if (rv != LZO_E_OK) {
+      throw std::runtime_error("lzo1x_1_compress() failed");
+    }
+
+    ChunkHeader header = {chunk_size, chunk_size};
+    if (compressed_size < chunk_size) {
+      header.stored_size = uint32_t(compressed_size);
+    } else {
+      memcpy(out, data, chunk_size);
+    }
+    memcpy(&dest[header_offset], &header, sizeof(header));
+    dest.resize(header_offset + sizeof(header) + header.stored_size);
+    data += chunk_size;
+    size -= chunk_size;
+  }
+}
+
+/*!
+ * Decompress chunks and append the result to dest. Returns the number of bytes added.
+ */
+uint64_t decompress_chunks(const char* data, size_t size, std::string& dest) {
+  init_lzo();
+  size_t in = 0;
+  uint64_t total = 0;
+  while (in < size) {
+    auto header = read_chunk_header(data, size, in);
+    in += sizeof(header);
+    size_t out = dest.size();
+    dest.resize(out + header.size);
+    if (header.stored_size == header.size) {
+      memcpy(&dest[out], data + in, header.size);
+    } else {
+      lzo_uint decompressed_size = header.size;
+      auto rv = lzo1x_decompress_safe((const lzo_bytep)data + in, header.stored_size,
+                                      (lzo_bytep)&dest[out], &decompressed_size, nullptr);
+      if (rv != LZO_E_OK || decompressed_size != header.size) {
+        throw std::runtime_error("Compressed data has a bad chunk");
+      }
+    }
+    in += header.stored_size;
+    total += header.size;
+  }
+  return total;
+}
+
+/*!
+ * Add up the sizes of chunks, without decompressing them.
+ */
+uint64_t chunks_uncompressed_size(const char* data, size_t size) {
+  size_t in = 0;
+  uint64_t total = 0;
+  while (in < size) {
+    auto header = read_chunk_header(data, size, in);
+    in += sizeof(header) + header.stored_size;
+    total += header.size;
+  }
+  return total;
+}
+
+std::string compressed_file_header() {
+  std::string result(COMPRESSED_FILE_MAGIC, 4);
+  result.append((const char*)&COMPRESSED_FILE_VERSION, 4);
+  return result;
+}
+
+/*!
+ * Decompress the contents of a .lzo output file.
+ */
+std::string decompress_file(const std::vector<uint8_t>& data) {
+  uint32_t version = 0;
+  if (data.size() >= COMPRESSED_FILE_HEADER_SIZE) {
+    memcpy(&version, data.data() + 4, 4);
+  }
+  if (data.size() < COMPRESSED_FILE_HEADER_SIZE ||
+      memcmp(data.data(), COMPRESSED_FILE_MAGIC, 4) != 0 || version != COMPRESSED_FILE_VERSION) {
+    throw std::runtime_error("File isn't a compressed output file, or has the wrong version");
+  }
+  std::string result;
+  decompress_chunks((const char*)data.data() + COMPRESSED_FILE_HEADER_SIZE,
+                    data.size() - COMPRESSED_FILE_HEADER_SIZE, result);
+  return result;
+}
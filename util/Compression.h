@@ -0,0 +1,32 @@
+/*!
+ * @file Compression.h
+ * LZO compression of output files, split into chunks which are compressed independently.
+ *
+ * Compressed data is a sequence of chunks, each with a u32 size, u32 stored size, then the data.
+ * If the stored size is the same as the size, the chunk wasn't compressible and is stored as is.
+ * Because chunks are independent, separate parts of a file can be compressed on different threads
+ * and the results concatenated.
+ */
+
+#ifndef JAK_DISASSEMBLER_COMPRESSION_H
+#define JAK_DISASSEMBLER_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr size_t MAX_COMPRESSED_CHUNK_SIZE = 256 * 1024;
+
+// at the start of a compressed .lzo output file, followed by chunks.
+constexpr char COMPRESSED_FILE_MAGIC[4] = {'J', 'D', 'L', 'Z'};
+constexpr uint32_t COMPRESSED_FILE_VERSION = 1;
+constexpr size_t COMPRESSED_FILE_HEADER_SIZE = 8;
+
+void compress_chunks(const char* data, size_t size, std::string& dest);
+uint64_t decompress_chunks(const char* data, size_t size, std::string& dest);
+uint64_t chunks_uncompressed_size(const char* data, size_t size);
+std::string compressed_file_header();
+std::string decompress_file(const std::vector<uint8_t>& data);
+
+#endif  // JAK_DISASSEMBLER_COMPRESSION_H
@@ -1,4 +1,5 @@
 #include "FileIO.h"
+#include "OutputIndex.h"
 #include <fstream>
 #include <sstream>
 #include <cassert>
@@ -72,11 +73,55 @@ uint32_t crc32(const std::vector<uint8_t>& data) {
 }
 
 void write_text_file(const std::string& file_name, const std::string& text) {
+  auto& index = get_output_index();
+  uint64_t hash = 0;
+  if (index.enabled()) {
+    hash = hash_output(hash_output(OUTPUT_HASH_INIT, text.data(), text.size()), "\n", 1);
+    if (index.is_unchanged(file_name, hash, text.size() + 1)) {
+      index.record_skip(text.size() + 1);
+      return;
+    }
+  }
+
   FILE* fp = fopen(file_name.c_str(), "w");
   if(!fp) {
     printf("Failed to fopen %s\n", file_name.c_str());
     throw std::runtime_error("Failed to open file");
   }
-  fprintf(fp, "%s\n", text.c_str());
+  if ((!text.empty() && fwrite(text.data(), text.size(), 1, fp) != 1) || fputc('\n', fp) == EOF) {
+    fclose(fp);
+    throw std::runtime_error("Failed to write file " + file_name);
+  }
   fclose(fp);
-}
\ No newline at end of file
+
+  if (index.enabled()) {
+    index.record_write(file_name, hash, text.size() + 1);
+  }
+}
+
+void write_binary_file(const std::string& file_name, const void* data, size_t size) {
+  auto& index = get_output_index();
+  uint64_t hash = 0;
+  if (index.enabled()) {
+    hash = hash_output(OUTPUT_HASH_INIT, data, size);
+    if (index.is_unchanged(file_name, hash, size)) {
+      index.record_skip(size);
+      return;
+    }
+  }
+
+  FILE* fp = fopen(file_name.c_str(), "wb");
+  if (!fp) {
+    printf("Failed to fopen %s\n", file_name.c_str());
+    throw std::runtime_error("Failed to open file");
+  }
+  if (size && fwrite(data, size, 1, fp) != 1) {
+    fclose(fp);
+    throw std::runtime_error("Failed to write file " + file_name);
+  }
+  fclose(fp);
+
+  if (index.enabled()) {
+    index.record_write(file_name, hash, size);
+  }
+}
@@ -0,0 +1,53 @@
+#include "FileOutput.h"
+#include <cassert>
+#include <stdexcept>
+
+StdioFileOutput::~StdioFileOutput() {
+  for (auto& file : m_files) {
+    if (file.fp) {
+      fclose(file.fp);
+    }
+  }
+}
+
+void StdioFileOutput::open(int file, const std::string& file_name) {
+  if (int(m_files.size()) <= file) {
+    m_files.resize(file + 1, {nullptr, ""});
+  }
+  auto fp = fopen(file_name.c_str(), "w");
+  if (!fp) {
+    printf("Failed to fopen %s\n", file_name.c_str());
+    throw std::runtime_error("Failed to open file");
+  }
+  m_files[file] = {fp, file_name};
+}
+
+void StdioFileOutput::write(int file, std::string&& block) {
+  auto& f = m_files.at(file);
+  assert(f.fp);
+  if (!block.empty() && fwrite(block.data(), block.size(), 1, f.fp) != 1) {
+    throw std::runtime_error("Failed to write file " + f.name);
+  }
+}
+
+void StdioFileOutput::close(int file) {
+  auto& f = m_files.at(file);
+  assert(f.fp);
+  fclose(f.fp);
+  f.fp = nullptr;
+}
+
+/*!
+ * Get a FileOutput. If io_uring is requested but isn't available, falls back to stdio.
+ */
+std::unique_ptr<FileOutput> make_file_output(bool use_io_uring) {
+  if (use_io_uring) {
+    std::string error;
+    auto result = make_io_uring_file_output(&error);
+    if (result) {
+      return result;
+    }
+    printf("io_uring isn't available (%s), writing files with stdio instead\n", error.c_str());
+  }
+  return std::make_unique<StdioFileOutput>();
+}
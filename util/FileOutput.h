@@ -0,0 +1,55 @@
+/*!
+ * @file FileOutput.h
+ * Ways of writing many files: plain stdio, or batched with io_uring on Linux.
+ */
+
+#ifndef JAK_DISASSEMBLER_FILEOUTPUT_H
+#define JAK_DISASSEMBLER_FILEOUTPUT_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*!
+ * Something which creates and writes files. Files are identified by an index, and are created in
+ * the order open is called. Operations may be queued and done later: after finish(), all files
+ * have been written and closed. Errors are reported by throwing.
+ */
+class FileOutput {
+ public:
+  virtual ~FileOutput() = default;
+  virtual const char* name() const = 0;
+  virtual void open(int file, const std::string& file_name) = 0;
+  virtual void write(int file, std::string&& block) = 0;
+  virtual void close(int file) = 0;
+  // start queued operations. Called when there's nothing else to do for a while.
+  virtual void submit() {}
+  virtual void finish() {}
+  // blocks which were written, but are kept in memory until an earlier file is done.
+  virtual size_t blocks_held() const { return 0; }
+};
+
+/*!
+ * Writes each file with fopen/fwrite/fclose, right away.
+ */
+class StdioFileOutput : public FileOutput {
+ public:
+  ~StdioFileOutput() override;
+  const char* name() const override { return "stdio"; }
+  void open(int file, const std::string& file_name) override;
+  void write(int file, std::string&& block) override;
+  void close(int file) override;
+
+ private:
+  struct OpenFile {
+    FILE* fp;
+    std::string name;
+  };
+  std::vector<OpenFile> m_files;
+};
+
+std::unique_ptr<FileOutput> make_io_uring_file_output(std::string* error);
+std::unique_ptr<FileOutput> make_file_output(bool use_io_uring);
+
+#endif  // JAK_DISASSEMBLER_FILEOUTPUT_H
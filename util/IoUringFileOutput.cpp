@@ -0,0 +1,505 @@
+/*!
+ * @file IoUringFileOutput.cpp
+ * A FileOutput which uses io_uring to keep many opens, writes and closes in flight at once.
+ * Only available on Linux, when built with JAK_HAS_IO_URING.
+ */
+
+#include "FileOutput.h"
+
+#ifdef JAK_HAS_IO_URING
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+constexpr unsigned RING_ENTRIES = 256;
+constexpr unsigned MAX_OPENS_PER_BATCH = 32;
+constexpr unsigned SUBMIT_BATCH = 16;
+constexpr size_t MAX_BLOCKS_HELD = 64;
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* params) {
+  return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+  return int(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+/*!
+ * Does the kernel support all the operations we use? OPENAT and CLOSE are newer than io_uring
+ * itself, and kernels without them also don't have the probe.
+ */
+bool supports_our_ops(int ring_fd) {
+  constexpr unsigned PROBE_OPS = 256;
+  std::vector<uint8_t> buffer(sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op), 0);
+  auto probe = (io_uring_probe*)buffer.data();
+  if (sys_io_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0) {
+    return false;
+  }
+  for (unsigned op : {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE}) {
+    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+class IoUringFileOutput : public FileOutput {
+ public:
+  ~IoUringFileOutput() override;
+  bool init(std::string* error);
+  const char* name() const override { return "io_uring"; }
+  void open(int file, const std::string& file_name) override;
+  void write(int file, std::string&& block) override;
+  void close(int file) override;
+  void submit() override;
+  void finish() override;
+
+ private:
+  enum class OpKind : uint8_t { OPEN, WRITE, CLOSE };
+
+  // an operation which is waiting to run, or running. Referenced by index, stored in user_data.
+  struct Op {
+    OpKind kind;
+    int file;
+    std::string block;  // for writes
+    size_t done;        // bytes of block already written
+    uint64_t offset;    // offset in the file of the start of block
+  };
+
+  struct File {
+    std::string name;
+    int fd = -1;
+    std::vector<int> waiting_writes;  // writes which need the file to be opened first
+    int writes_in_flight = 0;
+    bool close_requested = false;
+    uint64_t size = 0;
+  };
+
+  io_uring_sqe* next_sqe();
+  void push_sqe(int op, uint8_t flags = 0);
+  int new_op(OpKind kind, int file);
+  void free_op(int op);
+  void start_opens();
+  void start_write(int op);
+  void start_close_if_done(int file);
+  void enter(unsigned min_complete);
+  void reap();
+  void handle_completion(int op, int result);
+
+  int m_ring_fd = -1;
+  void* m_sq_ptr = MAP_FAILED;
+  size_t m_sq_size = 0;
+  void* m_cq_ptr = MAP_FAILED;
+  size_t m_cq_size = 0;
+  io_uring_sqe* m_sqes = (io_uring_sqe*)MAP_FAILED;
+  size_t m_sqes_size = 0;
+  unsigned* m_sq_tail = nullptr;
+  unsigned m_sq_mask = 0;
+  unsigned* m_sq_array = nullptr;
+  unsigned* m_cq_head = nullptr;
+  unsigned* m_cq_tail = nullptr;
+  unsigned m_cq_mask = 0;
+  io_uring_cqe* m_cqes = nullptr;
+  unsigned m_entries = 0;
+
+  unsigned m_to_submit = 0;  // in the submission queue, but not given to the kernel yet
+  unsigned m_in_flight = 0;  // given to the kernel, but not completed yet
+
+  // deques, so the strings the kernel points to don't move when we add more.
+  std::deque<Op> m_ops;
+  std::vector<int> m_free_ops;
+  std::deque<File> m_files;
+
+  // files to create. Opens are done in linked batches, so files are created in order.
+  std::deque<int> m_opens_waiting;
+  int m_opens_in_flight = 0;
+  size_t m_blocks_held = 0;
+
+  // a file whose open was cancelled because an earlier open in its batch failed.
+  int m_cancelled_file = -1;
+};
+
+bool IoUringFileOutput::init(std::string* error) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  m_ring_fd = sys_io_uring_setup(RING_ENTRIES, &params);
+  if (m_ring_fd < 0) {
+    *error = std::string("io_uring_setup failed: ") + strerror(errno);
+    return false;
+  }
+  if (!(params.features & IORING_FEAT_NODROP) || !supports_our_ops(m_ring_fd)) {
+    *error = "kernel is too old";
+    return false;
+  }
+  m_entries = params.sq_entries;
+
+  m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  m_sq_ptr = mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+                  IORING_OFF_SQ_RING);
+  m_cq_ptr = mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd,
+                  IORING_OFF_CQ_RING);
+  m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+  if (m_sq_ptr == MAP_FAILED || m_cq_ptr == MAP_FAILED || m_sqes == MAP_FAILED) {
+    *error = std::string("mmap failed: ") + strerror(errno);
+    return false;
+  }
+
+  auto sq = (uint8_t*)m_sq_ptr;
+  m_sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  m_sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+  m_sq_array = (unsigned*)(sq + params.sq_off.array);
+  auto cq = (uint8_t*)m_cq_ptr;
+  m_cq_head = (unsigned*)(cq + params.cq_off.head);
+  m_cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  m_cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+  m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+  return true;
+}
+
+IoUringFileOutput::~IoUringFileOutput() {
+  // the kernel may still be using our buffers, so wait for everything to finish.
+  if (m_cqes) {
+    while (m_in_flight + m_to_submit > 0) {
+      int ret = sys_io_uring_enter(m_ring_fd, m_to_submit, 1, IORING_ENTER_GETEVENTS);
+      if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        break;
+      }
+      if (ret > 0) {
+        m_in_flight += ret;
+        m_to_submit -= ret;
+      }
+      unsigned head = *m_cq_head;
+      unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != tail; head++) {
+        auto& cqe = m_cqes[head & m_cq_mask];
+        auto& op = m_ops.at(cqe.user_data);
+        if (op.kind == OpKind::OPEN && cqe.res >= 0) {
+          m_files.at(op.file).fd = cqe.res;
+        } else if (op.kind == OpKind::CLOSE && cqe.res >= 0) {
+          m_files.at(op.file).fd = -1;
+        }
+        m_in_flight--;
+      }
+      __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    }
+  }
+
+  for (auto& file : m_files) {
+    if (file.fd >= 0) {
+      ::close(file.fd);
+    }
+  }
+  if (m_sqes != MAP_FAILED) {
+    munmap(m_sqes, m_sqes_size);
+  }
+  if (m_cq_ptr != MAP_FAILED) {
+    munmap(m_cq_ptr, m_cq_size);
+  }
+  if (m_sq_ptr != MAP_FAILED) {
+    munmap(m_sq_ptr, m_sq_size);
+  }
+  if (m_ring_fd >= 0) {
+    ::close(m_ring_fd);
+  }
+}
+
+void IoUringFileOutput::open(int file, const std::string& file_name) {
+  if (int(m_files.size()) <= file) {
+    m_files.resize(file + 1);
+  }
+  m_files[file].name = file_name;
+  m_opens_waiting.push_back(file);
+  if (m_opens_in_flight == 0) {
+    start_opens();
+  }
+}
+
+void IoUringFileOutput::write(int file, std::string&& block) {
+  auto& f = m_files.at(file);
+  assert(!f.close_requested);
+  if (block.empty()) {
+    return;
+  }
+
+  int op = new_op(OpKind::WRITE, file);
+  m_ops[op].offset = f.size;
+  f.size += block.size();
+  m_ops[op].block = std::move(block);
+  m_blocks_held++;
+
+  if (f.fd >= 0) {
+    start_write(op);
+  } else {
+    f.waiting_writes.push_back(op);
+  }
+
+  if (m_to_submit >= SUBMIT_BATCH) {
+    enter(0);
+  }
+  reap();
+
+  // don't keep too many blocks in memory.
+  while (m_blocks_held >= MAX_BLOCKS_HELD) {
+    start_opens();
+    assert(m_in_flight + m_to_submit > 0);
+    enter(1);
+  }
+}
+
+void IoUringFileOutput::close(int file) {
+  m_files.at(file).close_requested = true;
+  start_close_if_done(file);
+}
+
+void IoUringFileOutput::submit() {
+  start_opens();
+  if (m_to_submit) {
+    enter(0);
+  }
+  reap();
+}
+
+void IoUringFileOutput::finish() {
+  for (;;) {
+    submit();
+    if (m_in_flight + m_to_submit == 0 && m_opens_waiting.empty()) {
+      break;
+    }
+    enter(1);
+  }
+  if (m_cancelled_file != -1) {
+    throw std::runtime_error("Failed to write file " + m_files[m_cancelled_file].name + ": " +
+                             strerror(ECANCELED));
+  }
+  for (auto& file : m_files) {
+    if (file.fd >= 0 || !file.waiting_writes.empty()) {
+      throw std::runtime_error("File " + file.name + " was never closed");
+    }
+  }
+}
+
+/*!
+ * Get the next submission queue entry. If the ring is full, waits for something to finish.
+ * The entry isn't given to the kernel until push_sqe.
+ */
+io_uring_sqe* IoUringFileOutput::next_sqe() {
+  while (m_to_submit + m_in_flight >= m_entries) {
+    enter(1);
+  }
+  auto sqe = &m_sqes[*m_sq_tail & m_sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void IoUringFileOutput::push_sqe(int op, uint8_t flags) {
+  unsigned tail = *m_sq_tail;
+  unsigned idx = tail & m_sq_mask;
+  m_sqes[idx].user_data = op;
+  m_sqes[idx].flags = flags;
+  m_sq_array[idx] = idx;
+  __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+  m_to_submit++;
+}
+
+int IoUringFileOutput::new_op(OpKind kind, int file) {
+  int result;
+  if (m_free_ops.empty()) {
+    result = int(m_ops.size());
+    m_ops.emplace_back();
+  } else {
+    result = m_free_ops.back();
+    m_free_ops.pop_back();
+  }
+  auto& op = m_ops[result];
+  op.kind = kind;
+  op.file = file;
+  op.done = 0;
+  op.offset = 0;
+  return result;
+}
+
+void IoUringFileOutput::free_op(int op) {
+  m_ops[op].block = std::string();
+  m_free_ops.push_back(op);
+}
+
+/*!
+ * Start creating the waiting files, unless files are already being created. The opens are linked
+ * together, so the kernel does them in order.
+ */
+void IoUringFileOutput::start_opens() {
+  if (m_opens_in_flight > 0 || m_opens_waiting.empty()) {
+    return;
+  }
+
+  // make sure the whole batch fits, so it isn't split between submissions.
+  while (m_to_submit + m_in_flight >= m_entries) {
+    enter(1);
+  }
+  unsigned count = std::min(unsigned(m_opens_waiting.size()), MAX_OPENS_PER_BATCH);
+  count = std::min(count, m_entries - m_to_submit - m_in_flight);
+
+  for (unsigned i = 0; i < count; i++) {
+    int file = m_opens_waiting.front();
+    m_opens_waiting.pop_front();
+    int op = new_op(OpKind::OPEN, file);
+    auto sqe = next_sqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)m_files[file].name.c_str();
+    sqe->len = 0644;
+    sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    push_sqe(op, i + 1 < count ? IOSQE_IO_LINK : 0);
+    m_opens_in_flight++;
+  }
+}
+
+void IoUringFileOutput::start_write(int op) {
+  auto& o = m_ops[op];
+  auto& f = m_files[o.file];
+  assert(f.fd >= 0);
+  auto sqe = next_sqe();
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = f.fd;
+  sqe->addr = (uint64_t)(o.block.data() + o.done);
+  sqe->len = unsigned(o.block.size() - o.done);
+  sqe->off = o.offset + o.done;
+  push_sqe(op);
+  f.writes_in_flight++;
+}
+
+void IoUringFileOutput::start_close_if_done(int file) {
+  auto& f = m_files[file];
+  if (f.close_requested && f.fd >= 0 && f.writes_in_flight == 0 && f.waiting_writes.empty()) {
+    int op = new_op(OpKind::CLOSE, file);
+    auto sqe = next_sqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = f.fd;
+    push_sqe(op);
+    f.close_requested = false;
+  }
+}
+
+/*!
+ * Give the queued entries to the kernel, and wait for at least min_complete to finish.
+ */
+void IoUringFileOutput::enter(unsigned min_complete) {
+  unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+  int ret = sys_io_uring_enter(m_ring_fd, m_to_submit, min_complete, flags);
+  if (ret < 0) {
+    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      throw std::runtime_error(std::string("io_uring_enter failed: ") + strerror(errno));
+    }
+  } else {
+    m_in_flight += ret;
+    m_to_submit -= ret;
+  }
+  reap();
+}
+
+/*!
+ * Handle all completions. Handling may add more entries, so they are copied out first.
+ */
+void IoUringFileOutput::reap() {
+  std::vector<io_uring_cqe> completed;
+  unsigned head = *m_cq_head;
+  unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    completed.push_back(m_cqes[head & m_cq_mask]);
+  }
+  __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+  m_in_flight -= completed.size();
+
+  for (auto& cqe : completed) {
+    handle_completion(int(cqe.user_data), cqe.res);
+  }
+}
+
+void IoUringFileOutput::handle_completion(int op, int result) {
+  auto& o = m_ops[op];
+  int file = o.file;
+  auto& f = m_files[file];
+  if (result == -ECANCELED && o.kind == OpKind::OPEN) {
+    // the open that failed reports the real error, which may not have been reaped yet.
+    if (m_cancelled_file == -1) {
+      m_cancelled_file = file;
+    }
+    m_opens_in_flight--;
+    free_op(op);
+    return;
+  }
+  if (result < 0) {
+    throw std::runtime_error("Failed to write file " + f.name + ": " + strerror(-result));
+  }
+
+  switch (o.kind) {
+    case OpKind::OPEN:
+      f.fd = result;
+      m_opens_in_flight--;
+      free_op(op);
+      for (int write_op : f.waiting_writes) {
+        start_write(write_op);
+      }
+      f.waiting_writes.clear();
+      start_close_if_done(file);
+      start_opens();
+      break;
+    case OpKind::WRITE:
+      if (result == 0) {
+        throw std::runtime_error("Failed to write file " + f.name);
+      }
+      o.done += result;
+      f.writes_in_flight--;
+      if (o.done < o.block.size()) {
+        start_write(op);  // short write, do the rest.
+      } else {
+        free_op(op);
+        m_blocks_held--;
+        start_close_if_done(file);
+      }
+      break;
+    case OpKind::CLOSE:
+      f.fd = -1;
+      free_op(op);
+      break;
+  }
+}
+}  // namespace
+
+/*!
+ * Create a FileOutput using io_uring, or return nullptr and set error if it isn't available.
+ */
+std::unique_ptr<FileOutput> make_io_uring_file_output(std::string* error) {
+  auto result = std::make_unique<IoUringFileOutput>();
+  if (!result->init(error)) {
+    return nullptr;
+  }
+  return result;
+}
+
+#else
+
+std::unique_ptr<FileOutput> make_io_uring_file_output(std::string* error) {
+  *error = "not supported by this build";
+  return nullptr;
+}
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <utility>
 #include <vector>
 
 //////// HACK - symbol table now looks up by string, which makes it really stupid and store
@@ -9,9 +10,10 @@
 // should probably just remove it
 
 /*!
- * String interning
+ * String interning. Can be used from multiple threads.
  */
 std::string* SymbolTable::intern(const std::string& str) {
+  std::lock_guard<std::mutex> lk(mutex);
   if (map.find(str) == map.end()) {
     auto* new_string = new std::string(str);
     map[str] = new_string;
@@ -27,8 +29,7 @@ std::string* SymbolTable::intern(const std::string& str) {
 SymbolTable gSymbolTable;
 
 SymbolTable::SymbolTable() {
-  empty_pair = std::make_shared<Form>();
-  empty_pair->kind = FormKind::EMPTY_LIST;
+  empty_pair.kind = FormKind::EMPTY_LIST;
 }
 
 SymbolTable::~SymbolTable() {
@@ -36,6 +37,34 @@ SymbolTable::~SymbolTable() {
     delete kv.second;
 }
 
+static thread_local FormPool* currentFormPool = nullptr;
+
+FormPool::FormPool() : m_previous(currentFormPool) {
+  currentFormPool = this;
+}
+
+FormPool::~FormPool() {
+  assert(currentFormPool == this);
+  currentFormPool = m_previous;
+}
+
+Form* FormPool::alloc(FormKind kind) {
+  if(m_used == m_block_size) {
+    m_block_size = m_block_size ? m_block_size * 2 : 1024;
+    m_blocks.emplace_back(new Form[m_block_size]);
+    m_used = 0;
+  }
+  auto* f = &m_blocks.back()[m_used++];
+  f->kind = kind;
+  return f;
+}
+
+FormPool& FormPool::current() {
+  // forms have to be made in a scoped pool, so it's clear when they are freed.
+  assert(currentFormPool);
+  return *currentFormPool;
+}
+
 /*!
  * Convert a form to a one-line string.
  */
@@ -45,35 +74,64 @@ std::string Form::toStringSimple() {
   return result;
 }
 
+/*!
+ * Append the text of a token to a string. Like FormToken::toString, but without a temporary.
+ */
+static void appendToken(std::string& str, const FormToken& token) {
+  switch(token.kind) {
+    case TokenKind::WHITESPACE:
+      str.push_back(' ');
+      break;
+    case TokenKind::SYMBOL:
+      str.append(*token.str);
+      break;
+    case TokenKind::OPEN_PAREN:
+      str.push_back('(');
+      break;
+    case TokenKind::DOT:
+      str.push_back('.');
+      break;
+    case TokenKind::CLOSE_PAREN:
+      str.push_back(')');
+      break;
+    case TokenKind::EMPTY_PAIR:
+      str.append("()");
+      break;
+    case TokenKind::SPECIAL_SYMBOL:
+    case TokenKind::LABEL:
+      str.append(*token.str);
+      break;
+    default:
+      throw std::runtime_error("appendToken unknown token kind");
+  }
+}
+
+/*!
+ * Length of the text of a token.
+ */
+static int tokenWidth(const FormToken& token) {
+  switch(token.kind) {
+    case TokenKind::WHITESPACE:
+    case TokenKind::OPEN_PAREN:
+    case TokenKind::DOT:
+    case TokenKind::CLOSE_PAREN:
+      return 1;
+    case TokenKind::EMPTY_PAIR:
+      return 2;
+    case TokenKind::SYMBOL:
+    case TokenKind::SPECIAL_SYMBOL:
+    case TokenKind::LABEL:
+      return int(token.str->length());
+    default:
+      throw std::runtime_error("tokenWidth unknown token kind");
+  }
+}
+
 void Form::buildStringSimple(std::string &str) {
   std::vector<FormToken> tokens;
   toTokenList(tokens);
   for(auto& token : tokens) {
-    switch(token.kind) {
-      case TokenKind::WHITESPACE:
-        str.push_back(' ');
-        break;
-      case TokenKind::SYMBOL:
-        str.append(*token.str);
-        break;
-      case TokenKind::OPEN_PAREN:
-        str.push_back('(');
-        break;
-      case TokenKind::DOT:
-        str.push_back('.');
-        break;
-      case TokenKind::CLOSE_PAREN:
-        str.push_back(')');
-        break;
-      case TokenKind::EMPTY_PAIR:
-        str.append("()");
-        break;
-      case TokenKind::SPECIAL_SYMBOL:
-        str.append(*token.str);
-        break;
-      default:
-        throw std::runtime_error("buildStringSimple unknown token kind");
-    }
+    appendToken(str, token);
   }
 }
 
@@ -84,12 +142,16 @@ void Form::toTokenList(std::vector<FormToken> &tokens) {
       break;
     case FormKind::PAIR:
     {
+      if(label) {
+        tokens.emplace_back(TokenKind::LABEL, label);
+      }
       tokens.emplace_back(TokenKind::OPEN_PAREN);
       Form* toPrint = this;
       for(;;) {
-        if(toPrint->kind == FormKind::PAIR) {
+        // a labeled rest of the list is printed like the end of an improper list.
+        if(toPrint->kind == FormKind::PAIR && (toPrint == this || !toPrint->label)) {
           toPrint->pair[0]->toTokenList(tokens); // print CAR
-          toPrint = toPrint->pair[1].get();
+          toPrint = toPrint->pair[1];
           if(toPrint->kind == FormKind::EMPTY_LIST) {
             tokens.emplace_back(TokenKind::CLOSE_PAREN);
             return;
@@ -124,157 +186,108 @@ void Form::toTokenList(std::vector<FormToken> &tokens) {
  */
 struct PrettyPrinterNode {
   FormToken* tok = nullptr; // if we aren't a newline, we will have a token.
-  int line = -1;            // line that token occurs on. undef for newlines
+  int width = 0;            // length of the token's text
+  int line = -1;            // line that token occurs on, -1 until laid out. undef for newlines
   int lineIndent = -1;      // indent of line.  only valid for first token in the line
   int offset = -1;          // offset of beginning of token from left margin
-  int specialIndentDelta = 0;
   bool is_line_separator = false; // true if line separator (not a token)
   PrettyPrinterNode *next = nullptr, *prev = nullptr; // linked list
   PrettyPrinterNode *paren = nullptr; // pointer to open paren if in parens.  open paren points to close and vice versa
+  PrettyPrinterNode *parent = nullptr; // open paren which sets our indent if we start a line
+  int childIndent = -1;     // indent of lines in this list. only valid for open parens
   explicit PrettyPrinterNode(FormToken& _tok) {
     tok = &_tok;
+    width = tokenWidth(_tok);
   }
   PrettyPrinterNode() = default;
 };
 
+/*!
+ * Allocates nodes for one pretty print in blocks, and frees them all at once when it's done.
+ */
+class PrettyPrinterArena {
+ public:
+  // the first block should fit all the tokens, and some line breaks.
+  explicit PrettyPrinterArena(size_t first_block_size) : next_block_size(first_block_size) {}
+
+  template <typename... Args>
+  PrettyPrinterNode* alloc(Args&&... args) {
+    if(used == block_size) {
+      block_size = next_block_size;
+      next_block_size *= 2;
+      blocks.emplace_back(new PrettyPrinterNode[block_size]);
+      used = 0;
+    }
+    auto* node = &blocks.back()[used++];
+    *node = PrettyPrinterNode(std::forward<Args>(args)...);
+    return node;
+  }
+
+ private:
+  std::vector<std::unique_ptr<PrettyPrinterNode[]>> blocks;
+  size_t block_size = 0;
+  size_t next_block_size;
+  size_t used = 0;
+};
+
 /*!
  * Splice in a line break after the given node, it there isn't one already and if it isn't the last node.
  */
-static void insertNewlineAfter(PrettyPrinterNode* node, int specialIndentDelta) {
+static void insertNewlineAfter(PrettyPrinterArena& arena, PrettyPrinterNode* node) {
   if(node->next && !node->next->is_line_separator) {
-    auto* nl = new PrettyPrinterNode;
+    auto* nl = arena.alloc();
     auto* next = node->next;
     node->next = nl;
     nl->prev = node;
     nl->next = next;
     next->prev = nl;
     nl->is_line_separator = true;
-    nl->specialIndentDelta = specialIndentDelta;
   }
 }
 
 /*!
  * Splice in a line break before the given node, if there isn't one already and if it isn't the first node.
  */
-static void insertNewlineBefore(PrettyPrinterNode* node, int specialIndentDelta) {
+static void insertNewlineBefore(PrettyPrinterArena& arena, PrettyPrinterNode* node) {
   if(node->prev && !node->prev->is_line_separator) {
-    auto* nl = new PrettyPrinterNode;
+    auto* nl = arena.alloc();
     auto* prev = node->prev;
     prev->next = nl;
     nl->prev = prev;
     nl->next = node;
     node->prev = nl;
     nl->is_line_separator = true;
-    nl->specialIndentDelta = specialIndentDelta;
   }
 }
 
 /*!
  * Break a list across multiple lines. This is the fundamental reducing operation of this algorithm
+ * Returns the last token of the first element, which now ends its line, or nullptr if the list
+ * is empty.
  */
-static void breakList(PrettyPrinterNode* leftParen) {
+static PrettyPrinterNode* breakList(PrettyPrinterArena& arena, PrettyPrinterNode* leftParen) {
   assert(!leftParen->is_line_separator);
   assert(leftParen->tok->kind == TokenKind::OPEN_PAREN);
   auto* rp = leftParen->paren;
   assert(rp->tok->kind == TokenKind::CLOSE_PAREN);
 
+  PrettyPrinterNode* first_end = nullptr;
   for(auto* n = leftParen->next; n && n != rp; n = n->next) {
     if(!n->is_line_separator) {
       if(n->tok->kind == TokenKind::OPEN_PAREN) {
         n = n->paren;
         assert(n->tok->kind == TokenKind::CLOSE_PAREN);
-        insertNewlineAfter(n, 0);
-      } else if(n->tok->kind != TokenKind::WHITESPACE) {
+        insertNewlineAfter(arena, n);
+      } else if(n->tok->kind != TokenKind::WHITESPACE && n->tok->kind != TokenKind::LABEL) {
         assert(n->tok->kind != TokenKind::CLOSE_PAREN);
-        insertNewlineAfter(n, 0);
-      }
-    }
-  }
-}
-
-/*!
- * Compute proper line numbers, offsets, and indents for a list of tokens with newlines
- * Will add newlines for close parens if needed.
- */
-static PrettyPrinterNode* propagatePretty(PrettyPrinterNode* list, int line_length) {
-  // propagate line numbers
-  PrettyPrinterNode* rv = nullptr;
-  int line = list->line;
-  for(auto* n = list; n; n = n->next) {
-    if(n->is_line_separator) {
-      line++;
-    } else {
-      n->line = line;
-      // add the weird newline.
-      if(n->tok->kind == TokenKind::CLOSE_PAREN) {
-        if(n->line != n->paren->line) {
-          if(n->prev && !n->prev->is_line_separator) {
-            insertNewlineBefore(n, 0);
-            line++;
-          }
-          if(n->next && !n->next->is_line_separator) {
-            insertNewlineAfter(n, 0);
-          }
-        }
-      }
-    }
-  }
-
-  // compute offsets and indents
-  std::vector<int> indentStack;
-  indentStack.push_back(0);
-  int offset = 0;
-  PrettyPrinterNode* line_start = list;
-  bool previous_line_sep = false;
-  for(auto* n = list; n; n = n->next) {
-    if(n->is_line_separator) {
-      previous_line_sep = true;
-      offset = indentStack.back() += n->specialIndentDelta;
-    } else {
-      if(previous_line_sep) {
-        line_start = n;
-        n->lineIndent = offset;
-        previous_line_sep = false;
-      }
-
-      n->offset = offset;
-      offset += n->tok->toString().length();
-      if(offset > line_length && !rv) rv = line_start;
-      if(n->tok->kind == TokenKind::OPEN_PAREN) {
-        if(!n->prev || n->prev->is_line_separator) {
-          indentStack.push_back(offset + 1);
-        } else {
-          indentStack.push_back(offset - 1);
-        }
-
-      }
-
-      if(n->tok->kind == TokenKind::CLOSE_PAREN) {
-        indentStack.pop_back();
+        insertNewlineAfter(arena, n);
+      } else {
+        continue;
       }
-    }
-
-  }
-  return rv;
-}
-
-/*!
- * Get the token on the start of the next line. nullptr if we're the last line.
- */
-static PrettyPrinterNode* getNextLine(PrettyPrinterNode* start) {
-  assert(!start->is_line_separator);
-  int line = start->line;
-  for(;;) {
-    if(start->is_line_separator || start->line == line) {
-      if(start->next)
-        start = start->next;
-      else
-        return nullptr;
-    } else {
-      break;
+      if(!first_end) first_end = n;
     }
   }
-  return start;
+  return first_end;
 }
 
 /*!
@@ -310,86 +323,76 @@ static PrettyPrinterNode* getFirstListOnLine(PrettyPrinterNode* start) {
 }
 
 /*!
- * Get the first token on the first line which exceeds the max length
+ * Compute the offsets and indent of one line, starting at the given token, and give it a line
+ * number. Adds newlines for close parens if needed, which can end the line early.
+ * Returns the last token on the line.
  */
-static PrettyPrinterNode* getFirstBadLine(PrettyPrinterNode* start, int line_length) {
+static PrettyPrinterNode* layoutLine(PrettyPrinterArena& arena,
+                                     PrettyPrinterNode* start,
+                                     int line) {
   assert(!start->is_line_separator);
-  int currentLine = start->line;
-  auto* currentLineNode = start;
-  for(;;) {
-    if(start->is_line_separator) {
-      assert(start->next);
-      start = start->next;
-    } else {
-      if(start->line != currentLine) {
-        currentLine = start->line;
-        currentLineNode = start;
-      }
-      if(start->offset > line_length) {
-        return currentLineNode;
-      }
-      if(!start->next) {
-        return nullptr;
+  int offset = start->parent ? start->parent->childIndent : 0;
+  start->lineIndent = offset;
+  PrettyPrinterNode* last = start;
+  for(auto* n = start; n && !n->is_line_separator; n = n->next) {
+    n->line = line;
+    // a close paren goes on its own line if the list was broken.
+    if(n->tok->kind == TokenKind::CLOSE_PAREN && n->paren->line != line) {
+      if(n != start) {
+        insertNewlineBefore(arena, n);
+        break;
       }
-      start = start->next;
+      insertNewlineAfter(arena, n);
+    }
+
+    n->offset = offset;
+    last = n;
+    offset += n->width;
+    if(n->tok->kind == TokenKind::OPEN_PAREN) {
+      // a list right after a label which starts the line is indented like it started the line.
+      bool starts_line = n == start || (n->prev == start && start->tok->kind == TokenKind::LABEL);
+      n->childIndent = starts_line ? offset + 1 : offset - 1;
     }
   }
+  return last;
 }
 
 /*!
- * Break insertion algorithm.
+ * Break insertion algorithm. Lines are laid out from top to bottom, each one once. Breaking a list
+ * only changes the line it starts on and the lines after it, so each line is final once it's done.
+ * If a line is too long, the lists on it are broken one at a time until it fits. Breaking a list
+ * just ends the line early, after the list's first element, without moving anything before that.
+ * Offsets only increase along a line, so it fits if its last token does.
  */
-static void insertBreaksAsNeeded(PrettyPrinterNode* head, int line_length) {
-  PrettyPrinterNode* last_line_complete = nullptr;
-  PrettyPrinterNode* line_to_start_line_search = head;
-
-  // loop over lines
-  for(;;) {
-
-    // compute lines as needed
-    propagatePretty(head, line_length);
-
-    // search for a bad line starting at the last line we fixed
-    PrettyPrinterNode* candidate_line = getFirstBadLine(line_to_start_line_search, line_length);
-    // if we got the same line we started on, this means we couldn't fix it.
-    if(candidate_line == last_line_complete) {
-      candidate_line = nullptr; // so we say our candidate was bad and try to find another
-      PrettyPrinterNode* next_line = getNextLine(line_to_start_line_search);
-      if(next_line) {
-        candidate_line = getFirstBadLine(next_line, line_length);
-      }
-    }
-    if(!candidate_line) break;
-
-    // okay, we have a line which needs fixing.
-    assert(!candidate_line->prev || candidate_line->prev->is_line_separator);
-    PrettyPrinterNode* form_to_start = getFirstListOnLine(candidate_line);
-    for(;;) {
-      breakList(form_to_start);
-      propagatePretty(head, line_length);
-      if(getFirstBadLine(candidate_line, line_length) != candidate_line) {
-        break;
+static void insertBreaksAsNeeded(PrettyPrinterArena& arena,
+                                 PrettyPrinterNode* head,
+                                 int line_length) {
+  int line = 0;
+  for(auto* start = head; start; line++) {
+    auto* last = layoutLine(arena, start, line);
+    if(last->offset > line_length) {
+      for(auto* list = getFirstListOnLine(start); list; list = getNextListOnLine(list)) {
+        auto* first_end = breakList(arena, list);
+        // if the first element went past the end of the line, the line was already ending earlier.
+        if(first_end && first_end->line == line) last = first_end;
+        if(last->offset <= line_length) break;
       }
-
-      form_to_start = getNextListOnLine(form_to_start);
-      if(!form_to_start) break;
-
     }
 
-
-    last_line_complete = candidate_line;
-    line_to_start_line_search = candidate_line;
+    // on to the next line
+    while(start && !start->is_line_separator) start = start->next;
+    if(start) start = start->next;
   }
 }
 
-static void insertSpecialBreaks(PrettyPrinterNode* node) {
+static void insertSpecialBreaks(PrettyPrinterArena& arena, PrettyPrinterNode* node) {
   for(; node; node = node->next) {
     if(!node->is_line_separator && node->tok->kind == TokenKind::SYMBOL) {
       std::string& name = *node->tok->str;
       if(name == "deftype") {
         auto* parent_type_dec = getNextListOnLine(node);
         if(parent_type_dec) {
-          insertNewlineAfter(parent_type_dec->paren, 0);
+          insertNewlineAfter(arena, parent_type_dec->paren);
         }
       }
     }
@@ -405,26 +408,20 @@ std::string Form::toStringPretty(int indent, int line_length) {
   std::string pretty;
 
   // build linked list of nodes
-  PrettyPrinterNode* head = new PrettyPrinterNode(tokens[0]);
+  PrettyPrinterArena arena(tokens.size() + tokens.size() / 2 + 16);
+  PrettyPrinterNode* head = arena.alloc(tokens[0]);
   PrettyPrinterNode* node = head;
-  head->line = 0;
-  head->offset = 0;
-  head->lineIndent = 0;
-  int offset = head->tok->toString().length();
   for(size_t i = 1; i < tokens.size(); i++) {
-    node->next = new PrettyPrinterNode(tokens[i]);
+    node->next = arena.alloc(tokens[i]);
     node->next->prev = node;
     node = node->next;
-    node->line = 0;
-    node->offset = offset;
-    offset += node->tok->toString().length();
-    node->lineIndent = 0;
   }
 
   // attach parens.
   std::vector<PrettyPrinterNode*> parenStack;
   parenStack.push_back(nullptr);
   for(PrettyPrinterNode* n = head; n; n = n->next) {
+    n->parent = parenStack.back();
     if(n->tok->kind == TokenKind::OPEN_PAREN) {
       parenStack.push_back(n);
     } else if(n->tok->kind == TokenKind::CLOSE_PAREN) {
@@ -438,9 +435,8 @@ std::string Form::toStringPretty(int indent, int line_length) {
   assert(parenStack.size() == 1);
   assert(!parenStack.back());
 
-  insertSpecialBreaks(head);
-  propagatePretty(head, line_length);
-  insertBreaksAsNeeded(head, line_length);
+  insertSpecialBreaks(arena, head);
+  insertBreaksAsNeeded(arena, head, line_length);
 
 
   // write to string
@@ -455,43 +451,32 @@ std::string Form::toStringPretty(int indent, int line_length) {
         newline_prev = false;
         if(n->tok->kind == TokenKind::WHITESPACE) continue;
       }
-      pretty.append(n->tok->toString());
+      appendToken(pretty, *n->tok);
     }
   }
 
-  for(;;) {
-    if(!head) break;
-    auto* next = head->next;
-    delete head;
-    head = next;
-  }
-
-
   return pretty;
 }
 
-std::shared_ptr<Form> toForm(const std::string& str) {
-  auto f = std::make_shared<Form>();
-  f->kind = FormKind::SYMBOL;
+Form* toForm(const std::string& str) {
+  auto f = FormPool::current().alloc(FormKind::SYMBOL);
   f->symbol = gSymbolTable.intern(str);
   return f;
 }
 
-std::shared_ptr<Form> buildList(std::shared_ptr<Form> form) {
-  auto f = std::make_shared<Form>();
-  f->kind = FormKind::PAIR;
+Form* buildList(Form* form) {
+  auto f = FormPool::current().alloc(FormKind::PAIR);
   f->pair[0] = form;
   f->pair[1] = gSymbolTable.getEmptyPair();
   return f;
 }
 
-std::shared_ptr<Form> buildList(const std::string& str) {
+Form* buildList(const std::string& str) {
   return buildList(toForm(str));
 }
 
-std::shared_ptr<Form> buildList(std::shared_ptr<Form>* forms, int count) {
-  auto f = std::make_shared<Form>();
-  f->kind = FormKind::PAIR;
+Form* buildList(Form** forms, int count) {
+  auto f = FormPool::current().alloc(FormKind::PAIR);
   f->pair[0] = forms[0];
   if(count - 1) {
     f->pair[1] = buildList(forms + 1, count - 1);
@@ -502,7 +487,7 @@ std::shared_ptr<Form> buildList(std::shared_ptr<Form>* forms, int count) {
   return f;
 }
 
-std::shared_ptr<Form> buildList(std::vector<std::shared_ptr<Form>>& forms) {
+Form* buildList(std::vector<Form*>& forms) {
   if(forms.empty()) {
     return gSymbolTable.getEmptyPair();
   }
@@ -2,6 +2,7 @@
 #define JAK2_DISASSEMBLER_LISPPRINT_H
 
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -31,7 +32,8 @@ enum class TokenKind {
   DOT,
   CLOSE_PAREN,
   EMPTY_PAIR,
-  SPECIAL_SYMBOL
+  SPECIAL_SYMBOL,
+  LABEL  // names the list right after it, like #L12=
 };
 
 /*!
@@ -67,6 +69,7 @@ struct FormToken {
         s.append("()");
         break;
       case TokenKind::SPECIAL_SYMBOL:
+      case TokenKind::LABEL:
         s.append(*str);
         break;
       default:
@@ -77,14 +80,16 @@ struct FormToken {
 };
 
 /*!
- * S-Expression Form
+ * S-Expression Form. Forms are allocated from a FormPool, and point to each other with plain
+ * pointers, so they are only valid while their pool is.
  */
 class Form {
  public:
-  FormKind kind;
+  FormKind kind = FormKind::SYMBOL;
 
-  std::string* symbol;
-  std::shared_ptr<Form> pair[2];
+  std::string* symbol = nullptr;
+  Form* pair[2] = {nullptr, nullptr};
+  std::string* label = nullptr;  // for a PAIR, printed before it if it's shared, like #L12=
 
   std::string toStringSimple();
   std::string toStringPretty(int indent = 0, int line_length = 80);
@@ -94,6 +99,30 @@ class Form {
   void buildStringSimple(std::string& str);
 };
 
+/*!
+ * Allocates Forms in blocks, and frees them all at once when it's destroyed.
+ *
+ * The pool most recently created on a thread is the current pool for that thread, which is used by
+ * toForm and buildList. There must be one: code which makes forms creates a pool for as long as
+ * it needs them.
+ */
+class FormPool {
+ public:
+  FormPool();
+  ~FormPool();
+  FormPool(const FormPool&) = delete;
+  FormPool& operator=(const FormPool&) = delete;
+
+  Form* alloc(FormKind kind);
+  static FormPool& current();
+
+ private:
+  std::vector<std::unique_ptr<Form[]>> m_blocks;
+  size_t m_block_size = 0;
+  size_t m_used = 0;
+  FormPool* m_previous = nullptr;
+};
+
 /*!
  * Symbol table to reduce the number of strings everywhere.
  */
@@ -102,11 +131,12 @@ class SymbolTable {
   SymbolTable();
   std::string* intern(const std::string& str);
   ~SymbolTable();
-  std::shared_ptr<Form> getEmptyPair() { return empty_pair; }
+  Form* getEmptyPair() { return &empty_pair; }
 
  private:
+  std::mutex mutex;
   std::unordered_map<std::string, std::string*> map;
-  std::shared_ptr<Form> empty_pair;
+  Form empty_pair;
 };
 
 /*!
@@ -114,26 +144,24 @@ class SymbolTable {
  */
 extern SymbolTable gSymbolTable;
 
-std::shared_ptr<Form> toForm(const std::string& str);  //
+Form* toForm(const std::string& str);  //
 
-std::shared_ptr<Form> buildList(const std::string& str);
-std::shared_ptr<Form> buildList(std::shared_ptr<Form> form);
-std::shared_ptr<Form> buildList(std::vector<std::shared_ptr<Form>>& forms);
-std::shared_ptr<Form> buildList(std::shared_ptr<Form>* forms, int count);
+Form* buildList(const std::string& str);
+Form* buildList(Form* form);
+Form* buildList(std::vector<Form*>& forms);
+Form* buildList(Form** forms, int count);
 
 template <typename... Args>
-std::shared_ptr<Form> buildList(const std::string& str, Args... rest) {
-  auto f = std::make_shared<Form>();
-  f->kind = FormKind::PAIR;
+Form* buildList(const std::string& str, Args... rest) {
+  auto f = FormPool::current().alloc(FormKind::PAIR);
   f->pair[0] = toForm(str);
   f->pair[1] = buildList(rest...);
   return f;
 }
 
 template <typename... Args>
-std::shared_ptr<Form> buildList(std::shared_ptr<Form> car, Args... rest) {
-  auto f = std::make_shared<Form>();
-  f->kind = FormKind::PAIR;
+Form* buildList(Form* car, Args... rest) {
+  auto f = FormPool::current().alloc(FormKind::PAIR);
   f->pair[0] = car;
   f->pair[1] = buildList(rest...);
   return f;
@@ -0,0 +1,47 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include "FileIO.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& file_name) {
+#ifdef __linux__
+  int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("File " + file_name + " cannot be opened");
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("File " + file_name + " cannot be read");
+  }
+  m_size = size_t(st.st_size);
+  if (m_size > 0) {
+    void* ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("File " + file_name + " cannot be mapped");
+    }
+    m_map = ptr;
+    m_data = (const uint8_t*)ptr;
+  }
+  close(fd);
+#else
+  m_read = read_binary_file(file_name);
+  m_data = m_read.data();
+  m_size = m_read.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef __linux__
+  if (m_map) {
+    munmap(m_map, m_size);
+  }
+#endif
+}
@@ -0,0 +1,35 @@
+/*!
+ * @file MappedFile.h
+ * Read only access to a whole file, without reading it all in.
+ */
+
+#ifndef JAK_DISASSEMBLER_MAPPEDFILE_H
+#define JAK_DISASSEMBLER_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+ * A file mapped into memory, so only the pages which are used get read. Where mapping isn't
+ * supported, the whole file is read instead. Throws if the file can't be opened.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& file_name);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+ private:
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+  void* m_map = nullptr;
+  std::vector<uint8_t> m_read;  // if not mapped
+};
+
+#endif  // JAK_DISASSEMBLER_MAPPEDFILE_H
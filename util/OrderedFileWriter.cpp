@@ -0,0 +1,153 @@
+#include "OrderedFileWriter.h"
+#include <cassert>
+
+OrderedFileWriter::OrderedFileWriter(std::vector<std::string> file_names,
+                                     int max_queued,
+                                     std::unique_ptr<FileOutput> output)
+    : m_file_names(std::move(file_names)),
+      m_output(std::move(output)),
+      m_max_queued(max_queued),
+      m_close_pushed(m_file_names.size(), 0) {
+  assert(max_queued > 0);
+  m_thread = std::thread([this]() { writer_loop(); });
+}
+
+OrderedFileWriter::~OrderedFileWriter() {
+  if (m_thread.joinable()) {
+    abort();
+    m_thread.join();
+  }
+}
+
+/*!
+ * Add a block of text to the end of a file. Waits if too many blocks are queued already.
+ * Returns false if writing has failed, in which case the producer should stop.
+ */
+bool OrderedFileWriter::write_block(int file, std::string&& block) {
+  return push({file, false, std::move(block)});
+}
+
+/*!
+ * Indicate that a file is done. No more blocks may be written to it.
+ */
+bool OrderedFileWriter::close_file(int file) {
+  return push({file, true, std::string()});
+}
+
+bool OrderedFileWriter::push(Item&& item) {
+  assert(item.file >= 0 && item.file < int(m_file_names.size()));
+  bool first_unclosed_changed = false;
+  {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_space_cv.wait(lk, [&]() {
+      if (m_failed) {
+        return true;
+      }
+      if (item.file <= m_first_unclosed) {
+        return m_queue.size() < m_max_queued;
+      }
+      return m_queue.size() + m_output_held < m_max_queued;
+    });
+    if (m_failed) {
+      return false;
+    }
+    if (item.close) {
+      m_close_pushed.at(item.file) = 1;
+      while (m_first_unclosed < int(m_close_pushed.size()) && m_close_pushed[m_first_unclosed]) {
+        m_first_unclosed++;
+        first_unclosed_changed = true;
+      }
+    }
+    m_queue.push_back(std::move(item));
+  }
+  m_ready_cv.notify_one();
+  if (first_unclosed_changed) {
+    m_space_cv.notify_all();
+  }
+  return true;
+}
+
+/*!
+ * Stop writing, because a producer failed. Blocks which haven't been written yet are dropped.
+ */
+void OrderedFileWriter::abort() {
+  {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_failed = true;
+  }
+  m_ready_cv.notify_all();
+  m_space_cv.notify_all();
+}
+
+/*!
+ * Wait for all queued blocks to be written. Must be called after all producers are done.
+ * If writing failed, the error is rethrown here.
+ */
+void OrderedFileWriter::finish() {
+  {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_finishing = true;
+  }
+  m_ready_cv.notify_all();
+  m_thread.join();
+
+  if (m_exception) {
+    std::rethrow_exception(m_exception);
+  }
+}
+
+void OrderedFileWriter::writer_loop() {
+  try {
+    for (;;) {
+      Item item;
+      bool output_released = false;
+      {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        size_t held = m_output->blocks_held();
+        output_released = held < m_output_held;
+        m_output_held = held;
+        if (m_queue.empty() && !m_failed && !m_finishing) {
+          // nothing to do for now, so start anything the output has batched up.
+          lk.unlock();
+          m_output->submit();
+          lk.lock();
+        }
+        m_ready_cv.wait(lk, [&]() { return m_failed || m_finishing || !m_queue.empty(); });
+        if (m_failed) {
+          return;
+        }
+        if (m_queue.empty()) {
+          break;
+        }
+        item = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      if (output_released) {
+        m_space_cv.notify_all();
+      } else {
+        m_space_cv.notify_one();
+      }
+      write_item(item);
+    }
+    m_output->finish();
+  } catch (...) {
+    m_exception = std::current_exception();
+    abort();
+  }
+}
+
+void OrderedFileWriter::write_item(Item& item) {
+  // create all files up to this one, so they are always created in order.
+  while (m_n_created <= item.file) {
+    m_output->open(m_n_created, m_file_names[m_n_created]);
+    m_n_created++;
+  }
+
+  if (item.close) {
+    m_output->close(item.file);
+    m_files_written++;
+  } else {
+    m_bytes_written += item.block.size();
+    m_output->write(item.file, std::move(item.block));
+  }
+}
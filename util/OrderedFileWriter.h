@@ -0,0 +1,84 @@
+/*!
+ * @file OrderedFileWriter.h
+ * Writes text files on a background thread, creating them in a fixed order.
+ */
+
+#ifndef JAK_DISASSEMBLER_ORDEREDFILEWRITER_H
+#define JAK_DISASSEMBLER_ORDEREDFILEWRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileOutput.h"
+
+/*!
+ * A thread which writes files while other threads generate them. The generating threads submit
+ * blocks of text for a file with write_block, then call close_file once the file is done.
+ *
+ * Files are created in the order of file_names, no matter which order blocks arrive in. To limit
+ * memory use, at most max_queued blocks are waiting to be written, and write_block waits for
+ * space. Producers should take files in increasing order, so only a few files are open at once.
+ *
+ * Blocks which the FileOutput holds on to also count towards max_queued, but blocks for the first
+ * file which isn't closed yet are always accepted, so that file can finish and release the rest.
+ *
+ * The writes themselves are done by a FileOutput, which may batch them up.
+ */
+class OrderedFileWriter {
+ public:
+  OrderedFileWriter(std::vector<std::string> file_names,
+                    int max_queued,
+                    std::unique_ptr<FileOutput> output);
+  ~OrderedFileWriter();
+  OrderedFileWriter(const OrderedFileWriter&) = delete;
+  OrderedFileWriter& operator=(const OrderedFileWriter&) = delete;
+
+  bool write_block(int file, std::string&& block);
+  bool close_file(int file);
+  void abort();
+  void finish();
+
+  uint32_t files_written() const { return m_files_written; }
+  uint64_t bytes_written() const { return m_bytes_written; }
+  const char* output_name() const { return m_output->name(); }
+
+ private:
+  struct Item {
+    int file;
+    bool close;
+    std::string block;
+  };
+
+  bool push(Item&& item);
+  void writer_loop();
+  void write_item(Item& item);
+
+  std::vector<std::string> m_file_names;
+  std::unique_ptr<FileOutput> m_output;  // only used by the writer thread
+  int m_n_created = 0;                   // files before this have been created
+
+  std::mutex m_mutex;
+  std::condition_variable m_ready_cv;  // signaled when there's something in the queue
+  std::condition_variable m_space_cv;  // signaled when there's space in the queue, or on failure
+  std::deque<Item> m_queue;
+  size_t m_max_queued;
+  size_t m_output_held = 0;            // m_output->blocks_held(), after the last write
+  std::vector<uint8_t> m_close_pushed;  // close_file has been called for the file
+  int m_first_unclosed = 0;
+  bool m_finishing = false;
+  bool m_failed = false;
+  std::exception_ptr m_exception;
+
+  uint32_t m_files_written = 0;
+  uint64_t m_bytes_written = 0;
+
+  std::thread m_thread;
+};
+
+#endif  // JAK_DISASSEMBLER_ORDEREDFILEWRITER_H
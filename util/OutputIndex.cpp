@@ -0,0 +1,317 @@
+/*!
+ * @file OutputIndex.cpp
+ * Skip writing output files which haven't changed since the last run.
+ *
+ * The index is a text file in the output folder, with a line for each file:
+ *  hash size mtime_sec mtime_nsec name
+ * where the hash is 64-bit FNV-1a, in hex. Names are relative to the output folder.
+ */
+
+#include "OutputIndex.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "FileIO.h"
+
+namespace {
+const char* OUTPUT_INDEX_NAME = ".jak_disassembler_index";
+
+/*!
+ * Get the size and modification time of a file. On Windows, the time is only to the second.
+ */
+bool stat_file(const std::string& file_name, OutputIndex::Entry* entry) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(file_name.c_str(), &st) != 0 || !(st.st_mode & _S_IFREG)) {
+    return false;
+  }
+  entry->mtime_sec = int64_t(st.st_mtime);
+  entry->mtime_nsec = 0;
+#else
+  struct stat st;
+  if (stat(file_name.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+#ifdef __APPLE__
+  entry->mtime_sec = int64_t(st.st_mtimespec.tv_sec);
+  entry->mtime_nsec = int64_t(st.st_mtimespec.tv_nsec);
+#else
+  entry->mtime_sec = int64_t(st.st_mtim.tv_sec);
+  entry->mtime_nsec = int64_t(st.st_mtim.tv_nsec);
+#endif
+#endif
+  entry->size = uint64_t(st.st_size);
+  return true;
+}
+}  // namespace
+
+uint64_t hash_output(uint64_t hash, const void* data, size_t size) {
+  auto bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+OutputIndex& get_output_index() {
+  static OutputIndex index;
+  return index;
+}
+
+/*!
+ * Read the index from the output folder, if there is one, and start skipping unchanged files.
+ */
+void OutputIndex::load(const std::string& output_dir) {
+  m_output_dir = output_dir;
+  m_enabled = true;
+  m_entries.clear();
+
+  FILE* fp = fopen(combine_path(output_dir, OUTPUT_INDEX_NAME).c_str(), "r");
+  if (!fp) {
+    return;  // first run, everything will be written.
+  }
+  char name[1024];
+  Entry entry;
+  while (fscanf(fp, "%" SCNx64 " %" SCNu64 " %" SCNd64 " %" SCNd64 " %1023[^\n]", &entry.hash,
+                &entry.size, &entry.mtime_sec, &entry.mtime_nsec, name) == 5) {
+    m_entries[name] = entry;
+  }
+  fclose(fp);
+}
+
+/*!
+ * Write the index back to the output folder, if anything was written. Entries for files which
+ * weren't output in this run are dropped, so the index doesn't keep growing.
+ */
+void OutputIndex::save() {
+  if (!m_enabled) {
+    return;
+  }
+  std::map<std::string, Entry> sorted;
+  for (auto& kv : m_entries) {
+    if (kv.second.seen) {
+      sorted.insert(kv);
+    } else {
+      m_changed = true;
+    }
+  }
+  if (!m_changed) {
+    return;
+  }
+  std::string text;
+  char line[128];
+  for (auto& kv : sorted) {
+    auto& e = kv.second;
+    sprintf(line, "%016" PRIx64 " %" PRIu64 " %" PRId64 " %" PRId64 " ", e.hash, e.size,
+            e.mtime_sec, e.mtime_nsec);
+    text += line;
+    text += kv.first;
+    text += '\n';
+  }
+
+  auto file_name = combine_path(m_output_dir, OUTPUT_INDEX_NAME);
+  FILE* fp = fopen(file_name.c_str(), "w");
+  if (!fp) {
+    printf("Failed to fopen %s\n", file_name.c_str());
+    throw std::runtime_error("Failed to open file");
+  }
+  if (!text.empty() && fwrite(text.data(), text.size(), 1, fp) != 1) {
+    fclose(fp);
+    throw std::runtime_error("Failed to write file " + file_name);
+  }
+  fclose(fp);
+  m_entries = std::unordered_map<std::string, Entry>(sorted.begin(), sorted.end());
+  m_changed = false;
+}
+
+std::string OutputIndex::key(const std::string& file_name) const {
+  auto prefix = m_output_dir + "/";
+  if (file_name.compare(0, prefix.size(), prefix) == 0) {
+    return file_name.substr(prefix.size());
+  }
+  return file_name;
+}
+
+/*!
+ * Get what we wrote to a file last time. Returns false if we didn't write it, or if the file on
+ * disk isn't what we wrote.
+ */
+bool OutputIndex::lookup(const std::string& file_name, Entry* entry) {
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto it = m_entries.find(key(file_name));
+    if (it == m_entries.end()) {
+      return false;
+    }
+    it->second.seen = true;
+    *entry = it->second;
+  }
+
+  Entry on_disk;
+  return stat_file(file_name, &on_disk) && on_disk.size == entry->size &&
+         on_disk.mtime_sec == entry->mtime_sec && on_disk.mtime_nsec == entry->mtime_nsec;
+}
+
+/*!
+ * Is this what we wrote to the file last time, and is it still on disk?
+ */
+bool OutputIndex::is_unchanged(const std::string& file_name, uint64_t hash, uint64_t size) {
+  Entry entry;
+  return lookup(file_name, &entry) && entry.size == size && entry.hash == hash;
+}
+
+/*!
+ * Remember the hash of a file which was just written and closed.
+ */
+void OutputIndex::record_write(const std::string& file_name, uint64_t hash, uint64_t size) {
+  Entry entry;
+  if (!stat_file(file_name, &entry)) {
+    throw std::runtime_error("Failed to stat file " + file_name);
+  }
+  entry.hash = hash;
+  entry.seen = true;
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_entries[key(file_name)] = entry;
+  m_changed = true;
+  m_stats.written_files++;
+  m_stats.written_bytes += size;
+}
+
+void OutputIndex::record_skip(uint64_t size) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_stats.skipped_files++;
+  m_stats.skipped_bytes += size;
+}
+
+OutputIndex::Stats OutputIndex::stats() {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  return m_stats;
+}
+
+void SkipUnchangedFileOutput::open(int file, const std::string& file_name) {
+  auto& f = m_files[file];
+  f.name = file_name;
+  if (m_buffering_file != -1) {
+    // we don't know if the earlier file will be created, so this one has to wait.
+    f.deferred = true;
+    m_deferred.push_back(file);
+    return;
+  }
+
+  OutputIndex::Entry entry;
+  if (m_index.lookup(file_name, &entry)) {
+    f.buffering = true;
+    f.old_size = entry.size;
+    m_buffering_file = file;
+  } else {
+    m_output->open(file, file_name);
+  }
+}
+
+void SkipUnchangedFileOutput::write(int file, std::string&& block) {
+  auto& f = m_files.at(file);
+  if (f.deferred) {
+    f.blocks.push_back(std::move(block));
+    m_blocks_held++;
+    return;
+  }
+
+  f.hash = hash_output(f.hash, block.data(), block.size());
+  f.size += block.size();
+  if (!f.buffering) {
+    m_output->write(file, std::move(block));
+    return;
+  }
+
+  f.blocks.push_back(std::move(block));
+  m_blocks_held++;
+  if (f.size > f.old_size) {
+    stop_buffering(file, f);  // it's changed for sure.
+    open_deferred_files();
+  }
+}
+
+void SkipUnchangedFileOutput::close(int file) {
+  auto it = m_files.find(file);
+  auto& f = it->second;
+  if (f.deferred) {
+    f.close_requested = true;
+    return;
+  }
+
+  if (f.buffering) {
+    if (m_index.is_unchanged(f.name, f.hash, f.size)) {
+      m_index.record_skip(f.size);
+      m_blocks_held -= f.blocks.size();
+      m_buffering_file = -1;
+      m_files.erase(it);
+      open_deferred_files();
+      return;
+    }
+    stop_buffering(file, f);
+  }
+
+  m_output->close(file);
+  f.blocks.clear();
+  m_written.push_back(std::move(f));
+  m_files.erase(it);
+  open_deferred_files();
+}
+
+void SkipUnchangedFileOutput::finish() {
+  if (!m_deferred.empty()) {
+    throw std::runtime_error("File " + m_files.at(m_buffering_file).name + " was never closed");
+  }
+  m_output->finish();
+  for (auto& f : m_written) {
+    m_index.record_write(f.name, f.hash, f.size);
+  }
+  m_written.clear();
+}
+
+/*!
+ * The file has changed, so write it out like normal.
+ */
+void SkipUnchangedFileOutput::stop_buffering(int file, File& f) {
+  f.buffering = false;
+  m_buffering_file = -1;
+  m_output->open(file, f.name);
+  for (auto& block : f.blocks) {
+    m_output->write(file, std::move(block));
+  }
+  m_blocks_held -= f.blocks.size();
+  f.blocks.clear();
+}
+
+/*!
+ * Now that no file is buffering, open the files which were waiting for it, in order, and give them
+ * what they were sent. Stops if one of them might be unchanged.
+ */
+void SkipUnchangedFileOutput::open_deferred_files() {
+  if (m_opening_deferred) {
+    return;  // called from a write or close below, the loop will continue.
+  }
+  m_opening_deferred = true;
+  while (m_buffering_file == -1 && !m_deferred.empty()) {
+    int file = m_deferred.front();
+    m_deferred.pop_front();
+    auto& f = m_files.at(file);
+    f.deferred = false;
+    auto blocks = std::move(f.blocks);
+    f.blocks.clear();
+    m_blocks_held -= blocks.size();
+    bool close_requested = f.close_requested;
+
+    open(file, f.name);
+    for (auto& block : blocks) {
+      write(file, std::move(block));
+    }
+    if (close_requested) {
+      close(file);
+    }
+  }
+  m_opening_deferred = false;
+}
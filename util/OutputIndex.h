@@ -0,0 +1,114 @@
+/*!
+ * @file OutputIndex.h
+ * Skip writing output files which haven't changed since the last run.
+ */
+
+#ifndef JAK_DISASSEMBLER_OUTPUTINDEX_H
+#define JAK_DISASSEMBLER_OUTPUTINDEX_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FileOutput.h"
+
+constexpr uint64_t OUTPUT_HASH_INIT = 0xcbf29ce484222325;
+uint64_t hash_output(uint64_t hash, const void* data, size_t size);
+
+/*!
+ * The hash and size of each file written to the output folder, saved to a file in that folder.
+ * The size and modification time of the file on disk are saved too, so we can tell if it was
+ * changed by something else without reading it.
+ *
+ * Once loaded, this can be used from multiple threads.
+ */
+class OutputIndex {
+ public:
+  struct Entry {
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    int64_t mtime_sec = 0;
+    int64_t mtime_nsec = 0;
+    bool seen = false;  // looked up or written in this run. Entries which aren't are dropped.
+  };
+
+  struct Stats {
+    uint32_t written_files = 0;
+    uint64_t written_bytes = 0;
+    uint32_t skipped_files = 0;
+    uint64_t skipped_bytes = 0;
+  };
+
+  void load(const std::string& output_dir);
+  void save();
+  bool enabled() const { return m_enabled; }
+
+  bool lookup(const std::string& file_name, Entry* entry);
+  bool is_unchanged(const std::string& file_name, uint64_t hash, uint64_t size);
+  void record_write(const std::string& file_name, uint64_t hash, uint64_t size);
+  void record_skip(uint64_t size);
+  Stats stats();
+
+ private:
+  std::string key(const std::string& file_name) const;
+
+  bool m_enabled = false;
+  bool m_changed = false;
+  std::string m_output_dir;
+  std::mutex m_mutex;
+  std::unordered_map<std::string, Entry> m_entries;
+  Stats m_stats;
+};
+
+OutputIndex& get_output_index();
+
+/*!
+ * A FileOutput which doesn't write files that have the same contents as the last time. It has to
+ * see the whole file to know, so files which might be unchanged are held in memory until they are
+ * closed. Files which are new, or have already grown past their old size, are written directly.
+ *
+ * Files must still be created in order, so files opened while one might be unchanged are held in
+ * memory too, and created once it is either skipped or written.
+ */
+class SkipUnchangedFileOutput : public FileOutput {
+ public:
+  SkipUnchangedFileOutput(OutputIndex& index, std::unique_ptr<FileOutput> output)
+      : m_index(index), m_output(std::move(output)) {}
+  const char* name() const override { return m_output->name(); }
+  void open(int file, const std::string& file_name) override;
+  void write(int file, std::string&& block) override;
+  void close(int file) override;
+  void submit() override { m_output->submit(); }
+  void finish() override;
+  size_t blocks_held() const override { return m_blocks_held + m_output->blocks_held(); }
+
+ private:
+  struct File {
+    std::string name;
+    uint64_t hash = OUTPUT_HASH_INIT;
+    uint64_t size = 0;
+    uint64_t old_size = 0;
+    bool buffering = false;  // if false, blocks are written right away
+    bool deferred = false;   // opened while another file was buffering, so not opened yet
+    bool close_requested = false;
+    std::vector<std::string> blocks;
+  };
+
+  void stop_buffering(int file, File& f);
+  void open_deferred_files();
+
+  OutputIndex& m_index;
+  std::unique_ptr<FileOutput> m_output;
+  std::map<int, File> m_files;
+  std::vector<File> m_written;  // to add to the index, once they are closed for sure
+  int m_buffering_file = -1;     // the only file which might be unchanged, all later are deferred
+  std::deque<int> m_deferred;    // deferred files, in the order they were opened
+  size_t m_blocks_held = 0;
+  bool m_opening_deferred = false;
+};
+
+#endif  // JAK_DISASSEMBLER_OUTPUTINDEX_H
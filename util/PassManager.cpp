@@ -0,0 +1,92 @@
+#include "PassManager.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include "Timer.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+/*!
+ * Get the amount of memory in RAM used by the process, or 0 if we don't know how.
+ */
+int64_t get_resident_memory_bytes() {
+#ifdef __linux__
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if (!fp) {
+    return 0;
+  }
+  long total_pages = 0, resident_pages = 0;
+  int n = fscanf(fp, "%ld %ld", &total_pages, &resident_pages);
+  fclose(fp);
+  return n == 2 ? int64_t(resident_pages) * sysconf(_SC_PAGESIZE) : 0;
+#else
+  return 0;
+#endif
+}
+
+void PassManager::add_pass(const std::string& name,
+                           const std::vector<std::string>& needs,
+                           const std::vector<std::string>& makes,
+                           std::function<void()> run) {
+  // everything needed must be made by an earlier pass, so run() can just go in order.
+  for (auto& product : needs) {
+    bool found = false;
+    for (auto& pass : m_passes) {
+      if (std::find(pass.makes.begin(), pass.makes.end(), product) != pass.makes.end()) {
+        found = true;
+      }
+    }
+    if (!found) {
+      throw std::runtime_error("Pass " + name + " needs " + product +
+                               ", which isn't made by an earlier pass");
+    }
+  }
+  m_passes.push_back({name, needs, makes, std::move(run)});
+}
+
+void PassManager::request(const std::string& product) {
+  m_requested.push_back(product);
+}
+
+/*!
+ * Run the passes which are needed for the requested products.
+ */
+void PassManager::run() {
+  // go backward, so we know everything wanted by later passes before looking at a pass.
+  std::vector<std::string> wanted = m_requested;
+  std::vector<bool> enabled(m_passes.size(), false);
+  for (size_t i = m_passes.size(); i-- > 0;) {
+    auto& pass = m_passes[i];
+    for (auto& product : pass.makes) {
+      if (std::find(wanted.begin(), wanted.end(), product) != wanted.end()) {
+        enabled[i] = true;
+      }
+    }
+    if (enabled[i]) {
+      wanted.insert(wanted.end(), pass.needs.begin(), pass.needs.end());
+    }
+  }
+
+  std::string skipped;
+  for (size_t i = 0; i < m_passes.size(); i++) {
+    if (!enabled[i]) {
+      skipped += skipped.empty() ? m_passes[i].name : ", " + m_passes[i].name;
+    }
+  }
+  if (!skipped.empty()) {
+    printf("Skipping passes not needed for the requested outputs: %s\n\n", skipped.c_str());
+  }
+
+  for (size_t i = 0; i < m_passes.size(); i++) {
+    if (!enabled[i]) {
+      continue;
+    }
+    Timer timer;
+    int64_t memory_before = get_resident_memory_bytes();
+    m_passes[i].run();
+    printf("Pass %s took %.3f ms, memory %+.3f MB\n\n", m_passes[i].name.c_str(), timer.getMs(),
+           (get_resident_memory_bytes() - memory_before) / double(1 << 20));
+  }
+}
@@ -0,0 +1,44 @@
+/*!
+ * @file PassManager.h
+ * Runs only the passes needed to produce the requested outputs.
+ */
+
+#ifndef JAK_DISASSEMBLER_PASSMANAGER_H
+#define JAK_DISASSEMBLER_PASSMANAGER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*!
+ * A list of passes, each with the products it needs and the products it makes. Passes must be
+ * added in the order they should run, after the passes making the products they need.
+ *
+ * When run, a pass is skipped unless something it makes was requested, or is needed by another
+ * pass which runs. The time and change in memory usage of each pass is printed.
+ */
+class PassManager {
+ public:
+  void add_pass(const std::string& name,
+                const std::vector<std::string>& needs,
+                const std::vector<std::string>& makes,
+                std::function<void()> run);
+  void request(const std::string& product);
+  void run();
+
+ private:
+  struct Pass {
+    std::string name;
+    std::vector<std::string> needs;
+    std::vector<std::string> makes;
+    std::function<void()> run;
+  };
+
+  std::vector<Pass> m_passes;
+  std::vector<std::string> m_requested;
+};
+
+int64_t get_resident_memory_bytes();
+
+#endif  // JAK_DISASSEMBLER_PASSMANAGER_H
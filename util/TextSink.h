@@ -0,0 +1,49 @@
+/*!
+ * @file TextSink.h
+ * Buffered destination for printed text, which passes it on in blocks.
+ */
+
+#ifndef JAK_DISASSEMBLER_TEXTSINK_H
+#define JAK_DISASSEMBLER_TEXTSINK_H
+
+#include <functional>
+#include <string>
+#include <utility>
+
+/*!
+ * Printers append to buffer(), then call done_with_part() at points where it's fine to split the
+ * output. Once the buffer reaches the block size, it is passed to the flush function, so memory
+ * use doesn't grow with the size of the output.
+ *
+ * Blocks are at least block_size bytes (except the last one), plus at most one part.
+ */
+class TextSink {
+ public:
+  TextSink(size_t block_size, std::function<void(std::string&&)> flush_func)
+      : m_block_size(block_size), m_flush_func(std::move(flush_func)) {
+    m_buffer.reserve(block_size);
+  }
+
+  std::string& buffer() { return m_buffer; }
+
+  void done_with_part() {
+    if (m_buffer.size() >= m_block_size) {
+      flush();
+    }
+  }
+
+  void flush() {
+    if (!m_buffer.empty()) {
+      m_flush_func(std::move(m_buffer));
+      m_buffer = std::string();
+      m_buffer.reserve(m_block_size);
+    }
+  }
+
+ private:
+  size_t m_block_size;
+  std::function<void(std::string&&)> m_flush_func;
+  std::string m_buffer;
+};
+
+#endif  // JAK_DISASSEMBLER_TEXTSINK_H
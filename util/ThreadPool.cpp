@@ -0,0 +1,164 @@
+#include <cassert>
+#include "ThreadPool.h"
+
+/*!
+ * Create a pool which runs tasks on n_threads threads, including the calling thread.
+ * If n_threads is 0, use one thread per hardware thread.
+ */
+ThreadPool::ThreadPool(int n_threads) {
+  if (n_threads <= 0) {
+    n_threads = int(std::thread::hardware_concurrency());
+    if (n_threads <= 0) {
+      n_threads = 1;
+    }
+  }
+
+  for (int i = 0; i < n_threads; i++) {
+    m_ranges.push_back(std::make_unique<Range>());
+  }
+
+  // worker 0 is the thread calling parallel_for.
+  for (int i = 1; i < n_threads; i++) {
+    m_workers.emplace_back([this, i]() { worker_loop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_stop = true;
+  }
+  m_start_cv.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+/*!
+ * Split [0, count) between the workers, wake them up, then help out until everything is done.
+ */
+void ThreadPool::run(int count, std::function<void(int)> task) {
+  {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    // parallel_for can't be called from inside a task.
+    assert(!m_busy);
+    m_busy = true;
+
+    int n = size();
+    for (int i = 0; i < n; i++) {
+      std::unique_lock<std::mutex> range_lk(m_ranges[i]->mutex);
+      m_ranges[i]->begin = int(int64_t(count) * i / n);
+      m_ranges[i]->end = int(int64_t(count) * (i + 1) / n);
+    }
+
+    m_task = std::move(task);
+    m_exception = nullptr;
+    m_n_running = int(m_workers.size());
+    m_generation++;
+  }
+  m_start_cv.notify_all();
+
+  do_work(0);
+
+  std::unique_lock<std::mutex> lk(m_mutex);
+  m_done_cv.wait(lk, [&]() { return m_n_running == 0; });
+  m_task = nullptr;
+  m_busy = false;
+
+  if (m_exception) {
+    auto e = m_exception;
+    m_exception = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+/*!
+ * Main loop of a background worker: wait for a task, help with it, repeat.
+ */
+void ThreadPool::worker_loop(int worker_id) {
+  uint64_t last_generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lk(m_mutex);
+      m_start_cv.wait(lk, [&]() { return m_stop || m_generation != last_generation; });
+      if (m_stop) {
+        return;
+      }
+      last_generation = m_generation;
+    }
+
+    do_work(worker_id);
+
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_n_running--;
+    if (m_n_running == 0) {
+      m_done_cv.notify_all();
+    }
+  }
+}
+
+/*!
+ * Run items until there is nothing left to take or steal.
+ */
+void ThreadPool::do_work(int worker_id) {
+  int idx;
+  for (;;) {
+    while (take(worker_id, &idx)) {
+      try {
+        m_task(idx);
+      } catch (...) {
+        std::unique_lock<std::mutex> lk(m_mutex);
+        if (!m_exception) {
+          m_exception = std::current_exception();
+        }
+      }
+    }
+
+    // work is never added during a task, so if there's nothing to steal, we're done.
+    if (!steal(worker_id)) {
+      return;
+    }
+  }
+}
+
+/*!
+ * Take the next item from our own range.
+ */
+bool ThreadPool::take(int worker_id, int* idx) {
+  auto& range = *m_ranges[worker_id];
+  std::unique_lock<std::mutex> lk(range.mutex);
+  if (range.begin < range.end) {
+    *idx = range.begin++;
+    return true;
+  }
+  return false;
+}
+
+/*!
+ * Steal the back half of another worker's range and make it our own.
+ * Returns false if no worker has anything left.
+ */
+bool ThreadPool::steal(int worker_id) {
+  int n = size();
+  for (int i = 1; i < n; i++) {
+    auto& victim = *m_ranges[(worker_id + i) % n];
+    int begin, end;
+    {
+      std::unique_lock<std::mutex> lk(victim.mutex);
+      int remaining = victim.end - victim.begin;
+      if (remaining <= 0) {
+        continue;
+      }
+      begin = victim.end - (remaining + 1) / 2;
+      end = victim.end;
+      victim.end = begin;
+    }
+
+    auto& range = *m_ranges[worker_id];
+    std::unique_lock<std::mutex> lk(range.mutex);
+    range.begin = begin;
+    range.end = end;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,87 @@
+/*!
+ * @file ThreadPool.h
+ * A small work-stealing thread pool for running independent tasks in parallel.
+ */
+
+#ifndef JAK_DISASSEMBLER_THREADPOOL_H
+#define JAK_DISASSEMBLER_THREADPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * A pool of worker threads. Work is submitted with parallel_for, which runs a function on each
+ * index in a range and returns once all of them are done. The calling thread helps out.
+ *
+ * Each worker starts with an equal slice of the range. Once a worker finishes its own slice, it
+ * steals half of the remaining work from another worker, so a few slow items don't leave the other
+ * threads idle.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int n_threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int size() const { return int(m_ranges.size()); }
+
+  /*!
+   * Run f(i) for each i in [0, count). The order is unspecified, and f may be called on different
+   * threads at the same time. If f throws, the first exception is rethrown here after all workers
+   * are done.
+   */
+  template <typename Func>
+  void parallel_for(int count, Func f) {
+    if (count <= 0) {
+      return;
+    }
+
+    if (m_workers.empty() || count == 1) {
+      for (int i = 0; i < count; i++) {
+        f(i);
+      }
+      return;
+    }
+
+    run(count, std::function<void(int)>(std::move(f)));
+  }
+
+ private:
+  /*!
+   * The part of the current task owned by a single worker. The owner takes from the front,
+   * thieves take from the back.
+   */
+  struct Range {
+    std::mutex mutex;
+    int begin = 0;
+    int end = 0;
+  };
+
+  void run(int count, std::function<void(int)> task);
+  void worker_loop(int worker_id);
+  void do_work(int worker_id);
+  bool take(int worker_id, int* idx);
+  bool steal(int worker_id);
+
+  std::vector<std::thread> m_workers;
+  std::vector<std::unique_ptr<Range>> m_ranges;  // one per worker, plus one for the caller
+
+  std::mutex m_mutex;
+  std::condition_variable m_start_cv;
+  std::condition_variable m_done_cv;
+  std::function<void(int)> m_task;
+  std::exception_ptr m_exception;
+  uint64_t m_generation = 0;
+  int m_n_running = 0;
+  bool m_busy = false;
+  bool m_stop = false;
+};
+
+#endif  // JAK_DISASSEMBLER_THREADPOOL_H